@@ -11,6 +11,8 @@
 #include <private/qhttpserverrequest_p.h>
 
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qscopeguard.h>
+#include <QtCore/qtimer.h>
 #include <QtNetwork/qtcpserver.h>
 #include <QtNetwork/qtcpsocket.h>
 #include <QtNetwork/qlocalserver.h>
@@ -20,11 +22,26 @@
 #include <QtNetwork/qsslserver.h>
 #endif
 
+#ifdef Q_OS_UNIX
+#include <private/qcore_unix_p.h>
+#include <private/qnet_unix_p.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstring>
+
+#ifdef SO_REUSEPORT
+#define QT_HTTPSERVER_REUSEPORT
+#endif
+#endif // Q_OS_UNIX
+
 #if QT_CONFIG(http) && QT_CONFIG(ssl)
 #include <private/qhttpserverhttp2protocolhandler_p.h>
 #endif
 
 #include <algorithm>
+#include <iterator>
 
 QT_BEGIN_NAMESPACE
 
@@ -43,26 +60,189 @@ QAbstractHttpServerPrivate::QAbstractHttpServerPrivate()
 void QAbstractHttpServerPrivate::handleNewConnections()
 {
     Q_Q(QAbstractHttpServer);
+    acceptConnections(listenerFor(q->sender()));
+}
+
+/*!
+    \internal
+
+    Returns the listener state of \a server, which hands its connections
+    over to \a worker if set, creating it on first use.
+*/
+std::shared_ptr<QAbstractHttpServerPrivate::Listener>
+QAbstractHttpServerPrivate::listenerFor(QObject *server, Worker *worker)
+{
+    QMutexLocker locker(&listenersMutex);
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                   [](const auto &listener) { return !listener->server; }),
+                    listeners.end());
+    auto it = std::find_if(listeners.cbegin(), listeners.cend(), [server](const auto &listener) {
+        return listener->server == server;
+    });
+    if (it != listeners.cend())
+        return *it;
+
+    auto listener = std::make_shared<Listener>();
+    listener->server = server;
+    listener->worker = worker;
+    listeners.push_back(listener);
+    return listener;
+}
+
+/*!
+    \internal
+
+    Accepts the pending connections of \a listener, in its thread, until
+    there are none left or a connection limit is reached. In the latter case
+    the listener is paused, leaving the next connections in the listen
+    backlog, until connectionClosed() resumes it.
+*/
+void QAbstractHttpServerPrivate::acceptConnections(const std::shared_ptr<Listener> &listener)
+{
+    Q_Q(QAbstractHttpServer);
+    if (!listener->server || isDraining())
+        return;
+    Q_ASSERT(listener->server->thread() == QThread::currentThread());
+
+    const QHttpServerConfiguration config = q->configuration();
+    const quint32 maxPerListener = config.maxConnectionsPerListener();
+    for (;;) {
+        if ((maxPerListener && listener->connections >= maxPerListener)
+            || !reserveConnection(config.maxConnections())) {
+            setPaused(listener.get(), true);
+            return;
+        }
+
+        bool http2 = false;
+        QIODevice *socket = nextPendingConnection(listener.get(), &http2);
+        if (!socket) {
+            connectionCount.deref();
+            break;
+        }
+
+        ++listener->connections;
+        // The socket is destroyed with its protocol handler, or with the
+        // QWebSocket it was upgraded to, in whichever thread it lives.
+        QObject::connect(socket, &QObject::destroyed, listener->server.data(), [this, listener] {
+            connectionClosed(listener);
+        });
+        if (Worker *worker = listener->worker) {
+            worker->connections.ref();
+            adoptConnection(worker, socket, http2);
+        } else {
+            startHandling(socket, http2);
+        }
+    }
+    setPaused(listener.get(), false);
+}
 
+/*!
+    \internal
+
+    Returns the next connection accepted by \a listener, or \nullptr if
+    there is none. \a http2 is set to whether HTTP/2 was negotiated for it.
+*/
+QIODevice *QAbstractHttpServerPrivate::nextPendingConnection(Listener *listener, bool *http2)
+{
 #if QT_CONFIG(ssl) && QT_CONFIG(http)
-    if (auto *sslServer = qobject_cast<QSslServer *>(q->sender())) {
-        while (auto socket = qobject_cast<QSslSocket *>(sslServer->nextPendingConnection())) {
-            if (socket->sslConfiguration().nextNegotiatedProtocol()
-                            == QSslConfiguration::ALPNProtocolHTTP2) {
-                new QHttpServerHttp2ProtocolHandler(q, socket);
-            } else {
-                new QHttpServerHttp1ProtocolHandler(q, socket);
-            }
+    if (auto *sslServer = qobject_cast<QSslServer *>(listener->server)) {
+        auto socket = qobject_cast<QSslSocket *>(sslServer->nextPendingConnection());
+        if (socket) {
+            *http2 = socket->sslConfiguration().nextNegotiatedProtocol()
+                    == QSslConfiguration::ALPNProtocolHTTP2;
         }
-        return;
+        return socket;
     }
 #endif
+    if (auto *tcpServer = qobject_cast<QTcpServer *>(listener->server))
+        return tcpServer->nextPendingConnection();
+#if QT_CONFIG(localserver)
+    if (auto *localServer = qobject_cast<QLocalServer *>(listener->server))
+        return localServer->nextPendingConnection();
+#endif
+    Q_UNREACHABLE_RETURN(nullptr);
+}
+
+/*!
+    \internal
+
+    Counts one more open connection, unless \a maxConnections are open
+    already, \c 0 meaning no limit.
+*/
+bool QAbstractHttpServerPrivate::reserveConnection(quint32 maxConnections)
+{
+    quint32 count = connectionCount.loadRelaxed();
+    do {
+        if (maxConnections && count >= maxConnections)
+            return false;
+    } while (!connectionCount.testAndSetRelaxed(count, count + 1, count));
+    return true;
+}
 
-    auto tcpServer = qobject_cast<QTcpServer *>(q->sender());
-    Q_ASSERT(tcpServer);
+/*!
+    \internal
 
-    while (auto socket = tcpServer->nextPendingConnection())
-        new QHttpServerHttp1ProtocolHandler(q, socket);
+    Stops or resumes accepting connections on \a listener, as requested by
+    \a paused. A QLocalServer cannot be paused: its connections are simply
+    not taken, and it stops accepting them itself once it holds
+    QLocalServer::maxPendingConnections().
+*/
+void QAbstractHttpServerPrivate::setPaused(Listener *listener, bool paused)
+{
+    if (listener->paused.loadRelaxed() == int(paused))
+        return;
+    listener->paused.storeRelaxed(paused);
+    if (paused)
+        pausedListenerCount.ref();
+    else
+        pausedListenerCount.deref();
+
+    if (auto *tcpServer = qobject_cast<QTcpServer *>(listener->server)) {
+        if (paused)
+            tcpServer->pauseAccepting();
+        else
+            tcpServer->resumeAccepting();
+    }
+    qCDebug(lcHttpServer) << (paused ? "Paused" : "Resumed") << "accepting connections on"
+                          << listener->server.data();
+}
+
+/*!
+    \internal
+
+    Called in the thread of \a listener when one of the connections it
+    accepted is closed, to resume the listeners paused by the limits.
+*/
+void QAbstractHttpServerPrivate::connectionClosed(const std::shared_ptr<Listener> &listener)
+{
+    --listener->connections;
+    connectionCount.deref();
+    if (!pausedListenerCount.loadRelaxed())
+        return;
+
+    if (listener->paused.loadRelaxed())
+        acceptConnections(listener);
+    // The other listeners may be paused by the limit on all the connections.
+    resumeListeners();
+}
+
+/*!
+    \internal
+
+    Makes the paused listeners accept connections again, each in its own
+    thread, if the limits allow it.
+*/
+void QAbstractHttpServerPrivate::resumeListeners()
+{
+    QMutexLocker locker(&listenersMutex);
+    for (const auto &listener : listeners) {
+        if (!listener->paused.loadRelaxed() || !listener->server)
+            continue;
+        QMetaObject::invokeMethod(listener->server.data(), [this, listener] {
+            if (listener->paused.loadRelaxed())
+                acceptConnections(listener);
+        }, Qt::QueuedConnection);
+    }
 }
 
 /*!
@@ -70,7 +250,9 @@ void QAbstractHttpServerPrivate::handleNewConnections()
 */
 bool QAbstractHttpServerPrivate::verifyThreadAffinity(const QObject *contextObject) const {
     Q_Q(const QAbstractHttpServer);
-    if (contextObject && (contextObject->thread() != q->thread())) {
+    // With worker threads the handlers are called from any of the workers,
+    // so the context objects are not bound to a thread.
+    if (contextObject && !usesWorkerThreads() && (contextObject->thread() != q->thread())) {
         qCWarning(lcHttpServer, "QAbstractHttpServer: "
                                 "the context object must reside in the same thread");
         return false;
@@ -79,6 +261,28 @@ bool QAbstractHttpServerPrivate::verifyThreadAffinity(const QObject *contextObje
 }
 
 
+/*!
+    \internal
+
+    Returns whether the handlers with \a contextObject are called directly
+    in the current thread, rather than queued to the thread of
+    \a contextObject. The worker threads call the handlers whose context
+    object lives in the thread of the server directly, as they are shared by
+    all the connections.
+*/
+bool QAbstractHttpServerPrivate::callsDirectly(const QObject *contextObject) const
+{
+    Q_Q(const QAbstractHttpServer);
+    const QThread *thread = contextObject->thread();
+    return thread == QThread::currentThread() || (usesWorkerThreads() && thread == q->thread());
+}
+
+bool QAbstractHttpServerPrivate::streamsRequestBody(const QHttpServerRequest &request) const
+{
+    Q_UNUSED(request);
+    return false;
+}
+
 #if QT_CONFIG(localserver)
 /*!
     \internal
@@ -86,13 +290,323 @@ bool QAbstractHttpServerPrivate::verifyThreadAffinity(const QObject *contextObje
 void QAbstractHttpServerPrivate::handleNewLocalConnections()
 {
     Q_Q(QAbstractHttpServer);
-    auto localServer = qobject_cast<QLocalServer *>(q->sender());
-    Q_ASSERT(localServer);
+    acceptConnections(listenerFor(q->sender()));
+}
+#endif
+
+static thread_local QAbstractHttpServerPrivate::Worker *currentWorker = nullptr;
+
+#ifdef QT_HTTPSERVER_REUSEPORT
+/*!
+    \internal
+
+    Returns a socket listening on \a address and \a port, which other
+    sockets can listen on as well, or -1 on failure.
+*/
+static int openReusePortSocket(const QHostAddress &address, quint16 port)
+{
+    const bool ipv4 = address.protocol() == QAbstractSocket::IPv4Protocol;
+    const int descriptor = qt_safe_socket(ipv4 ? AF_INET : AF_INET6, SOCK_STREAM, 0);
+    if (descriptor == -1) {
+        qCWarning(lcHttpServer, "Could not create a socket: %ls",
+                  qUtf16Printable(qt_error_string(errno)));
+        return -1;
+    }
+
+    const int enable = 1;
+    ::setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (::setsockopt(descriptor, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0) {
+        qCWarning(lcHttpServer, "Could not set SO_REUSEPORT: %ls",
+                  qUtf16Printable(qt_error_string(errno)));
+        qt_safe_close(descriptor);
+        return -1;
+    }
+
+    int result;
+    if (ipv4) {
+        sockaddr_in sockAddr = {};
+        sockAddr.sin_family = AF_INET;
+        sockAddr.sin_port = htons(port);
+        sockAddr.sin_addr.s_addr = htonl(address.toIPv4Address());
+        result = ::bind(descriptor, reinterpret_cast<sockaddr *>(&sockAddr), sizeof(sockAddr));
+    } else {
+        // QHostAddress::Any accepts IPv4 connections as well
+        const int v6only = address.protocol() == QAbstractSocket::IPv6Protocol ? 1 : 0;
+        ::setsockopt(descriptor, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+
+        sockaddr_in6 sockAddr = {};
+        sockAddr.sin6_family = AF_INET6;
+        sockAddr.sin6_port = htons(port);
+        const Q_IPV6ADDR ipv6 = address.toIPv6Address();
+        std::memcpy(&sockAddr.sin6_addr, &ipv6, sizeof(ipv6));
+        sockAddr.sin6_scope_id = address.scopeId().toUInt();
+        result = ::bind(descriptor, reinterpret_cast<sockaddr *>(&sockAddr), sizeof(sockAddr));
+    }
+
+    if (result != 0 || ::listen(descriptor, SOMAXCONN) != 0) {
+        qCWarning(lcHttpServer) << "Could not listen on" << address << port << ":"
+                                << qt_error_string(errno);
+        qt_safe_close(descriptor);
+        return -1;
+    }
+    return descriptor;
+}
+#endif // QT_HTTPSERVER_REUSEPORT
+
+/*!
+    \internal
+
+    Starts \a count worker threads, each running its own event loop.
+*/
+void QAbstractHttpServerPrivate::startWorkers(int count)
+{
+    Q_Q(QAbstractHttpServer);
+    Q_ASSERT(workers.empty());
+
+    workers.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        auto worker = std::make_unique<Worker>();
+        Worker *w = worker.get();
+        w->server = this;
+        w->thread.setObjectName(QStringLiteral("QHttpServer worker %1").arg(i));
+        w->context = new QObject;
+        w->context->moveToThread(&w->thread);
+        QObject::connect(&w->thread, &QThread::started, w->context, [w] {
+            currentWorker = w;
+        });
+        // Deletes the protocol handlers, and with them the sockets, in the
+        // worker thread once its event loop has returned.
+        QObject::connect(&w->thread, &QThread::finished, w->context, &QObject::deleteLater);
+        w->thread.start();
+        workers.push_back(std::move(worker));
+    }
+    workerThreadCount.storeRelaxed(count);
+    qCDebug(lcHttpServer) << q << "started" << count << "worker threads";
+
+    for (const WorkerListener &listener : workerListeners) {
+        for (const auto &worker : workers)
+            listenInWorker(worker.get(), listener.address, listener.port);
+    }
+}
+
+/*!
+    \internal
 
-    while (auto socket = localServer->nextPendingConnection())
-        new QHttpServerHttp1ProtocolHandler(q, socket);
+    Stops the worker threads, closing the connections they handle.
+*/
+void QAbstractHttpServerPrivate::stopWorkers()
+{
+    workerThreadCount.storeRelaxed(0);
+    for (const auto &worker : workers)
+        worker->thread.quit();
+    for (const auto &worker : workers)
+        worker->thread.wait();
+    workers.clear();
 }
+
+/*!
+    \internal
+
+    Makes \a worker listen on \a address and \a port with a socket of its
+    own, and returns the port it listens on, or 0 on failure. If \a server
+    is set, it is set to the QTcpServer listening on the socket, which lives
+    in the thread of \a worker.
+*/
+quint16 QAbstractHttpServerPrivate::listenInWorker(Worker *worker, const QHostAddress &address,
+                                                   quint16 port, QPointer<QObject> *server)
+{
+#ifdef QT_HTTPSERVER_REUSEPORT
+    quint16 listeningPort = 0;
+    QMetaObject::invokeMethod(worker->context, [this, worker, &address, port, &listeningPort,
+                                                server] {
+        const int descriptor = openReusePortSocket(address, port);
+        if (descriptor == -1)
+            return;
+
+        auto *tcpServer = new QTcpServer(worker->context);
+        if (!tcpServer->setSocketDescriptor(descriptor)) {
+            qCWarning(lcHttpServer) << "Could not listen on" << address << port << ":"
+                                    << tcpServer->errorString();
+            qt_safe_close(descriptor);
+            delete tcpServer;
+            return;
+        }
+        QObject::connect(tcpServer, &QTcpServer::pendingConnectionAvailable, tcpServer,
+                         [this, listener = listenerFor(tcpServer, worker)] {
+            acceptConnections(listener);
+        });
+        listeningPort = tcpServer->serverPort();
+        if (server)
+            *server = tcpServer;
+    }, Qt::BlockingQueuedConnection);
+    return listeningPort;
+#else
+    Q_UNUSED(worker);
+    Q_UNUSED(address);
+    Q_UNUSED(port);
+    Q_UNUSED(server);
+    return 0;
 #endif
+}
+
+/*!
+    \internal
+
+    Returns the object that lives in the thread handling the connections of
+    the current thread: the context of the current worker thread, or the
+    server itself.
+*/
+QObject *QAbstractHttpServerPrivate::connectionContext() const
+{
+    if (currentWorker && currentWorker->server == this)
+        return currentWorker->context;
+    return q_ptr;
+}
+
+/*!
+    \internal
+
+    Creates the protocol handler for the connection on \a socket, either in
+    this thread or in the least loaded worker thread. \a http2 tells
+    whether HTTP/2 was negotiated for the connection.
+*/
+void QAbstractHttpServerPrivate::startHandling(QIODevice *socket, bool http2)
+{
+    Q_Q(QAbstractHttpServer);
+    if (workers.empty()) {
+        createProtocolHandler(socket, http2, q);
+        return;
+    }
+
+    Worker *worker = std::min_element(workers.cbegin(), workers.cend(),
+                                      [](const auto &lhs, const auto &rhs) {
+                                          return lhs->connections.loadRelaxed()
+                                                  < rhs->connections.loadRelaxed();
+                                      })->get();
+    worker->connections.ref();
+
+    socket->setParent(nullptr);
+    socket->moveToThread(&worker->thread);
+    // Deletes the socket if the worker stops before it is handled.
+    QObject::connect(&worker->thread, &QThread::finished, socket, &QObject::deleteLater);
+    QMetaObject::invokeMethod(worker->context, [this, worker, socket, http2] {
+        QObject::disconnect(&worker->thread, &QThread::finished, socket, &QObject::deleteLater);
+        adoptConnection(worker, socket, http2);
+    }, Qt::QueuedConnection);
+}
+
+/*!
+    \internal
+
+    Creates the protocol handler for \a socket in the thread of \a worker,
+    whose connection count has already been increased for it.
+*/
+void QAbstractHttpServerPrivate::adoptConnection(Worker *worker, QIODevice *socket, bool http2)
+{
+    Q_ASSERT(QThread::currentThread() == &worker->thread);
+    QObject *handler = createProtocolHandler(socket, http2, worker->context);
+    QObject::connect(handler, &QObject::destroyed, worker->context, [worker] {
+        worker->connections.deref();
+    });
+}
+
+/*!
+    \internal
+
+    Creates the protocol handler for \a socket as a child of \a parent, in
+    the thread of \a parent. A handler created while draining is drained
+    right away.
+*/
+QHttpServerStream *QAbstractHttpServerPrivate::createProtocolHandler(QIODevice *socket, bool http2,
+                                                                    QObject *parent)
+{
+    Q_Q(QAbstractHttpServer);
+    QHttpServerStream *handler = nullptr;
+#if QT_CONFIG(ssl) && QT_CONFIG(http)
+    if (http2)
+        handler = new QHttpServerHttp2ProtocolHandler(q, socket, parent);
+#else
+    Q_UNUSED(http2);
+#endif
+    if (!handler)
+        handler = new QHttpServerHttp1ProtocolHandler(q, socket, parent);
+
+    handlerCount.ref();
+    handler->m_server = this;
+    if (isDraining())
+        handler->drain();
+    return handler;
+}
+
+/*!
+    \internal
+
+    Closes the listening servers, each in its own thread. The connections
+    they did not hand over yet are closed with them.
+*/
+void QAbstractHttpServerPrivate::closeListeners()
+{
+    QMutexLocker locker(&listenersMutex);
+    for (const auto &listener : listeners) {
+        if (QObject *server = listener->server) {
+            QMetaObject::invokeMethod(server, [server] {
+                if (auto *tcpServer = qobject_cast<QTcpServer *>(server))
+                    tcpServer->close();
+#if QT_CONFIG(localserver)
+                else if (auto *localServer = qobject_cast<QLocalServer *>(server))
+                    localServer->close();
+#endif
+            });
+        }
+    }
+}
+
+/*!
+    \internal
+
+    Calls \a function on every protocol handler, in the thread of the
+    handler.
+*/
+void QAbstractHttpServerPrivate::forEachStream(void (QHttpServerStream::*function)())
+{
+    Q_Q(QAbstractHttpServer);
+    const auto callChildren = [function](QObject *parent) {
+        const auto streams = parent->findChildren<QHttpServerStream *>(Qt::FindDirectChildrenOnly);
+        for (QHttpServerStream *stream : streams)
+            (stream->*function)();
+    };
+    callChildren(q);
+    for (const auto &worker : workers) {
+        QMetaObject::invokeMethod(worker->context, [callChildren, context = worker->context] {
+            callChildren(context);
+        }, Qt::QueuedConnection);
+    }
+}
+
+/*!
+    \internal
+
+    Called in the thread of a protocol handler when it is destroyed.
+*/
+void QAbstractHttpServerPrivate::handlerDestroyed()
+{
+    if (!handlerCount.deref() && isDraining())
+        finishDrain();
+}
+
+/*!
+    \internal
+
+    Emits drained(), once, in the thread of the server.
+*/
+void QAbstractHttpServerPrivate::finishDrain()
+{
+    Q_Q(QAbstractHttpServer);
+    if (!drainState.testAndSetRelaxed(int(DrainState::Draining), int(DrainState::Drained)))
+        return;
+    qCDebug(lcHttpServer) << q << "drained";
+    QMetaObject::invokeMethod(q, &QAbstractHttpServer::drained, Qt::QueuedConnection);
+}
 
 /*!
     \class QAbstractHttpServer
@@ -106,6 +620,9 @@ void QAbstractHttpServerPrivate::handleNewLocalConnections()
 
     This is a low level API, see \l QHttpServer for a highler level API to
     implement an HTTP server.
+
+    By default all connections are handled in the thread of the server. Use
+    setWorkerThreadCount() to spread them over several threads instead.
 */
 
 /*!
@@ -117,9 +634,14 @@ QAbstractHttpServer::QAbstractHttpServer(QObject *parent)
 
 /*!
     Destroys an instance of QAbstractHttpServer.
+
+    Any worker threads are stopped.
 */
 QAbstractHttpServer::~QAbstractHttpServer()
-    = default;
+{
+    Q_D(QAbstractHttpServer);
+    d->stopWorkers();
+}
 
 /*!
     \internal
@@ -139,17 +661,23 @@ QAbstractHttpServer::QAbstractHttpServer(QAbstractHttpServerPrivate &dd, QObject
     is listening to.
 
     This function has the same guarantee as QObject::children,
-    the latest server added is the last entry in the vector.
+    the latest server added is the last entry in the vector. The ports the
+    worker threads listen on follow those of the servers.
 
-    \sa servers()
+    \sa servers(), listenInWorkerThreads()
 */
 QList<quint16> QAbstractHttpServer::serverPorts() const
 {
+    Q_D(const QAbstractHttpServer);
     QList<quint16> ports;
     auto children = findChildren<QTcpServer *>();
     ports.reserve(children.size());
     std::transform(children.cbegin(), children.cend(), std::back_inserter(ports),
                    [](const QTcpServer *server) { return server->serverPort(); });
+    if (!d->workers.empty()) {
+        for (const auto &listener : d->workerListeners)
+            ports.append(listener.port);
+    }
     return ports;
 }
 
@@ -187,6 +715,7 @@ bool QAbstractHttpServer::bind(QTcpServer *server)
         return false;
     }
     server->setParent(this);
+    d->listenerFor(server);
     QObjectPrivate::connect(server, &QTcpServer::pendingConnectionAvailable, d,
                             &QAbstractHttpServerPrivate::handleNewConnections,
                             Qt::UniqueConnection);
@@ -225,6 +754,7 @@ bool QAbstractHttpServer::bind(QLocalServer *server)
         return false;
     }
     server->setParent(this);
+    d->listenerFor(server);
     QObjectPrivate::connect(server, &QLocalServer::newConnection,
                             d, &QAbstractHttpServerPrivate::handleNewLocalConnections,
                             Qt::UniqueConnection);
@@ -301,7 +831,8 @@ QHttpServerWebSocketUpgradeResponse
 QAbstractHttpServer::verifyWebSocketUpgrade(const QHttpServerRequest &request) const
 {
     Q_D(const QAbstractHttpServer);
-    QScopedValueRollback guard(d->handlingWebSocketUpgrade, true);
+    d->handlingWebSocketUpgrade.ref();
+    const auto guard = qScopeGuard([d] { d->handlingWebSocketUpgrade.deref(); });
     for (auto &verifier : d->webSocketUpgradeVerifiers) {
         if (verifier.context && verifier.slotObject && d->verifyThreadAffinity(verifier.context)) {
             auto response = QHttpServerWebSocketUpgradeResponse::passToNext();
@@ -355,7 +886,7 @@ void QAbstractHttpServer::addWebSocketUpgradeVerifierImpl(const QObject *context
     QtPrivate::SlotObjUniquePtr slotObj{slotObjRaw}; // adopts
     Q_ASSERT(slotObj);
     Q_D(QAbstractHttpServer);
-    if (d->handlingWebSocketUpgrade) {
+    if (d->handlingWebSocketUpgrade.loadRelaxed()) {
         qWarning("Registering WebSocket upgrade verifiers while handling them is not allowed");
         return;
     }
@@ -389,6 +920,42 @@ void QAbstractHttpServer::addWebSocketUpgradeVerifierImpl(const QObject *context
     \sa handleRequest(), addWebSocketUpgradeVerifier()
 */
 
+/*!
+    \since 6.9
+
+    Returns the server's configuration parameters.
+
+    \sa setConfiguration()
+*/
+QHttpServerConfiguration QAbstractHttpServer::configuration() const
+{
+    Q_D(const QAbstractHttpServer);
+    QMutexLocker locker(&d->configurationMutex);
+    return d->configuration;
+}
+
+/*!
+    \since 6.9
+
+    Sets the server's configuration parameters to \a config.
+
+    The new configuration applies to requests received after this call,
+    including those on connections that are already established.
+
+    \sa configuration()
+*/
+void QAbstractHttpServer::setConfiguration(const QHttpServerConfiguration &config)
+{
+    Q_D(QAbstractHttpServer);
+    QMutexLocker locker(&d->configurationMutex);
+    d->configuration = config;
+    d->requestLimiter->setMaxConcurrency(config.maxConcurrentRequests());
+    d->requestLimiter->setAdaptive(config.isAdaptiveConcurrencyEnabled());
+    locker.unlock();
+    // The connection limits may have been raised.
+    d->resumeListeners();
+}
+
 #if QT_CONFIG(ssl)
 /*!
     \since 6.8
@@ -400,6 +967,7 @@ void QAbstractHttpServer::addWebSocketUpgradeVerifierImpl(const QObject *context
 QHttp2Configuration QAbstractHttpServer::http2Configuration() const
 {
     Q_D(const QAbstractHttpServer);
+    QMutexLocker locker(&d->configurationMutex);
     return d->h2Configuration;
 }
 
@@ -415,11 +983,221 @@ QHttp2Configuration QAbstractHttpServer::http2Configuration() const
 void QAbstractHttpServer::setHttp2Configuration(const QHttp2Configuration &configuration)
 {
     Q_D(QAbstractHttpServer);
+    QMutexLocker locker(&d->configurationMutex);
     d->h2Configuration = configuration;
 }
 
 #endif
 
+/*!
+    \since 6.9
+
+    Returns the number of worker threads that handle the connections, or 0
+    if they are handled in the thread of the server.
+
+    \sa setWorkerThreadCount()
+*/
+int QAbstractHttpServer::workerThreadCount() const
+{
+    Q_D(const QAbstractHttpServer);
+    return d->workerThreadCount.loadRelaxed();
+}
+
+/*!
+    \since 6.9
+
+    Sets the number of worker threads that handle the connections to \a count.
+
+    Each worker thread runs its own event loop. New connections are given to
+    the worker thread with the fewest connections, which then parses their
+    requests and calls handleRequest() and missingHandler(). With \a count
+    set to 0, the default, all connections are handled in the thread of the
+    server. QThread::idealThreadCount() is a good value to handle requests
+    with all the cores of the host.
+
+    Changing the number of worker threads stops the existing ones, which
+    closes the connections they handle. The responses still being produced
+    for these connections, for example on a thread pool, are discarded.
+
+    With worker threads, the handlers whose context object lives in the
+    thread of the server are called concurrently from the worker threads,
+    and must be thread-safe. Handlers whose context object lives in another
+    thread are still called in that thread. Set up the handlers before
+    setting the number of worker threads, and subclasses should call
+    setWorkerThreadCount(0) in their destructor, so that the worker threads
+    are stopped before the state used by the handlers is destroyed.
+
+    This function must be called from the thread of the server.
+
+    \sa workerThreadCount(), listenInWorkerThreads(), QThread::idealThreadCount()
+*/
+void QAbstractHttpServer::setWorkerThreadCount(int count)
+{
+    Q_D(QAbstractHttpServer);
+    if (count < 0) {
+        qCWarning(lcHttpServer, "QAbstractHttpServer: the worker thread count must not be "
+                                "negative");
+        return;
+    }
+    Q_ASSERT(QThread::currentThread() == thread());
+    if (count == d->workerThreadCount.loadRelaxed())
+        return;
+
+    d->stopWorkers();
+    if (count > 0)
+        d->startWorkers(count);
+}
+
+/*!
+    \since 6.9
+
+    Makes every worker thread listen on \a address and \a port with a
+    listening socket of its own, and returns the port they listen on, or 0
+    on failure. If \a port is 0, a port is chosen automatically.
+
+    The sockets share the port with the \c SO_REUSEPORT socket option, so
+    that the operating system spreads the new connections over the worker
+    threads. Unlike with bind(), the connections are then accepted by the
+    worker threads themselves, without going through the thread of the
+    server.
+
+    The worker threads must have been started with setWorkerThreadCount().
+    The listening sockets belong to them: when the number of worker threads
+    changes, the new worker threads listen on the same port. The connections
+    are not encrypted; bind a QSslServer to use TLS.
+
+    On platforms without \c SO_REUSEPORT, a QTcpServer listening on
+    \a address and \a port is bound to the server with bind() instead,
+    and the connections are given to the worker threads after being
+    accepted.
+
+    \sa setWorkerThreadCount(), bind(), serverPorts()
+*/
+quint16 QAbstractHttpServer::listenInWorkerThreads(const QHostAddress &address, quint16 port)
+{
+    Q_D(QAbstractHttpServer);
+    Q_ASSERT(QThread::currentThread() == thread());
+    if (d->workers.empty()) {
+        qCWarning(lcHttpServer, "QAbstractHttpServer: listening in worker threads requires "
+                                "worker threads, see setWorkerThreadCount()");
+        return 0;
+    }
+
+#ifdef QT_HTTPSERVER_REUSEPORT
+    // The first worker resolves the port for the others. If any of them
+    // fails, the sockets opened so far are closed again.
+    quint16 listeningPort = port;
+    std::vector<std::pair<QAbstractHttpServerPrivate::Worker *, QPointer<QObject>>> opened;
+    opened.reserve(d->workers.size());
+    for (const auto &worker : d->workers) {
+        QPointer<QObject> server;
+        const quint16 workerPort = d->listenInWorker(worker.get(), address, listeningPort,
+                                                     &server);
+        if (workerPort == 0) {
+            qCWarning(lcHttpServer) << "Could not listen on" << address << listeningPort
+                                    << "in every worker thread";
+            for (const auto &[openedWorker, openedServer] : opened) {
+                QMetaObject::invokeMethod(openedWorker->context, [openedServer] {
+                    delete openedServer.data();
+                }, Qt::BlockingQueuedConnection);
+            }
+            return 0;
+        }
+        listeningPort = workerPort;
+        opened.emplace_back(worker.get(), server);
+    }
+    d->workerListeners.push_back({address, listeningPort});
+    return listeningPort;
+#else
+    auto tcpServer = std::make_unique<QTcpServer>();
+    if (!tcpServer->listen(address, port)) {
+        qCWarning(lcHttpServer) << "Could not listen on" << address << port << ":"
+                                << tcpServer->errorString();
+        return 0;
+    }
+    const quint16 listeningPort = tcpServer->serverPort();
+    bind(tcpServer.release());
+    return listeningPort;
+#endif
+}
+
+/*!
+    \since 6.9
+
+    Stops the server gracefully, for instance before replacing it with a
+    new instance of the application.
+
+    The server stops accepting connections, and closes the servers it is
+    bound to as well as the sockets listening in worker threads. The
+    requests in progress are handled as usual, including the transfer of a
+    response body from a QIODevice, after which the connections are closed:
+    \list
+        \li An HTTP/1.1 response carries a \c {Connection: close} header,
+            and an idle connection is closed right away.
+        \li An HTTP/2 connection receives a \c GOAWAY frame, which tells the
+            client to retry the streams it opens afterwards on another
+            connection.
+    \endlist
+
+    The connections still open when \a deadline expires are aborted. The
+    drained() signal is emitted once all the connections are closed, or
+    when \a deadline expires. Connections upgraded to WebSocket are not
+    closed.
+
+    Calling this function again while draining only adds another deadline.
+
+    \sa isDraining(), drained()
+*/
+void QAbstractHttpServer::drain(QDeadlineTimer deadline)
+{
+    Q_D(QAbstractHttpServer);
+    Q_ASSERT(QThread::currentThread() == thread());
+    if (d->drainState.testAndSetRelaxed(int(QAbstractHttpServerPrivate::DrainState::Running),
+                                        int(QAbstractHttpServerPrivate::DrainState::Draining))) {
+        qCDebug(lcHttpServer) << this << "draining" << d->handlerCount.loadRelaxed()
+                              << "connections";
+        d->workerListeners.clear();
+        d->closeListeners();
+        d->forEachStream(&QHttpServerStream::drain);
+        if (d->handlerCount.loadRelaxed() == 0)
+            d->finishDrain();
+    }
+
+    if (deadline.isForever())
+        return;
+    QTimer::singleShot(std::chrono::milliseconds(deadline.remainingTime()), this, [d] {
+        if (d->drainState.loadRelaxed() != int(QAbstractHttpServerPrivate::DrainState::Draining))
+            return;
+        qCDebug(lcHttpServer) << d->q_func() << "aborting" << d->handlerCount.loadRelaxed()
+                              << "connections at the drain deadline";
+        d->forEachStream(&QHttpServerStream::abort);
+        d->finishDrain();
+    });
+}
+
+/*!
+    \since 6.9
+
+    Returns \c true if drain() was called.
+
+    \sa drain()
+*/
+bool QAbstractHttpServer::isDraining() const
+{
+    Q_D(const QAbstractHttpServer);
+    return d->isDraining();
+}
+
+/*!
+    \fn void QAbstractHttpServer::drained()
+    \since 6.9
+
+    This signal is emitted once after drain(), when the connections of the
+    server are closed or the deadline passed to drain() expires.
+
+    \sa drain()
+*/
+
 QT_END_NAMESPACE
 
 #include "moc_qabstracthttpserver.cpp"
@@ -4,9 +4,11 @@
 #ifndef QABSTRACTHTTPSERVER_H
 #define QABSTRACTHTTPSERVER_H
 
+#include <QtCore/qdeadlinetimer.h>
 #include <QtCore/qobject.h>
 
 #include <QtHttpServer/qthttpserverglobal.h>
+#include <QtHttpServer/qhttpserverconfiguration.h>
 #include <QtHttpServer/qhttpserverwebsocketupgraderesponse.h>
 
 #include <QtNetwork/qhostaddress.h>
@@ -49,11 +51,25 @@ public:
     QList<QLocalServer *> localServers() const;
 #endif
 
+    QHttpServerConfiguration configuration() const;
+    void setConfiguration(const QHttpServerConfiguration &config);
+
 #if QT_CONFIG(ssl)
     QHttp2Configuration http2Configuration() const;
     void setHttp2Configuration(const QHttp2Configuration &configuration);
 #endif
 
+    int workerThreadCount() const;
+    void setWorkerThreadCount(int count);
+    quint16 listenInWorkerThreads(const QHostAddress &address = QHostAddress::Any,
+                                  quint16 port = 0);
+
+    void drain(QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever));
+    bool isDraining() const;
+
+Q_SIGNALS:
+    void drained();
+
 #if defined(QT_WEBSOCKETS_LIB)
 Q_SIGNALS:
     void newWebSocketConnection();
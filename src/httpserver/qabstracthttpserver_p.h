@@ -15,12 +15,20 @@
 // We mean it.
 
 #include <QtHttpServer/qabstracthttpserver.h>
+#include <QtHttpServer/qhttpserverresponder.h>
 #include <QtHttpServer/qthttpserverglobal.h>
 
+#include <private/qhttpserverconcurrencylimiter_p.h>
 #include <private/qobject_p.h>
 
+#include <QtCore/qatomic.h>
 #include <QtCore/qcoreapplication.h>
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qthread.h>
 
+#include <memory>
 #include <vector>
 
 #if defined(QT_WEBSOCKETS_LIB)
@@ -34,6 +42,8 @@
 QT_BEGIN_NAMESPACE
 
 class QHttpServerRequest;
+class QHttpServerStream;
+class QIODevice;
 
 class QAbstractHttpServerPrivate: public QObjectPrivate
 {
@@ -42,6 +52,11 @@ public:
 
     QAbstractHttpServerPrivate();
 
+    static const QAbstractHttpServerPrivate *get(const QAbstractHttpServer *q)
+    {
+        return q->d_func();
+    }
+
 #if defined(QT_WEBSOCKETS_LIB)
     QWebSocketServer websocketServer {
         QCoreApplication::applicationName() + QLatin1Char('/') + QCoreApplication::applicationVersion(),
@@ -51,13 +66,97 @@ public:
 
     void handleNewConnections();
     bool verifyThreadAffinity(const QObject *contextObject) const;
+    bool callsDirectly(const QObject *contextObject) const;
+    // Returns whether the body of request is passed to its handler while it
+    // is received. Called by the protocol handlers once the headers are.
+    virtual bool streamsRequestBody(const QHttpServerRequest &request) const;
+
+    // Calls function with the responder in the thread of contextObject.
+    template <typename Function>
+    static void invokeQueued(const QObject *contextObject, QHttpServerResponder &&responder,
+                             Function &&function)
+    {
+        auto heldResponder = std::make_shared<QHttpServerResponder>(std::move(responder));
+        QMetaObject::invokeMethod(
+                const_cast<QObject *>(contextObject),
+                [heldResponder, function = std::forward<Function>(function)]() mutable {
+                    function(*heldResponder);
+                },
+                Qt::QueuedConnection);
+    }
 
 #if QT_CONFIG(localserver)
     void handleNewLocalConnections();
 #endif
 
+    // A thread with its own event loop, which runs the protocol handlers of
+    // the connections given to it. The handlers are children of context.
+    struct Worker
+    {
+        QAbstractHttpServerPrivate *server = nullptr;
+        QThread thread;
+        QObject *context = nullptr;
+        QAtomicInt connections;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+    QAtomicInt workerThreadCount;
+
+    // An address that every worker thread listens on, with a socket of its
+    // own sharing the port through SO_REUSEPORT.
+    struct WorkerListener
+    {
+        QHostAddress address;
+        quint16 port = 0;
+    };
+    std::vector<WorkerListener> workerListeners;
+
+    // A QTcpServer or QLocalServer the connections are accepted from. It
+    // stops accepting them while the connection limits are reached. The
+    // connection count is only used in the thread of the server.
+    struct Listener
+    {
+        QPointer<QObject> server;
+        Worker *worker = nullptr;
+        quint32 connections = 0;
+        QAtomicInt paused;
+    };
+    QMutex listenersMutex;
+    std::vector<std::shared_ptr<Listener>> listeners;
+    QAtomicInteger<quint32> connectionCount;
+    QAtomicInt pausedListenerCount;
+
+    std::shared_ptr<Listener> listenerFor(QObject *server, Worker *worker = nullptr);
+    void acceptConnections(const std::shared_ptr<Listener> &listener);
+    QIODevice *nextPendingConnection(Listener *listener, bool *http2);
+    bool reserveConnection(quint32 maxConnections);
+    void setPaused(Listener *listener, bool paused);
+    void connectionClosed(const std::shared_ptr<Listener> &listener);
+    void resumeListeners();
+
+    // Set by drain(), and then by finishDrain() once drained() is emitted.
+    enum class DrainState { Running, Draining, Drained };
+    QAtomicInt drainState;
+    // The protocol handlers that are not destroyed yet.
+    QAtomicInt handlerCount;
+
+    bool isDraining() const { return drainState.loadRelaxed() != int(DrainState::Running); }
+    void closeListeners();
+    void forEachStream(void (QHttpServerStream::*function)());
+    void handlerDestroyed();
+    void finishDrain();
+
+    bool usesWorkerThreads() const { return workerThreadCount.loadRelaxed() > 0; }
+    void startWorkers(int count);
+    void stopWorkers();
+    quint16 listenInWorker(Worker *worker, const QHostAddress &address, quint16 port,
+                           QPointer<QObject> *server = nullptr);
+    QObject *connectionContext() const;
+    void startHandling(QIODevice *socket, bool http2);
+    void adoptConnection(Worker *worker, QIODevice *socket, bool http2);
+    QHttpServerStream *createProtocolHandler(QIODevice *socket, bool http2, QObject *parent);
+
 #if defined(QT_WEBSOCKETS_LIB)
-    mutable bool handlingWebSocketUpgrade = false;
+    mutable QAtomicInt handlingWebSocketUpgrade;
     struct WebSocketUpgradeVerifier
     {
         QPointer<const QObject> context;
@@ -65,6 +164,13 @@ public:
     };
     std::vector<WebSocketUpgradeVerifier> webSocketUpgradeVerifiers;
 #endif // defined(QT_WEBSOCKETS_LIB)
+    // Guards the configurations, which the worker threads read.
+    mutable QMutex configurationMutex;
+    QHttpServerConfiguration configuration;
+    // Bounds the requests in flight, as configured by
+    // QHttpServerConfiguration::setMaxConcurrentRequests().
+    const std::shared_ptr<QHttpServerConcurrencyLimiter> requestLimiter =
+            std::make_shared<QHttpServerConcurrencyLimiter>();
 #if QT_CONFIG(ssl)
     QHttp2Configuration h2Configuration;
 #endif
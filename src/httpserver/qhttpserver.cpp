@@ -8,9 +8,16 @@
 #include <QtHttpServer/qhttpserverresponse.h>
 
 #include <private/qhttpserver_p.h>
+#include <private/qhttpserverrequest_p.h>
+#include <private/qhttpserverrouter_p.h>
 #include <private/qhttpserverstream_p.h>
 
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qthread.h>
+#if QT_CONFIG(future)
+#include <QtCore/qpromise.h>
+#include <QtCore/qthreadpool.h>
+#endif
 
 #include <QtNetwork/qtcpsocket.h>
 
@@ -23,19 +30,73 @@ QHttpServerPrivate::QHttpServerPrivate(QHttpServer *p) :
 {
 }
 
+bool QHttpServerPrivate::streamsRequestBody(const QHttpServerRequest &request) const
+{
+    return router.d_func()->streamsRequestBody(request);
+}
+
 void QHttpServerPrivate::callMissingHandler(const QHttpServerRequest &request,
                                             QHttpServerResponder &responder)
 {
     Q_Q(QHttpServer);
 
-    if (missingHandler.context && missingHandler.slotObject &&
-        verifyThreadAffinity(missingHandler.context)) {
-        void *args[] = { nullptr, const_cast<QHttpServerRequest *>(&request), &responder };
-        missingHandler.slotObject->call(const_cast<QObject *>(missingHandler.context.data()), args);
-    } else {
+    const QObject *context = missingHandler.context.data();
+    if (!context || !missingHandler.slotObject) {
         qCDebug(lcHS) << "missing handler:" << request.url().path();
         q->sendResponse(QHttpServerResponder::StatusCode::NotFound, request, std::move(responder));
+        return;
+    }
+
+    const auto call = [this, context](const QHttpServerRequest &request,
+                                      QHttpServerResponder &responder) {
+        void *args[] = { nullptr, const_cast<QHttpServerRequest *>(&request), &responder };
+        missingHandler.slotObject->call(const_cast<QObject *>(context), args);
+    };
+    if (callsDirectly(context)) {
+        call(request, responder);
+        return;
+    }
+
+    invokeQueued(context, std::move(responder),
+                 [call, heldRequest = QHttpServerRequestPrivate::copy(request)](
+                         QHttpServerResponder &responder) {
+                     call(*heldRequest, responder);
+                 });
+}
+
+/*!
+    \internal
+
+    Calls the after request handlers from index \a first on, each in the
+    thread of its context object, and sends \a response with \a responder
+    afterwards.
+*/
+void QHttpServerPrivate::callAfterRequestHandlers(size_t first, QHttpServerResponse &&response,
+                                                  const QHttpServerRequest &request,
+                                                  QHttpServerResponder &&responder)
+{
+    for (size_t i = first; i < afterRequestHandlers.size(); ++i) {
+        const auto &afterRequestHandler = afterRequestHandlers[i];
+        const QObject *context = afterRequestHandler.context.data();
+        if (!context || !afterRequestHandler.slotObject)
+            continue;
+
+        if (!callsDirectly(context)) {
+            // Continue with the remaining handlers in the thread of context.
+            auto heldResponse = std::make_shared<QHttpServerResponse>(std::move(response));
+            auto heldRequest = QHttpServerRequestPrivate::copy(request);
+            invokeQueued(context, std::move(responder),
+                         [this, i, heldResponse, heldRequest](QHttpServerResponder &responder) {
+                             callAfterRequestHandlers(i, std::move(*heldResponse), *heldRequest,
+                                                      std::move(responder));
+                         });
+            return;
+        }
+
+        void *args[] = { nullptr, const_cast<QHttpServerRequest *>(&request), &response };
+        afterRequestHandler.slotObject->call(const_cast<QObject *>(context), args);
     }
+    responder.sendResponse(response);
 }
 
 /*!
@@ -97,9 +158,12 @@ QHttpServer::QHttpServer(QObject *parent)
     a function pointer, a non-mutable lambda, or any other copiable callable
     with const call operator. In that case \a receiver has to be a \l QObject
     pointer. The rule will be valid for the lifetime duration of the \a
-    receiver. The receiver must share the same thread affinity as the
-    QHttpServer for the registration to be successful and for the rule to be
-    executed.
+    receiver. The slot is called in the thread of the receiver: if the
+    receiver lives in another thread than the connection, the call is queued
+    to the event loop of that thread, and the response is sent back to the
+    connection from there. With worker threads (see
+    \l QAbstractHttpServer::setWorkerThreadCount()), receivers living in the
+    thread of the QHttpServer are called directly in the worker threads.
 
     The slot can express its response with a return statement. The function has
     to return QHttpServerResponse or any type that can be converted to
@@ -158,8 +222,10 @@ QHttpServer::QHttpServer(QObject *parent)
     (see \l addAfterRequestHandler) will be called.
 
     Requests are processed sequentially inside the \c {QHttpServer}'s thread
-    by default. The request handler may return \c {QFuture<QHttpServerResponse>}
-    if asynchronous processing is desired:
+    by default, or concurrently by the worker threads set with
+    \l QAbstractHttpServer::setWorkerThreadCount(). The request handler may
+    return \c {QFuture<QHttpServerResponse>} if asynchronous processing is
+    desired:
 
     \code
     server.route("/feature/", [] (int id) {
@@ -170,9 +236,29 @@ QHttpServer::QHttpServer(QObject *parent)
     \endcode
 
     The body of \c QFuture is executed asynchronously, but all the network
-    communication is executed sequentially in the thread the \c {QHttpServer}
-    belongs to. The \c {QHttpServerResponder&} special argument is not
-    available for routes returning a \c {QFuture}.
+    communication is executed sequentially in the thread handling the
+    connection. The \c {QHttpServerResponder&} special argument is not
+    available for routes returning a \c {QFuture}. The \c QFuture is
+    canceled when the request is, for instance when the client disconnects,
+    see QHttpServerRequest::isCanceled().
+
+    When compiled with C++20, the request handler may also be a coroutine
+    returning \l {QHttpServerTask}{QHttpServerTask<QHttpServerResponse>}. It
+    runs in the thread handling the request, and suspending it only keeps its
+    coroutine frame alive until it is resumed:
+
+    \code
+    server.route("/poll/", [] (int id) -> QHttpServerTask<QHttpServerResponse> {
+        co_await QtHttpServer::sleepFor(std::chrono::seconds(1));
+        co_return QHttpServerResponse(u"polled %1"_s.arg(id));
+    });
+    \endcode
+
+    The handler object, and the arguments bound to it, are kept alive until
+    the coroutine finishes. A coroutine that ends with an exception is
+    answered with \c {500 Internal Server Error}. The
+    \c {QHttpServerResponder&} special argument is not available for
+    coroutine routes either.
 
     \sa QHttpServerRouter::addRule, addAfterRequestHandler
 */
@@ -208,11 +294,115 @@ QHttpServer::QHttpServer(QObject *parent)
     until the QHttpServer is destroyed.
 */
 
+/*! \fn template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor> Rule *QHttpServer::route(QHttpServerRequest::Methods method, const QObject *receiver, Functor &&slot)
+    \since 6.9
+
+    \overload
+
+    Overload of \l QHttpServer::route that takes the path pattern as the
+    string literal template argument \a PathPattern. The placeholders of the
+    pattern are found when the code is compiled: a pattern with more
+    \c <arg> placeholders than \a slot has arguments to capture them is a
+    compilation error, and the rule does not search an ASCII pattern for
+    them when it is added. Requests for \a method are forwarded to
+    \a receiver and \a slot.
+
+    \code
+    server.route<"/user/<arg>/detail/<arg>">(QHttpServerRequest::Method::Get, this,
+                                             [] (qint64 id, qint64 year) { return ""; });
+    \endcode
+
+    This overload is only available with C++20.
+*/
+
+/*! \fn template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor> Rule *QHttpServer::route(const QObject *receiver, Functor &&slot)
+    \since 6.9
+
+    \overload
+
+    Overload of \l QHttpServer::route that takes the path pattern as the
+    string literal template argument \a PathPattern, for
+    \l QHttpServerRequest::Method::AnyKnown. All requests are forwarded to
+    \a receiver and \a slot.
+
+    This overload is only available with C++20.
+*/
+
+/*! \fn template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor> Rule *QHttpServer::route(QHttpServerRequest::Methods method, Functor &&handler)
+    \since 6.9
+
+    \overload
+
+    Overload of \l QHttpServer::route that takes the path pattern as the
+    string literal template argument \a PathPattern. Requests for \a method
+    are forwarded to \a handler. The rule will be valid until the
+    QHttpServer is destroyed.
+
+    This overload is only available with C++20.
+*/
+
+/*! \fn template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor> Rule *QHttpServer::route(Functor &&handler)
+    \since 6.9
+
+    \overload
+
+    Overload of \l QHttpServer::route that takes the path pattern as the
+    string literal template argument \a PathPattern, for
+    \l QHttpServerRequest::Method::AnyKnown. All requests are forwarded to
+    \a handler. The rule will be valid until the QHttpServer is destroyed.
+
+    This overload is only available with C++20.
+*/
+
+/*! \fn template <typename Rule = QHttpServerRouterRule, typename Functor> Rule *QHttpServer::route(const QString &pathPattern, QHttpServerRequest::Methods method, QThreadPool *threadPool, Functor &&handler)
+    \since 6.9
+    \overload
+
+    Adds a new rule to the server's \l{QHttpServerRouter} for requests
+    matching \a pathPattern and \a method, whose \a handler is run on
+    \a threadPool. The rule will be valid until the QHttpServer is destroyed.
+
+    Use this overload for handlers that block, such as CPU intensive ones,
+    so that they do not hold up the thread of the connection. The handler
+    returns its response like the handlers of the other overloads, and the
+    response is sent from the thread of the connection once the handler
+    has returned. The handler may take a \c {const QHttpServerRequest &}
+    argument, but not a \c {QHttpServerResponder &} one.
+
+    The number of requests waiting for a thread of \a threadPool can be
+    limited with QHttpServerConfiguration::setThreadPoolQueueLimit(). The
+    requests beyond the limit, as well as those arriving after \a threadPool
+    was destroyed, are answered with
+    \l{QHttpServerResponder::StatusCode}{ServiceUnavailable}.
+
+    \code
+    QThreadPool pool;
+    server.route("/thumbnail/", QHttpServerRequest::Method::Get, &pool, [] (qint64 id) {
+        return QHttpServerResponse("image/png", renderThumbnail(id));
+    });
+    \endcode
+
+    \sa QHttpServerConfiguration::setThreadPoolQueueLimit()
+*/
+
+/*! \fn template <typename Rule = QHttpServerRouterRule, typename Functor> Rule *QHttpServer::route(const QString &pathPattern, QThreadPool *threadPool, Functor &&handler)
+    \since 6.9
+    \overload
+
+    Adds a new rule to the server's \l{QHttpServerRouter} for requests
+    matching \a pathPattern with any known method, whose \a handler is run
+    on \a threadPool. The rule will be valid until the QHttpServer is
+    destroyed.
+*/
+
 /*!
     Destroys a QHttpServer.
+
+    Any worker threads are stopped before the router is destroyed.
 */
 QHttpServer::~QHttpServer()
 {
+    setWorkerThreadCount(0);
 }
 
 /*!
@@ -242,7 +432,8 @@ const QHttpServerRouter *QHttpServer::router() const
     QHttpServerRequest &, QHttpServerResponder &)}. The \a slot can also be a
     function pointer, non-mutable lambda, or any other copiable callable with
     const call operator. In that case the \a receiver will be a context object.
-    The handler will be valid until the receiver object is destroyed.
+    The handler will be valid until the receiver object is destroyed. It is
+    called in the thread of the receiver.
 
     The default handler replies with status 404: Not Found.
 */
@@ -254,8 +445,6 @@ void QHttpServer::setMissingHandlerImpl(const QObject *context, QtPrivate::QSlot
 {
     Q_D(QHttpServer);
     auto slot = QtPrivate::SlotObjUniquePtr(handler);
-    if (!d->verifyThreadAffinity(context))
-        return;
     d->missingHandler = {context, std::move(slot)};
 }
 
@@ -280,7 +469,8 @@ void QHttpServer::clearMissingHandler()
     The \a slot can also be a function pointer, non-mutable lambda, or any other
     copiable callable with const call operator. In that case the \a receiver will
     be a context object and the handler will be valid until the context
-    object is destroyed.
+    object is destroyed. The handler is called in the thread of the context
+    object.
 
     Example:
 
@@ -302,11 +492,20 @@ void QHttpServer::addAfterRequestHandlerImpl(const QObject *context, QtPrivate::
 {
     Q_D(QHttpServer);
     auto slot = QtPrivate::SlotObjUniquePtr(handler);
-    if (!d->verifyThreadAffinity(context))
-        return;
     d->afterRequestHandlers.push_back({context, std::move(slot)});
 }
 
+/*!
+    \internal
+
+    Returns a copy of \a request for the handlers defined in the header,
+    which cannot use QHttpServerRequestPrivate::copy().
+*/
+std::shared_ptr<const QHttpServerRequest> QHttpServer::copyRequest(const QHttpServerRequest &request)
+{
+    return QHttpServerRequestPrivate::copy(request);
+}
+
 /*!
     \internal
 */
@@ -314,25 +513,130 @@ void QHttpServer::sendResponse(QHttpServerResponse &&response, const QHttpServer
                                QHttpServerResponder &&responder)
 {
     Q_D(QHttpServer);
-    for (auto &afterRequestHandler : d->afterRequestHandlers) {
-        if (afterRequestHandler.context && afterRequestHandler.slotObject &&
-            d->verifyThreadAffinity(afterRequestHandler.context)) {
-            void *args[] = { nullptr, const_cast<QHttpServerRequest *>(&request), &response };
-            afterRequestHandler.slotObject->call(const_cast<QObject *>(afterRequestHandler.context.data()), args);
+    d->callAfterRequestHandlers(0, std::move(response), request, std::move(responder));
+}
+
+/*!
+    \internal
+
+    Calls \a function in the current thread once \a request is canceled,
+    telling whether it was canceled because its deadline expired. This is
+    the thread of \a context, the context object of the handler, if the
+    handler was queued to it, or the thread of the connection otherwise.
+*/
+void QHttpServer::callWhenCanceled(const QHttpServerRequest &request, const QObject *context,
+                                   std::function<void(bool timedOut)> &&function)
+{
+    Q_D(QHttpServer);
+    QHttpServerRequestCancellation *cancellation = request.d->cancellation.get();
+    if (!cancellation)
+        return;
+
+    const QObject *receiver = context->thread() == QThread::currentThread()
+            ? context
+            : d->connectionContext();
+    Q_ASSERT(receiver->thread() == QThread::currentThread());
+    cancellation->onCanceled([cancellation, context = QPointer<QObject>(
+                                                    const_cast<QObject *>(receiver)),
+                              function = std::move(function)]() {
+        using Reason = QHttpServerRequestCancellation::Reason;
+        const bool timedOut = cancellation->reason() == Reason::TimedOut;
+        if (context) {
+            QMetaObject::invokeMethod(context, [function, timedOut] { function(timedOut); },
+                                      Qt::QueuedConnection);
         }
-    }
-    responder.sendResponse(response);
+    });
 }
 
 #if QT_CONFIG(future)
 void QHttpServer::sendResponse(QFuture<QHttpServerResponse> &&response,
                                const QHttpServerRequest &request, QHttpServerResponder &&responder)
 {
-    response.then(this,
-                  [this, &request,
-                   responder = std::move(responder)](QHttpServerResponse &&response) mutable {
-                      sendResponse(std::move(response), request, std::move(responder));
-                  });
+    sendResponse(std::move(response), QHttpServerRequestPrivate::copy(request),
+                 std::move(responder));
+}
+
+/*!
+    \internal
+
+    Sends the response \a response provides once it is ready, from the
+    thread of the connection. \a request is a copy of the request held until
+    then.
+*/
+void QHttpServer::sendResponse(QFuture<QHttpServerResponse> &&response,
+                               std::shared_ptr<const QHttpServerRequest> &&request,
+                               QHttpServerResponder &&responder)
+{
+    Q_D(QHttpServer);
+    // Stops computing a response that nobody waits for anymore.
+    const std::shared_ptr<QHttpServerRequestCancellation> cancellation = request->d->cancellation;
+    if (cancellation)
+        cancellation->onCanceled([response]() mutable { response.cancel(); });
+
+    // Continue in the thread of the connection, as the responder may only be
+    // used there.
+    QObject *context = d->connectionContext();
+    auto heldResponder = std::make_shared<QHttpServerResponder>(std::move(responder));
+    response.then(context,
+                  [this, request, heldResponder](QHttpServerResponse &&response) {
+                      sendResponse(std::move(response), *request, std::move(*heldResponder));
+                  })
+            .onCanceled(context, [this, request, heldResponder, cancellation] {
+                using Reason = QHttpServerRequestCancellation::Reason;
+                if (cancellation && cancellation->reason() == Reason::TimedOut) {
+                    qCDebug(lcHS) << "Request timed out:" << request->url().path();
+                    sendResponse(QHttpServerResponse(
+                                         QHttpServerResponder::StatusCode::ServiceUnavailable),
+                                 *request, std::move(*heldResponder));
+                }
+            });
+}
+
+/*!
+    \internal
+
+    Runs \a call on \a threadPool and sends the response it returns from the
+    thread of the connection, unless the number of calls waiting for a thread
+    of the pool, counted by \a queuedCalls, already reaches the limit of the
+    configuration. \a request is a copy of the request held until the
+    response is sent.
+*/
+void QHttpServer::sendResponseFromThreadPool(QThreadPool *threadPool,
+                                             const std::shared_ptr<QAtomicInt> &queuedCalls,
+                                             std::function<QHttpServerResponse()> &&call,
+                                             std::shared_ptr<const QHttpServerRequest> &&request,
+                                             QHttpServerResponder &&responder)
+{
+    if (!threadPool) {
+        qCWarning(lcHS) << "The thread pool of the route was destroyed:" << request->url().path();
+        sendResponse(QHttpServerResponse(QHttpServerResponder::StatusCode::ServiceUnavailable),
+                     *request, std::move(responder));
+        return;
+    }
+
+    // Taking the place in the queue and checking the limit is one step, so
+    // that concurrent requests cannot all pass the check.
+    const quint32 queueLimit = configuration().threadPoolQueueLimit();
+    const int queued = queuedCalls->fetchAndAddRelaxed(1);
+    if (queueLimit != 0 && quint32(queued) >= queueLimit) {
+        queuedCalls->deref();
+        qCDebug(lcHS) << "The thread pool queue of the route is full:" << request->url().path();
+        sendResponse(QHttpServerResponse(QHttpServerResponder::StatusCode::ServiceUnavailable),
+                     *request, std::move(responder));
+        return;
+    }
+
+    auto promise = std::make_shared<QPromise<QHttpServerResponse>>();
+    QFuture<QHttpServerResponse> future = promise->future();
+    promise->start();
+    threadPool->start([promise, call = std::move(call), queuedCalls]() {
+        queuedCalls->deref();
+        // The request was canceled while waiting for a thread.
+        if (!promise->isCanceled())
+            promise->addResult(call());
+        promise->finish();
+    });
+    sendResponse(std::move(future), std::move(request), std::move(responder));
 }
 #endif // QT_CONFIG(future)
 
@@ -9,13 +9,20 @@
 #include <QtHttpServer/qhttpserverrouter.h>
 #include <QtHttpServer/qhttpserverrouterrule.h>
 #include <QtHttpServer/qhttpserverresponse.h>
+#include <QtHttpServer/qhttpserverroutepattern_impl.h>
 #include <QtHttpServer/qhttpserverrouterviewtraits.h>
+#include <QtHttpServer/qhttpservertask.h>
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qpointer.h>
 
 #if QT_CONFIG(future)
 #  include <QtCore/qfuture.h>
+#  include <QtCore/qthreadpool.h>
 #endif
 
 #include <functional>
+#include <memory>
 #include <tuple>
 
 QT_BEGIN_NAMESPACE
@@ -80,6 +87,25 @@ public:
     template <typename Rule = QHttpServerRouterRule, typename Functor>
     Rule *route(const QString &pathPattern,
                 Functor &&handler);
+
+    template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor>
+    Rule *route(QHttpServerRequest::Methods method, const QObject *receiver, Functor &&slot);
+
+    template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor>
+    Rule *route(const QObject *receiver, Functor &&slot);
+
+    template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor>
+    Rule *route(QHttpServerRequest::Methods method, Functor &&handler);
+
+    template <auto PathPattern, typename Rule = QHttpServerRouterRule, typename Functor>
+    Rule *route(Functor &&handler);
+
+    template <typename Rule = QHttpServerRouterRule, typename Functor>
+    Rule *route(const QString &pathPattern, QHttpServerRequest::Methods method,
+                QThreadPool *threadPool, Functor &&handler);
+
+    template <typename Rule = QHttpServerRouterRule, typename Functor>
+    Rule *route(const QString &pathPattern, QThreadPool *threadPool, Functor &&handler);
 #else
     template<typename Rule = QHttpServerRouterRule, typename ViewHandler>
     Rule *route(const QString &pathPattern, QHttpServerRequest::Methods method,
@@ -120,6 +146,89 @@ public:
         return route<Rule>(pathPattern, method,
                            this, std::forward<ViewHandler>(viewHandler));
     }
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+    template<QtPrivate::RoutePattern PathPattern, typename Rule = QHttpServerRouterRule,
+             typename ViewHandler>
+    Rule *route(QHttpServerRequest::Methods method,
+                const typename QtPrivate::ContextTypeForFunctor<ViewHandler>::ContextType *context,
+                ViewHandler &&viewHandler)
+    {
+        using ViewTraits = QHttpServerRouterViewTraits<ViewHandler>;
+        static_assert(ViewTraits::Arguments::StaticAssert,
+                      "ViewHandler arguments are in the wrong order or not supported");
+        static_assert(PathPattern.placeholderCount() <= ViewTraits::Arguments::CapturableCount,
+                      "The path pattern has more <arg> placeholders than the ViewHandler has "
+                      "arguments to capture them");
+        if constexpr (PathPattern.isAscii()) {
+            static constexpr auto placeholders =
+                    PathPattern.template placeholderOffsets<PathPattern.placeholderCount()>();
+            return routeImpl<Rule, ViewHandler, ViewTraits>(
+                    PathPattern.toString(), method, context,
+                    std::forward<ViewHandler>(viewHandler),
+                    QSpan<const qsizetype>(placeholders.data(), placeholders.size()));
+        } else {
+            return routeImpl<Rule, ViewHandler, ViewTraits>(
+                    PathPattern.toString(), method, context,
+                    std::forward<ViewHandler>(viewHandler));
+        }
+    }
+
+    template<QtPrivate::RoutePattern PathPattern, typename Rule = QHttpServerRouterRule,
+             typename ViewHandler>
+    Rule *route(const typename QtPrivate::ContextTypeForFunctor<ViewHandler>::ContextType *context,
+                ViewHandler &&viewHandler)
+    {
+        return route<PathPattern, Rule>(QHttpServerRequest::Method::AnyKnown, context,
+                                        std::forward<ViewHandler>(viewHandler));
+    }
+
+    template<QtPrivate::RoutePattern PathPattern, typename Rule = QHttpServerRouterRule,
+             typename ViewHandler>
+    Rule *route(QHttpServerRequest::Methods method, ViewHandler &&viewHandler)
+    {
+        return route<PathPattern, Rule>(method, this, std::forward<ViewHandler>(viewHandler));
+    }
+
+    template<QtPrivate::RoutePattern PathPattern, typename Rule = QHttpServerRouterRule,
+             typename ViewHandler>
+    Rule *route(ViewHandler &&viewHandler)
+    {
+        return route<PathPattern, Rule>(QHttpServerRequest::Method::AnyKnown, this,
+                                        std::forward<ViewHandler>(viewHandler));
+    }
+#endif
+
+#if QT_CONFIG(future)
+    template<typename Rule = QHttpServerRouterRule, typename ViewHandler>
+    Rule *route(const QString &pathPattern, QHttpServerRequest::Methods method,
+                QThreadPool *threadPool, ViewHandler &&viewHandler)
+    {
+        using ViewTraits = QHttpServerRouterViewTraits<ViewHandler>;
+        static_assert(ViewTraits::Arguments::StaticAssert,
+                      "ViewHandler arguments are in the wrong order or not supported");
+        static_assert(ViewTraits::Arguments::PlaceholdersCount == 0
+                              || (ViewTraits::Arguments::PlaceholdersCount == 1
+                                  && ViewTraits::Arguments::Last::IsRequest::Value),
+                      "Handlers run on a thread pool cannot take a responder argument.");
+        static_assert(!std::is_same_v<typename ViewTraits::ReturnType, void>
+                              && !std::is_same_v<typename ViewTraits::ReturnType,
+                                                 QFuture<QHttpServerResponse>>
+                              && !QtPrivate::IsHttpServerTask<typename ViewTraits::ReturnType>,
+                      "Handlers run on a thread pool must return a response.");
+        auto routerHandler = createThreadPoolRouteHandler<ViewHandler, ViewTraits>(
+                threadPool, std::forward<ViewHandler>(viewHandler));
+        auto rule = std::make_unique<Rule>(pathPattern, method, this, std::move(routerHandler));
+        return reinterpret_cast<Rule*>(router()->addRule<ViewHandler, ViewTraits>(std::move(rule)));
+    }
+
+    template<typename Rule = QHttpServerRouterRule, typename ViewHandler>
+    Rule *route(const QString &pathPattern, QThreadPool *threadPool, ViewHandler &&viewHandler)
+    {
+        return route<Rule>(pathPattern, QHttpServerRequest::Method::AnyKnown, threadPool,
+                           std::forward<ViewHandler>(viewHandler));
+    }
+#endif
 #endif
 
 #ifdef Q_QDOC
@@ -167,10 +276,41 @@ private:
                        QHttpServerResponder &responder) mutable {
                 auto boundViewHandler = QHttpServerRouterRule::bindCaptured<ViewHandler, ViewTraits>(context,
                                                                std::forward<ViewHandler>(viewHandler), match);
-                responseImpl<ViewTraits>(boundViewHandler, request, std::move(responder));
+                responseImpl<ViewTraits>(context, boundViewHandler, request, std::move(responder));
         };
     }
 
+#if QT_CONFIG(future)
+    template<typename ViewHandler, typename ViewTraits>
+    auto createThreadPoolRouteHandler(QThreadPool *threadPool, ViewHandler &&viewHandler)
+    {
+        // Counts the requests of the route waiting for a thread of the pool
+        auto queuedCalls = std::make_shared<QAtomicInt>();
+        return [this, threadPool = QPointer<QThreadPool>(threadPool), queuedCalls, viewHandler](
+                       const QRegularExpressionMatch &match,
+                       const QHttpServerRequest &request,
+                       QHttpServerResponder &responder) mutable {
+                auto boundViewHandler = QHttpServerRouterRule::bindCaptured<ViewHandler, ViewTraits>(
+                        this, std::forward<ViewHandler>(viewHandler), match);
+                std::shared_ptr<const QHttpServerRequest> heldRequest = copyRequest(request);
+                std::function<QHttpServerResponse()> call;
+                if constexpr (ViewTraits::Arguments::PlaceholdersCount == 0) {
+                    call = [boundViewHandler]() mutable {
+                        return QHttpServerResponse(boundViewHandler());
+                    };
+                } else {
+                    call = [boundViewHandler, heldRequest]() mutable {
+                        return QHttpServerResponse(boundViewHandler(*heldRequest));
+                    };
+                }
+                sendResponseFromThreadPool(threadPool, queuedCalls, std::move(call),
+                                           std::move(heldRequest), std::move(responder));
+        };
+    }
+#endif
+
+    static std::shared_ptr<const QHttpServerRequest> copyRequest(const QHttpServerRequest &request);
+
     template<typename Rule, typename ViewHandler, typename ViewTraits>
     Rule *routeImpl(const QString &pathPattern,
                     const typename QtPrivate::ContextTypeForFunctor<ViewHandler>::ContextType *context,
@@ -193,10 +333,79 @@ private:
         return reinterpret_cast<Rule*>(router()->addRule<ViewHandler, ViewTraits>(std::move(rule)));
     }
 
+    template<typename Rule, typename ViewHandler, typename ViewTraits>
+    Rule *routeImpl(const QString &pathPattern, QHttpServerRequest::Methods method,
+                    const typename QtPrivate::ContextTypeForFunctor<ViewHandler>::ContextType *context,
+                    ViewHandler &&viewHandler, QSpan<const qsizetype> placeholders)
+    {
+        auto routerHandler = createRouteHandler<ViewHandler, ViewTraits>(context,
+                                                                         std::forward<ViewHandler>(viewHandler));
+        auto rule = std::make_unique<Rule>(pathPattern, method, context, std::move(routerHandler));
+        static_cast<QHttpServerRouterRule *>(rule.get())->setPlaceholderOffsets(placeholders);
+        return reinterpret_cast<Rule*>(router()->addRule<ViewHandler, ViewTraits>(std::move(rule)));
+    }
+
+#ifdef QT_HTTPSERVER_HAS_COROUTINES
     template<typename ViewTraits, typename T>
-    void responseImpl(T &boundViewHandler, const QHttpServerRequest &request,
-                      QHttpServerResponder &&responder)
+    void taskResponseImpl(const QObject *context, T &boundViewHandler,
+                          const QHttpServerRequest &request, QHttpServerResponder &&responder)
     {
+        static_assert(std::is_same_v<typename ViewTraits::ReturnType,
+                                     QHttpServerTask<QHttpServerResponse>>,
+                      "Coroutine handlers must return QHttpServerTask<QHttpServerResponse>.");
+        static_assert(ViewTraits::Arguments::PlaceholdersCount == 0
+                              || (ViewTraits::Arguments::PlaceholdersCount == 1
+                                  && ViewTraits::Arguments::Last::IsRequest::Value),
+                      "Coroutine handlers cannot take a responder argument.");
+
+        // The coroutine refers to the handler, the arguments bound to it and
+        // the request, which have to outlive its frame.
+        auto handler = std::make_shared<T>(std::move(boundViewHandler));
+        std::shared_ptr<const QHttpServerRequest> heldRequest = copyRequest(request);
+        QHttpServerTask<QHttpServerResponse> task = [&]() {
+            if constexpr (ViewTraits::Arguments::PlaceholdersCount == 0)
+                return (*handler)();
+            else
+                return (*handler)(*heldRequest);
+        }();
+        auto heldResponder = std::make_shared<QHttpServerResponder>(std::move(responder));
+        auto started = std::move(task).start([this, handler, heldRequest, heldResponder](
+                                                     std::optional<QHttpServerResponse> &&response) {
+            Q_UNUSED(handler);
+            if (!response)
+                response.emplace(QHttpServerResponder::StatusCode::InternalServerError);
+            sendResponse(std::move(*response), *heldRequest, std::move(*heldResponder));
+        });
+
+        // A task still suspended when the request is canceled is destroyed,
+        // in this thread, and with it what its frame holds. The request is
+        // only referred to weakly, as it holds the cancellation token this
+        // is registered with.
+        callWhenCanceled(*heldRequest, context, [this, started,
+                                                 weakRequest = std::weak_ptr(heldRequest),
+                                                 heldResponder](bool timedOut) {
+            const std::shared_ptr<const QHttpServerRequest> request = weakRequest.lock();
+            if (!request || !QHttpServerTask<QHttpServerResponse>::destroyStarted(started))
+                return;
+            if (timedOut) {
+                sendResponse(QHttpServerResponse(
+                                     QHttpServerResponder::StatusCode::ServiceUnavailable),
+                             *request, std::move(*heldResponder));
+            }
+        });
+    }
+#endif
+
+    template<typename ViewTraits, typename T>
+    void responseImpl([[maybe_unused]] const QObject *context, T &boundViewHandler,
+                      const QHttpServerRequest &request, QHttpServerResponder &&responder)
+    {
+#ifdef QT_HTTPSERVER_HAS_COROUTINES
+        if constexpr (QtPrivate::IsHttpServerTask<typename ViewTraits::ReturnType>) {
+            taskResponseImpl<ViewTraits>(context, boundViewHandler, request,
+                                         std::move(responder));
+        } else
+#endif
         if constexpr (ViewTraits::Arguments::PlaceholdersCount == 0) {
             ResponseType<typename ViewTraits::ReturnType> response(boundViewHandler());
             sendResponse(std::move(response), request, std::move(responder));
@@ -229,10 +438,20 @@ private:
 
     void sendResponse(QHttpServerResponse &&response, const QHttpServerRequest &request,
                       QHttpServerResponder &&responder);
+    void callWhenCanceled(const QHttpServerRequest &request, const QObject *context,
+                          std::function<void(bool timedOut)> &&function);
 
 #if QT_CONFIG(future)
     void sendResponse(QFuture<QHttpServerResponse> &&response, const QHttpServerRequest &request,
                       QHttpServerResponder &&responder);
+    void sendResponse(QFuture<QHttpServerResponse> &&response,
+                      std::shared_ptr<const QHttpServerRequest> &&request,
+                      QHttpServerResponder &&responder);
+    void sendResponseFromThreadPool(QThreadPool *threadPool,
+                                    const std::shared_ptr<QAtomicInt> &queuedCalls,
+                                    std::function<QHttpServerResponse()> &&call,
+                                    std::shared_ptr<const QHttpServerRequest> &&request,
+                                    QHttpServerResponder &&responder);
 #endif
 };
 
@@ -47,7 +47,11 @@ public:
         QtPrivate::SlotObjUniquePtr slotObject;
     } missingHandler;
 
+    bool streamsRequestBody(const QHttpServerRequest &request) const override;
     void callMissingHandler(const QHttpServerRequest &request, QHttpServerResponder &responder);
+    void callAfterRequestHandlers(size_t first, QHttpServerResponse &&response,
+                                  const QHttpServerRequest &request,
+                                  QHttpServerResponder &&responder);
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,195 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <private/qhttpserverconcurrencylimiter_p.h>
+
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qtimer.h>
+
+#include <algorithm>
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+QHttpServerConcurrencyLimiter::Permit::~Permit()
+{
+    if (limiter)
+        limiter->release(Clock::now() - start);
+}
+
+/*!
+    \internal
+
+    Sets \a maxConcurrency as the maximum number of permits held at the same
+    time, \c 0 meaning no limit.
+*/
+void QHttpServerConcurrencyLimiter::setMaxConcurrency(quint32 maxConcurrency)
+{
+    QMutexLocker locker(&mutex);
+    if (maxLimit.loadRelaxed() == maxConcurrency)
+        return;
+    maxLimit.storeRelaxed(maxConcurrency);
+    adaptiveLimit = maxConcurrency;
+}
+
+/*!
+    \internal
+
+    Sets whether the limit follows the latency of the requests below the
+    maximum, as requested by \a enabled.
+*/
+void QHttpServerConcurrencyLimiter::setAdaptive(bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    if (adaptive == enabled)
+        return;
+    adaptive = enabled;
+    adaptiveLimit = maxLimit.loadRelaxed();
+}
+
+quint32 QHttpServerConcurrencyLimiter::currentLimit() const
+{
+    if (!maxLimit.loadRelaxed())
+        return std::numeric_limits<quint32>::max();
+    if (adaptive)
+        return std::max(quint32(adaptiveLimit), 1u);
+    return maxLimit.loadRelaxed();
+}
+
+/*!
+    \internal
+
+    Counts one more request in flight if the limit is not reached. Waiting
+    requests come first, so none is counted while there are some. Called
+    with the mutex held.
+*/
+bool QHttpServerConcurrencyLimiter::tryReserve()
+{
+    // The waiters that timed out stay queued until they reach the front.
+    while (!waiters.empty() && waiters.front()->done.loadRelaxed())
+        waiters.pop_front();
+    if (running >= currentLimit() || !waiters.empty())
+        return false;
+    ++running;
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns a permit if the limit is not reached, or a null permit otherwise.
+*/
+QHttpServerConcurrencyLimiter::Permit QHttpServerConcurrencyLimiter::tryAcquire()
+{
+    QMutexLocker locker(&mutex);
+    if (!tryReserve())
+        return {};
+    locker.unlock();
+    return Permit(shared_from_this());
+}
+
+/*!
+    \internal
+
+    Calls \a admit with a permit, right away if the limit is not reached, or
+    in the thread of \a context as soon as one is released. If none is
+    released within \a timeout, \a reject is called instead.
+*/
+void QHttpServerConcurrencyLimiter::acquire(const QObject *context,
+                                            std::chrono::milliseconds timeout,
+                                            AdmitFunction &&admit, RejectFunction &&reject)
+{
+    QMutexLocker locker(&mutex);
+    if (tryReserve()) {
+        locker.unlock();
+        admit(Permit(shared_from_this()));
+        return;
+    }
+    if (timeout <= std::chrono::milliseconds::zero()) {
+        locker.unlock();
+        reject();
+        return;
+    }
+
+    auto waiter = std::make_shared<Waiter>();
+    waiter->context = context;
+    waiter->admit = std::move(admit);
+    waiter->reject = std::move(reject);
+    waiters.push_back(waiter);
+    locker.unlock();
+
+    QTimer::singleShot(timeout, context, [waiter]() {
+        if (waiter->done.testAndSetRelaxed(0, 1))
+            waiter->reject();
+    });
+}
+
+/*!
+    \internal
+
+    Releases the permit of a request that took \a latency, handing it over to
+    the first request still waiting, if any.
+*/
+void QHttpServerConcurrencyLimiter::release(Clock::duration latency)
+{
+    std::shared_ptr<Waiter> next;
+    QObject *context = nullptr;
+    {
+        QMutexLocker locker(&mutex);
+        adapt(latency);
+        while (!waiters.empty() && running <= currentLimit()) {
+            std::shared_ptr<Waiter> waiter = std::move(waiters.front());
+            waiters.pop_front();
+            context = const_cast<QObject *>(waiter->context.data());
+            if (context && waiter->done.testAndSetRelaxed(0, 1)) {
+                next = std::move(waiter);
+                break;
+            }
+        }
+        if (!next)
+            --running;
+    }
+    if (!next)
+        return;
+
+    // The permit is released again if the context is destroyed before the
+    // call is delivered.
+    auto permit = std::make_shared<Permit>(Permit(shared_from_this()));
+    QMetaObject::invokeMethod(context, [next, permit]() {
+        next->admit(std::move(*permit));
+    }, Qt::QueuedConnection);
+}
+
+/*!
+    \internal
+
+    Updates the adaptive limit with the \a latency of a request. Called with
+    the mutex held.
+*/
+void QHttpServerConcurrencyLimiter::adapt(Clock::duration latency)
+{
+    if (!adaptive)
+        return;
+
+    // The lowest latency seen approximates the latency without queuing. It
+    // slowly drifts up, so that it follows a workload that gets heavier.
+    if (latency < baseLatency)
+        baseLatency = latency;
+    else
+        baseLatency += (latency - baseLatency) / 1024;
+
+    const double maximum = maxLimit.loadRelaxed();
+    if (latency > 2 * baseLatency) {
+        // Decrease at most once per request duration, so that the requests
+        // admitted under the previous limit do not decrease it again.
+        const auto now = Clock::now();
+        if (now - lastDecrease > latency) {
+            adaptiveLimit = std::max(adaptiveLimit * 0.9, 1.0);
+            lastDecrease = now;
+        }
+    } else {
+        adaptiveLimit = std::min(adaptiveLimit + 1.0 / std::max(adaptiveLimit, 1.0), maximum);
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,116 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERCONCURRENCYLIMITER_P_H
+#define QHTTPSERVERCONCURRENCYLIMITER_P_H
+
+#include <QtHttpServer/qthttpserverglobal.h>
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qpointer.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of QHttpServer. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+
+QT_BEGIN_NAMESPACE
+
+// Bounds the number of requests in flight. A request holds a Permit from
+// the moment it is admitted until its responder is destroyed. Requests that
+// cannot be admitted right away may wait for a permit to be released.
+//
+// In adaptive mode, the limit is lowered when the latency of the requests
+// grows past twice the lowest latency seen, and raised back by one every
+// limit requests otherwise, up to the configured maximum.
+class QHttpServerConcurrencyLimiter
+    : public std::enable_shared_from_this<QHttpServerConcurrencyLimiter>
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Permit
+    {
+    public:
+        Permit() = default;
+        Permit(Permit &&other) noexcept = default;
+        Permit &operator=(Permit &&other) noexcept
+        {
+            Permit moved(std::move(other));
+            std::swap(limiter, moved.limiter);
+            std::swap(start, moved.start);
+            return *this;
+        }
+        ~Permit();
+
+        explicit operator bool() const { return bool(limiter); }
+        bool isFrom(const QHttpServerConcurrencyLimiter *from) const
+        {
+            return limiter.get() == from;
+        }
+
+    private:
+        friend class QHttpServerConcurrencyLimiter;
+        explicit Permit(std::shared_ptr<QHttpServerConcurrencyLimiter> from)
+            : limiter(std::move(from)), start(Clock::now())
+        {
+        }
+
+        std::shared_ptr<QHttpServerConcurrencyLimiter> limiter;
+        Clock::time_point start;
+    };
+
+    using AdmitFunction = std::function<void(Permit &&)>;
+    using RejectFunction = std::function<void()>;
+
+    void setMaxConcurrency(quint32 maxConcurrency);
+    void setAdaptive(bool enabled);
+    quint32 maxConcurrency() const { return quint32(maxLimit.loadRelaxed()); }
+    bool isLimited() const { return maxLimit.loadRelaxed() != 0; }
+
+    Permit tryAcquire();
+    void acquire(const QObject *context, std::chrono::milliseconds timeout,
+                 AdmitFunction &&admit, RejectFunction &&reject);
+
+private:
+    struct Waiter
+    {
+        QPointer<const QObject> context;
+        AdmitFunction admit;
+        RejectFunction reject;
+        // Set by whichever of the admission and the timeout comes first.
+        QAtomicInt done;
+    };
+
+    bool tryReserve();
+    void release(Clock::duration latency);
+    void adapt(Clock::duration latency);
+    quint32 currentLimit() const;
+
+    QAtomicInteger<quint32> maxLimit;
+
+    // Guarded by mutex.
+    mutable QMutex mutex;
+    bool adaptive = false;
+    double adaptiveLimit = 0;
+    quint32 running = 0;
+    Clock::duration baseLatency = Clock::duration::max();
+    Clock::time_point lastDecrease;
+    std::deque<std::shared_ptr<Waiter>> waiters;
+};
+
+QT_END_NAMESPACE
+
+#endif // QHTTPSERVERCONCURRENCYLIMITER_P_H
@@ -0,0 +1,395 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtHttpServer/qhttpserverconfiguration.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QHttpServerConfiguration
+    \since 6.9
+    \inmodule QtHttpServer
+    \brief The QHttpServerConfiguration class controls server parameters.
+
+    QHttpServerConfiguration holds the limits a QAbstractHttpServer applies
+    to the connections it accepts. Set it with
+    QAbstractHttpServer::setConfiguration(); new values take effect for
+    requests received after the call.
+
+    \sa QAbstractHttpServer::setConfiguration(), QHttp2Configuration
+*/
+
+class QHttpServerConfigurationPrivate : public QSharedData
+{
+public:
+    quint32 maxRequestsPerSecond = 0;
+    qint64 maxRequestBodySize = 0;
+    quint32 threadPoolQueueLimit = 0;
+    quint32 maxConcurrentRequests = 0;
+    bool adaptiveConcurrency = false;
+    std::chrono::milliseconds admissionTimeout{ 0 };
+    quint32 maxConnections = 0;
+    quint32 maxConnectionsPerListener = 0;
+    std::chrono::milliseconds requestTimeout{ 0 };
+};
+
+QT_DEFINE_QESDP_SPECIALIZATION_DTOR(QHttpServerConfigurationPrivate)
+
+/*!
+    Default constructs a QHttpServerConfiguration object.
+
+    Such a configuration has no limits set.
+*/
+QHttpServerConfiguration::QHttpServerConfiguration()
+    : d(new QHttpServerConfigurationPrivate)
+{
+}
+
+/*!
+    Copy-constructs this QHttpServerConfiguration from \a other.
+*/
+QHttpServerConfiguration::QHttpServerConfiguration(const QHttpServerConfiguration &other)
+    = default;
+
+/*!
+    \fn QHttpServerConfiguration::QHttpServerConfiguration(QHttpServerConfiguration &&other) noexcept
+
+    Move-constructs this QHttpServerConfiguration from \a other.
+*/
+
+/*!
+    Copy-assigns \a other to this QHttpServerConfiguration.
+*/
+QHttpServerConfiguration &
+QHttpServerConfiguration::operator=(const QHttpServerConfiguration &other) = default;
+
+/*!
+    \fn QHttpServerConfiguration &QHttpServerConfiguration::operator=(QHttpServerConfiguration &&other) noexcept
+
+    Move-assigns \a other to this QHttpServerConfiguration.
+*/
+
+/*!
+    Destructor.
+*/
+QHttpServerConfiguration::~QHttpServerConfiguration()
+    = default;
+
+/*!
+    \fn void QHttpServerConfiguration::swap(QHttpServerConfiguration &other) noexcept
+
+    Swaps this configuration with the \a other configuration.
+*/
+
+/*!
+    Sets \a maxRequests as the maximum number of requests a single connection
+    may issue per second. A value of \c 0 disables the limit.
+
+    On HTTP/2 connections, streams opened beyond the limit are refused with
+    an \c RST_STREAM frame carrying the \c REFUSED_STREAM error code, which
+    tells the client the request was not processed and may be retried. A
+    connection that keeps opening streams after being refused receives a
+    \c GOAWAY frame.
+
+    On HTTP/1.1 connections, requests beyond the limit are answered with
+    \l{QHttpServerResponder::StatusCode}{TooManyRequests}.
+
+    The number of streams a client may keep open at the same time on an
+    HTTP/2 connection is controlled by
+    QHttp2Configuration::setMaxConcurrentStreams().
+
+    \sa rateLimitPerSecond(), QAbstractHttpServer::setHttp2Configuration()
+*/
+void QHttpServerConfiguration::setRateLimitPerSecond(quint32 maxRequests)
+{
+    d.detach();
+    d->maxRequestsPerSecond = maxRequests;
+}
+
+/*!
+    Returns the maximum number of requests a single connection may issue per
+    second. The default is \c 0, which means no limit.
+
+    \sa setRateLimitPerSecond()
+*/
+quint32 QHttpServerConfiguration::rateLimitPerSecond() const
+{
+    return d->maxRequestsPerSecond;
+}
+
+/*!
+    Sets \a size as the maximum size in bytes of a request body the server
+    accepts. A value of \c 0 disables the limit.
+
+    Request bodies are buffered in memory until the request is complete, so
+    this bounds the memory a single request can hold. The limit is checked
+    as the body is received: a request announcing a larger \c Content-Length,
+    or whose body grows past the limit, is answered with
+    \l{QHttpServerResponder::StatusCode}{PayloadTooLarge} without being
+    passed to the request handlers. The HTTP/2 stream is then reset, and an
+    HTTP/1.1 connection is closed.
+
+    \sa maxRequestBodySize()
+*/
+void QHttpServerConfiguration::setMaxRequestBodySize(qint64 size)
+{
+    d.detach();
+    d->maxRequestBodySize = size;
+}
+
+/*!
+    Returns the maximum size in bytes of a request body the server accepts.
+    The default is \c 0, which means no limit.
+
+    \sa setMaxRequestBodySize()
+*/
+qint64 QHttpServerConfiguration::maxRequestBodySize() const
+{
+    return d->maxRequestBodySize;
+}
+
+/*!
+    Sets \a maxQueuedRequests as the maximum number of requests to a route
+    that runs its handler on a thread pool, which may wait for a thread of
+    the pool. A value of \c 0 disables the limit.
+
+    Requests beyond the limit are answered with
+    \l{QHttpServerResponder::StatusCode}{ServiceUnavailable} without calling
+    the handler, so that a slow route cannot hold an unbounded number of
+    requests. The requests whose handler is running do not count towards the
+    limit.
+
+    \sa threadPoolQueueLimit(), QHttpServer::route()
+*/
+void QHttpServerConfiguration::setThreadPoolQueueLimit(quint32 maxQueuedRequests)
+{
+    d.detach();
+    d->threadPoolQueueLimit = maxQueuedRequests;
+}
+
+/*!
+    Returns the maximum number of requests to a route that runs its handler on
+    a thread pool, which may wait for a thread of the pool. The default is
+    \c 0, which means no limit.
+
+    \sa setThreadPoolQueueLimit()
+*/
+quint32 QHttpServerConfiguration::threadPoolQueueLimit() const
+{
+    return d->threadPoolQueueLimit;
+}
+
+/*!
+    Sets \a maxRequests as the maximum number of requests the server handles
+    at the same time, over all its connections. A value of \c 0 disables the
+    limit.
+
+    A request counts from the moment its handler is called until its
+    QHttpServerResponder is destroyed, which includes the time a QFuture or a
+    coroutine takes to produce the response. Requests beyond the limit wait
+    for up to admissionTimeout() for another request to finish, and are
+    answered with \l{QHttpServerResponder::StatusCode}{ServiceUnavailable}
+    and a \c Retry-After header if none does.
+
+    The number of requests handled at the same time by a single route can be
+    limited with QHttpServerRouterRule::setMaxConcurrentRequests().
+
+    \sa maxConcurrentRequests(), setAdaptiveConcurrencyEnabled()
+*/
+void QHttpServerConfiguration::setMaxConcurrentRequests(quint32 maxRequests)
+{
+    d.detach();
+    d->maxConcurrentRequests = maxRequests;
+}
+
+/*!
+    Returns the maximum number of requests the server handles at the same
+    time. The default is \c 0, which means no limit.
+
+    \sa setMaxConcurrentRequests()
+*/
+quint32 QHttpServerConfiguration::maxConcurrentRequests() const
+{
+    return d->maxConcurrentRequests;
+}
+
+/*!
+    Sets whether the limits on the number of requests handled at the same
+    time adapt to the latency of the requests, as requested by \a enabled.
+
+    With adaptive limits, the configured limits are maximums. A limit is
+    lowered when requests take more than twice as long as the fastest ones
+    seen, which happens when they queue for a resource, and is raised back
+    step by step while they do not. This keeps the latency low under bursts
+    without having to know the capacity of the handlers in advance.
+
+    \sa isAdaptiveConcurrencyEnabled(), setMaxConcurrentRequests(),
+        QHttpServerRouterRule::setMaxConcurrentRequests()
+*/
+void QHttpServerConfiguration::setAdaptiveConcurrencyEnabled(bool enabled)
+{
+    d.detach();
+    d->adaptiveConcurrency = enabled;
+}
+
+/*!
+    Returns whether the limits on the number of requests handled at the same
+    time adapt to the latency of the requests. The default is \c false.
+
+    \sa setAdaptiveConcurrencyEnabled()
+*/
+bool QHttpServerConfiguration::isAdaptiveConcurrencyEnabled() const
+{
+    return d->adaptiveConcurrency;
+}
+
+/*!
+    Sets \a timeout as the time a request beyond the limit on the number of
+    requests handled at the same time may wait to be handled. A timeout of
+    \c 0 answers such requests right away.
+
+    \sa admissionTimeout(), setMaxConcurrentRequests()
+*/
+void QHttpServerConfiguration::setAdmissionTimeout(std::chrono::milliseconds timeout)
+{
+    d.detach();
+    d->admissionTimeout = timeout;
+}
+
+/*!
+    Returns the time a request beyond the limit on the number of requests
+    handled at the same time may wait to be handled. The default is \c 0,
+    which means such requests are answered right away.
+
+    \sa setAdmissionTimeout()
+*/
+std::chrono::milliseconds QHttpServerConfiguration::admissionTimeout() const
+{
+    return d->admissionTimeout;
+}
+
+/*!
+    Sets \a maxConnections as the maximum number of connections the server
+    keeps open at the same time, over all the servers it is bound to. A
+    value of \c 0 disables the limit.
+
+    Once the limit is reached, the server stops accepting connections until
+    one of the open connections is closed. A TCP server is paused with
+    QTcpServer::pauseAccepting(), so that the clients beyond the limit wait
+    in the listen backlog of the operating system instead of holding file
+    descriptors and memory in the server. Connections upgraded to WebSocket
+    count until the QWebSocket is destroyed.
+
+    \sa maxConnections(), setMaxConnectionsPerListener()
+*/
+void QHttpServerConfiguration::setMaxConnections(quint32 maxConnections)
+{
+    d.detach();
+    d->maxConnections = maxConnections;
+}
+
+/*!
+    Returns the maximum number of connections the server keeps open at the
+    same time. The default is \c 0, which means no limit.
+
+    \sa setMaxConnections()
+*/
+quint32 QHttpServerConfiguration::maxConnections() const
+{
+    return d->maxConnections;
+}
+
+/*!
+    Sets \a maxConnections as the maximum number of connections accepted
+    from a single QTcpServer or QLocalServer that are open at the same time.
+    A value of \c 0 disables the limit.
+
+    This applies to each server passed to QAbstractHttpServer::bind(), and to
+    each socket listening in a worker thread. A server that reaches the
+    limit stops accepting connections the same way as with
+    setMaxConnections().
+
+    \sa maxConnectionsPerListener(), setMaxConnections()
+*/
+void QHttpServerConfiguration::setMaxConnectionsPerListener(quint32 maxConnections)
+{
+    d.detach();
+    d->maxConnectionsPerListener = maxConnections;
+}
+
+/*!
+    Returns the maximum number of connections accepted from a single
+    listening server that are open at the same time. The default is \c 0,
+    which means no limit.
+
+    \sa setMaxConnectionsPerListener()
+*/
+quint32 QHttpServerConfiguration::maxConnectionsPerListener() const
+{
+    return d->maxConnectionsPerListener;
+}
+
+/*!
+    Sets \a timeout as the time the server has to respond to a request, from
+    the moment the request is received. A timeout of \c 0 disables it.
+
+    The timeout sets the QHttpServerRequest::deadline() of the requests.
+    A request whose deadline expires is canceled: its QFuture is canceled,
+    and the request is answered with
+    \l{QHttpServerResponder::StatusCode}{ServiceUnavailable} if its
+    handler returned a QFuture.
+
+    \sa requestTimeout(), QHttpServerRequest::isCanceled()
+*/
+void QHttpServerConfiguration::setRequestTimeout(std::chrono::milliseconds timeout)
+{
+    d.detach();
+    d->requestTimeout = timeout;
+}
+
+/*!
+    Returns the time the server has to respond to a request. The default is
+    \c 0, which means no timeout.
+
+    \sa setRequestTimeout()
+*/
+std::chrono::milliseconds QHttpServerConfiguration::requestTimeout() const
+{
+    return d->requestTimeout;
+}
+
+/*!
+    \fn bool QHttpServerConfiguration::operator==(const QHttpServerConfiguration &lhs, const QHttpServerConfiguration &rhs) noexcept
+
+    Returns \c true if \a lhs and \a rhs have the same set of configuration
+    parameters.
+*/
+
+/*!
+    \fn bool QHttpServerConfiguration::operator!=(const QHttpServerConfiguration &lhs, const QHttpServerConfiguration &rhs) noexcept
+
+    Returns \c true if \a lhs and \a rhs do not have the same set of
+    configuration parameters.
+*/
+
+/*!
+    \internal
+*/
+bool comparesEqual(const QHttpServerConfiguration &lhs,
+                   const QHttpServerConfiguration &rhs) noexcept
+{
+    if (lhs.d == rhs.d)
+        return true;
+
+    return lhs.d->maxRequestsPerSecond == rhs.d->maxRequestsPerSecond
+            && lhs.d->maxRequestBodySize == rhs.d->maxRequestBodySize
+            && lhs.d->threadPoolQueueLimit == rhs.d->threadPoolQueueLimit
+            && lhs.d->maxConcurrentRequests == rhs.d->maxConcurrentRequests
+            && lhs.d->adaptiveConcurrency == rhs.d->adaptiveConcurrency
+            && lhs.d->admissionTimeout == rhs.d->admissionTimeout
+            && lhs.d->maxConnections == rhs.d->maxConnections
+            && lhs.d->maxConnectionsPerListener == rhs.d->maxConnectionsPerListener
+            && lhs.d->requestTimeout == rhs.d->requestTimeout;
+}
+
+QT_END_NAMESPACE
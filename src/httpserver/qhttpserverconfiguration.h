@@ -0,0 +1,73 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERCONFIGURATION_H
+#define QHTTPSERVERCONFIGURATION_H
+
+#include <QtHttpServer/qthttpserverglobal.h>
+
+#include <QtCore/qcompare.h>
+#include <QtCore/qshareddata.h>
+
+#include <chrono>
+
+QT_BEGIN_NAMESPACE
+
+class QHttpServerConfigurationPrivate;
+QT_DECLARE_QESDP_SPECIALIZATION_DTOR_WITH_EXPORT(QHttpServerConfigurationPrivate,
+                                                 Q_HTTPSERVER_EXPORT)
+
+class QHttpServerConfiguration
+{
+public:
+    Q_HTTPSERVER_EXPORT QHttpServerConfiguration();
+    Q_HTTPSERVER_EXPORT QHttpServerConfiguration(const QHttpServerConfiguration &other);
+    QHttpServerConfiguration(QHttpServerConfiguration &&other) noexcept = default;
+    Q_HTTPSERVER_EXPORT QHttpServerConfiguration &
+    operator=(const QHttpServerConfiguration &other);
+    QT_MOVE_ASSIGNMENT_OPERATOR_IMPL_VIA_PURE_SWAP(QHttpServerConfiguration)
+    Q_HTTPSERVER_EXPORT ~QHttpServerConfiguration();
+
+    void swap(QHttpServerConfiguration &other) noexcept { d.swap(other.d); }
+
+    Q_HTTPSERVER_EXPORT void setRateLimitPerSecond(quint32 maxRequests);
+    Q_HTTPSERVER_EXPORT quint32 rateLimitPerSecond() const;
+
+    Q_HTTPSERVER_EXPORT void setMaxRequestBodySize(qint64 size);
+    Q_HTTPSERVER_EXPORT qint64 maxRequestBodySize() const;
+
+    Q_HTTPSERVER_EXPORT void setThreadPoolQueueLimit(quint32 maxQueuedRequests);
+    Q_HTTPSERVER_EXPORT quint32 threadPoolQueueLimit() const;
+
+    Q_HTTPSERVER_EXPORT void setMaxConcurrentRequests(quint32 maxRequests);
+    Q_HTTPSERVER_EXPORT quint32 maxConcurrentRequests() const;
+
+    Q_HTTPSERVER_EXPORT void setAdaptiveConcurrencyEnabled(bool enabled);
+    Q_HTTPSERVER_EXPORT bool isAdaptiveConcurrencyEnabled() const;
+
+    Q_HTTPSERVER_EXPORT void setAdmissionTimeout(std::chrono::milliseconds timeout);
+    Q_HTTPSERVER_EXPORT std::chrono::milliseconds admissionTimeout() const;
+
+    Q_HTTPSERVER_EXPORT void setMaxConnections(quint32 maxConnections);
+    Q_HTTPSERVER_EXPORT quint32 maxConnections() const;
+
+    Q_HTTPSERVER_EXPORT void setMaxConnectionsPerListener(quint32 maxConnections);
+    Q_HTTPSERVER_EXPORT quint32 maxConnectionsPerListener() const;
+
+    Q_HTTPSERVER_EXPORT void setRequestTimeout(std::chrono::milliseconds timeout);
+    Q_HTTPSERVER_EXPORT std::chrono::milliseconds requestTimeout() const;
+
+private:
+    QExplicitlySharedDataPointer<QHttpServerConfigurationPrivate> d;
+
+    Q_HTTPSERVER_EXPORT friend bool
+    comparesEqual(const QHttpServerConfiguration &lhs,
+                  const QHttpServerConfiguration &rhs) noexcept;
+    Q_DECLARE_EQUALITY_COMPARABLE(QHttpServerConfiguration)
+};
+
+Q_DECLARE_SHARED(QHttpServerConfiguration)
+
+QT_END_NAMESPACE
+
+#endif // QHTTPSERVERCONFIGURATION_H
@@ -3,6 +3,7 @@
 
 #include "qhttpserverhttp1protocolhandler_p.h"
 
+#include <QtCore/qcoreevent.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qmetaobject.h>
 #include <QtCore/qthread.h>
@@ -27,6 +28,7 @@ static const std::map<QHttpServerResponder::StatusCode, QByteArray> statusString
     XX(Continue, "Continue"),
     XX(SwitchingProtocols, "Switching Protocols"),
     XX(Processing, "Processing"),
+    XX(EarlyHints, "Early Hints"),
     XX(Ok, "OK"),
     XX(Created, "Created"),
     XX(Accepted, "Accepted"),
@@ -216,8 +218,8 @@ struct IOChunkedTransfer
 
 
 QHttpServerHttp1ProtocolHandler::QHttpServerHttp1ProtocolHandler(QAbstractHttpServer *server,
-                                                                 QIODevice *socket)
-    : QHttpServerStream(server),
+                                                                 QIODevice *socket, QObject *parent)
+    : QHttpServerStream(parent),
       server(server),
       socket(socket),
       tcpSocket(qobject_cast<QTcpSocket *>(socket)),
@@ -254,6 +256,12 @@ void QHttpServerHttp1ProtocolHandler::responderDestroyed()
     }
     Q_ASSERT(handlingRequest);
     handlingRequest = false;
+    requestTimer.stop();
+
+    if (draining) {
+        closeIfDrained();
+        return;
+    }
 
     if (tcpSocket) {
         if (tcpSocket->state() != QAbstractSocket::ConnectedState) {
@@ -285,6 +293,69 @@ void QHttpServerHttp1ProtocolHandler::socketDisconnected()
 {
     if (!handlingRequest)
         deleteLater();
+    else
+        cancelRequest(QHttpServerRequestCancellation::Reason::Disconnected);
+}
+
+void QHttpServerHttp1ProtocolHandler::drain()
+{
+    draining = true;
+    closeIfDrained();
+}
+
+void QHttpServerHttp1ProtocolHandler::abort()
+{
+    if (protocolChanged)
+        return;
+    if (handlingRequest)
+        cancelRequest(QHttpServerRequestCancellation::Reason::Aborted);
+    if (tcpSocket)
+        tcpSocket->abort();
+#if QT_CONFIG(localserver)
+    else if (localSocket)
+        localSocket->abort();
+#endif
+}
+
+void QHttpServerHttp1ProtocolHandler::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != requestTimer.timerId()) {
+        QHttpServerStream::timerEvent(event);
+        return;
+    }
+    requestTimer.stop();
+    if (handlingRequest)
+        cancelRequest(QHttpServerRequestCancellation::Reason::TimedOut);
+}
+
+void QHttpServerHttp1ProtocolHandler::cancelRequest(QHttpServerRequestCancellation::Reason reason)
+{
+    if (request.d->cancellation) {
+        qCDebug(lcHttpServerHttp1Handler) << "Canceling request:" << request;
+        request.d->cancellation->cancel(reason);
+    }
+}
+
+void QHttpServerHttp1ProtocolHandler::closeIfDrained()
+{
+    if (!draining || handlingRequest || protocolChanged || transferSource)
+        return;
+
+    qCDebug(lcHttpServerHttp1Handler, "Closing drained connection");
+    disconnect(socket, &QIODevice::readyRead, this, &QHttpServerHttp1ProtocolHandler::handleReadyRead);
+    if (tcpSocket) {
+        if (tcpSocket->state() == QAbstractSocket::UnconnectedState)
+            deleteLater();
+        else
+            tcpSocket->disconnectFromHost();
+#if QT_CONFIG(localserver)
+    } else if (localSocket) {
+        if (localSocket->state() == QLocalSocket::UnconnectedState)
+            deleteLater();
+        else
+            localSocket->disconnectFromServer();
+#endif
+    }
 }
 
 void QHttpServerHttp1ProtocolHandler::handleReadyRead()
@@ -305,6 +376,11 @@ void QHttpServerHttp1ProtocolHandler::handleReadyRead()
         return;
     }
 
+    if (exceedsMaxRequestBodySize()) {
+        rejectRequest(QHttpServerResponder::StatusCode::PayloadTooLarge);
+        return;
+    }
+
     if (request.d->state != QHttpServerRequestPrivate::State::AllDone)
         return; // Partial read
 
@@ -330,8 +406,22 @@ void QHttpServerHttp1ProtocolHandler::handleReadyRead()
                         socket->disconnect();
                         socket->rollbackTransaction();
                         socket->setParent(nullptr);
-                        server->d_func()->websocketServer.handleConnection(tcpSocket);
-                        Q_EMIT socket->readyRead();
+                        auto *websocketServer = &server->d_func()->websocketServer;
+                        if (websocketServer->thread() == QThread::currentThread()) {
+                            websocketServer->handleConnection(tcpSocket);
+                            Q_EMIT socket->readyRead();
+                        } else {
+                            // Handled by a worker thread, while the WebSocket
+                            // server lives in the thread of the HTTP server.
+                            tcpSocket->moveToThread(websocketServer->thread());
+                            QMetaObject::invokeMethod(
+                                    websocketServer,
+                                    [websocketServer, tcpSocket] {
+                                        websocketServer->handleConnection(tcpSocket);
+                                        Q_EMIT tcpSocket->readyRead();
+                                    },
+                                    Qt::QueuedConnection);
+                        }
                     } else {
                         qCDebug(lcHttpServerHttp1Handler, "WebSocket upgrade denied: %ls",
                                 qUtf16Printable(QLatin1StringView(upgradeResponse.denyMessage())));
@@ -360,8 +450,14 @@ void QHttpServerHttp1ProtocolHandler::handleReadyRead()
 
     socket->commitTransaction();
 
-    if (!server->handleRequest(request, responder))
+    const QHttpServerConfiguration configuration = server->configuration();
+    startCancellation(request, configuration.requestTimeout(), &requestTimer);
+    if (!requestRate.tryAcquire(configuration.rateLimitPerSecond())) {
+        qCDebug(lcHttpServerHttp1Handler, "Request rate limit exceeded");
+        responder.write(QHttpServerResponder::StatusCode::TooManyRequests);
+    } else if (!server->handleRequest(request, responder)) {
         server->missingHandler(request, responder);
+    }
 
     if (handlingRequest)
         disconnect(socket, &QIODevice::readyRead, this, &QHttpServerHttp1ProtocolHandler::handleReadyRead);
@@ -369,6 +465,40 @@ void QHttpServerHttp1ProtocolHandler::handleReadyRead()
         QMetaObject::invokeMethod(socket, &QIODevice::readyRead, Qt::QueuedConnection);
 }
 
+bool QHttpServerHttp1ProtocolHandler::exceedsMaxRequestBodySize() const
+{
+    const qint64 maxSize = server->configuration().maxRequestBodySize();
+    if (maxSize == 0)
+        return false;
+
+    // Checked while the request is still being read, so that an announced
+    // Content-Length or a growing chunked body is refused early.
+    return request.d->bodyLength > maxSize || request.d->bodyBuffer.byteAmount() > maxSize
+            || request.d->body.size() > maxSize;
+}
+
+void QHttpServerHttp1ProtocolHandler::rejectRequest(QHttpServerResponder::StatusCode status)
+{
+    qCDebug(lcHttpServerHttp1Handler) << "Rejecting request with status" << status;
+
+    // The rest of the request is not read, so the connection can't be reused
+    disconnect(socket, &QIODevice::readyRead, this, &QHttpServerHttp1ProtocolHandler::handleReadyRead);
+    socket->commitTransaction();
+
+    QHttpHeaders headers;
+    headers.append(QHttpHeaders::WellKnownHeader::ContentLength, "0");
+    headers.append(QHttpHeaders::WellKnownHeader::Connection, "close");
+    writeStatusAndHeaders(status, headers);
+    state = TransferState::Ready;
+
+    if (tcpSocket)
+        tcpSocket->disconnectFromHost();
+#if QT_CONFIG(localserver)
+    else if (localSocket)
+        localSocket->disconnectFromServer();
+#endif
+}
+
 void QHttpServerHttp1ProtocolHandler::write(const QByteArray &body, const QHttpHeaders &headers,
                                         QHttpServerResponder::StatusCode status, quint32 streamId)
 {
@@ -428,11 +558,32 @@ void QHttpServerHttp1ProtocolHandler::write(QIODevice *data, const QHttpHeaders
         return;
     }
 
+    // A drained connection is closed once the transfer is done.
+    transferSource = input.get();
+    connect(input.get(), &QObject::destroyed, this, &QHttpServerHttp1ProtocolHandler::closeIfDrained,
+            Qt::QueuedConnection);
+
     // input takes ownership of the IOChunkedTransfer pointer inside his constructor
     new IOChunkedTransfer<>(input.release(), socket);
     state = TransferState::Ready;
 }
 
+void QHttpServerHttp1ProtocolHandler::writeInformational(QHttpServerResponder::StatusCode status,
+                                                         const QHttpHeaders &headers,
+                                                         quint32 streamId)
+{
+    Q_UNUSED(streamId);
+    Q_ASSERT(state == TransferState::Ready);
+    // HTTP/1.0 clients do not understand interim responses, RFC 9110 15.2.
+    const int major = request.d->parser.getMajorVersion();
+    if (major < 1 || (major == 1 && request.d->parser.getMinorVersion() < 1)) {
+        qCDebug(lcHttpServerHttp1Handler, "Not sending %d to a HTTP/1.0 client", int(status));
+        return;
+    }
+    writeStatusAndHeaders(status, headers);
+    state = TransferState::Ready;
+}
+
 void QHttpServerHttp1ProtocolHandler::writeBeginChunked(const QHttpHeaders &headers,
                                                     QHttpServerResponder::StatusCode status,
                                                     quint32 streamId)
@@ -497,6 +648,11 @@ void QHttpServerHttp1ProtocolHandler::writeStatusAndHeaders(QHttpServerResponder
         payload.append(QByteArrayView(name.data(), name.size()) + ": "
                        + headers.valueAt(i).toByteArray() + "\r\n");
     }
+    // Tells the client of a drained connection not to send further requests.
+    if (draining && quint32(status) >= 200
+        && !headers.contains(QHttpHeaders::WellKnownHeader::Connection)) {
+        payload.append("Connection: close\r\n");
+    }
     payload.append("\r\n");
     write(payload);
     state = TransferState::HeadersSent;
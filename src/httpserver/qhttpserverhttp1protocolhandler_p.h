@@ -6,8 +6,11 @@
 
 #include <QtHttpServer/qthttpserverglobal.h>
 #include <QtHttpServer/qhttpserverrequest.h>
+#include <QtHttpServer/private/qhttpserverrequest_p.h>
 #include <QtHttpServer/private/qhttpserverstream_p.h>
 
+#include <QtCore/qpointer.h>
+
 //
 //  W A R N I N G
 //  -------------
@@ -34,19 +37,29 @@ class QHttpServerHttp1ProtocolHandler : public QHttpServerStream
     friend class QHttpServerResponder;
 
 private:
-    QHttpServerHttp1ProtocolHandler(QAbstractHttpServer *server, QIODevice *socket);
+    QHttpServerHttp1ProtocolHandler(QAbstractHttpServer *server, QIODevice *socket, QObject *parent);
+
+    void timerEvent(QTimerEvent *event) override;
 
     void responderDestroyed() final;
     void startHandlingRequest() final;
     void socketDisconnected() final;
+    void drain() final;
+    void abort() final;
 
     void handleReadyRead();
+    void closeIfDrained();
+    void cancelRequest(QHttpServerRequestCancellation::Reason reason);
+    bool exceedsMaxRequestBodySize() const;
+    void rejectRequest(QHttpServerResponder::StatusCode status);
 
     void write(const QByteArray &body, const QHttpHeaders &headers,
                QHttpServerResponder::StatusCode status, quint32 streamId) final;
     void write(QHttpServerResponder::StatusCode status, quint32 streamId) final;
     void write(QIODevice *data, const QHttpHeaders &headers,
                QHttpServerResponder::StatusCode status, quint32 streamId) final;
+    void writeInformational(QHttpServerResponder::StatusCode status,
+                            const QHttpHeaders &headers, quint32 streamId) final;
     void writeBeginChunked(const QHttpHeaders &headers,
                            QHttpServerResponder::StatusCode status,
                            quint32 streamId) final;
@@ -75,11 +88,18 @@ private:
     } state = TransferState::Ready;
 
     QHttpServerRequest request;
+    QHttpServerRequestRate requestRate;
+    // Cancels the request at its deadline, stopped once it is answered.
+    QBasicTimer requestTimer;
 
    // To avoid destroying the object when socket object is destroyed while
    // a request is still being handled.
     bool handlingRequest = false;
     bool protocolChanged = false;
+    // Set by drain(): the connection is closed once the response is sent.
+    bool draining = false;
+    // The device of a response that is still being sent.
+    QPointer<QIODevice> transferSource;
 };
 
 QT_END_NAMESPACE
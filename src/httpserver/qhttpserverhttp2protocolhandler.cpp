@@ -3,39 +3,153 @@
 
 #include "qhttpserverhttp2protocolhandler_p.h"
 
+#include <QtCore/qcoreevent.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qpointer.h>
 #include <QtHttpServer/qabstracthttpserver.h>
 #include <QtNetwork/private/qhttp2connection_p.h>
 #include <QtNetwork/qtcpsocket.h>
 
+#include <private/qabstracthttpserver_p.h>
 #include <private/qhttpserverrequest_p.h>
+#include <private/qhttpserverrequestbodydevice_p.h>
 #include <private/qhttpserverliterals_p.h>
 #include <private/qhttpserverresponder_p.h>
 
+#include <algorithm>
+#include <map>
+#include <utility>
+
 QT_BEGIN_NAMESPACE
 
 Q_STATIC_LOGGING_CATEGORY(lcHttpServerHttp2Handler, "qt.httpserver.http2handler")
 
 namespace {
 
-void toHeaderPairs(HPack::HttpHeader &fields, const QHttpHeaders &headers)
+void toHeaderPairs(HPack::HttpHeader &fields, const QHttpHeaders &headers,
+                   QHttpServerHttp2HeaderCache &cache)
 {
-    for (qsizetype i = 0; i < headers.size(); ++i) {
-        const auto name = headers.nameAt(i);
-        fields.push_back(HPack::HeaderField(QByteArray(name.data(), name.size()),
-                                            headers.valueAt(i).toByteArray()));
-    }
+    fields.reserve(fields.size() + headers.size());
+    for (qsizetype i = 0; i < headers.size(); ++i)
+        fields.push_back(cache.field(headers.nameAt(i), headers.valueAt(i)));
 }
 
 } // anonymous namespace
 
+HPack::HeaderField QHttpServerHttp2HeaderCache::field(QLatin1StringView name,
+                                                      QByteArrayView value)
+{
+    const QByteArrayView nameView(name.data(), name.size());
+    auto &slot = m_fields[qHashMulti(0, nameView, value) % m_fields.size()];
+    if (QByteArrayView(slot.name) != nameView || QByteArrayView(slot.value) != value)
+        slot = HPack::HeaderField(nameView.toByteArray(), value.toByteArray());
+    return slot;
+}
+
+HPack::HeaderField
+QHttpServerHttp2HeaderCache::statusField(QHttpServerResponder::StatusCode status)
+{
+    static const std::map<QHttpServerResponder::StatusCode, HPack::HeaderField> fields = [] {
+        std::map<QHttpServerResponder::StatusCode, HPack::HeaderField> result;
+        const QByteArray name(":status");
+        const auto metaEnum = QMetaEnum::fromType<QHttpServerResponder::StatusCode>();
+        for (int i = 0; i < metaEnum.keyCount(); ++i) {
+            const int value = metaEnum.value(i);
+            result.emplace(QHttpServerResponder::StatusCode(value),
+                           HPack::HeaderField(name, QByteArray::number(value)));
+        }
+        return result;
+    }();
+
+    const auto it = fields.find(status);
+    if (it != fields.end())
+        return it->second;
+    return HPack::HeaderField(":status", QByteArray::number(quint32(status)));
+}
+
+qsizetype QHttpServerHttp2StreamMap::indexOf(quint32 streamId) const
+{
+    if (m_slots.empty())
+        return -1;
+
+    const qsizetype mask = qsizetype(m_slots.size()) - 1;
+    for (qsizetype i = homeSlot(streamId);; i = (i + 1) & mask) {
+        if (m_slots[i].streamId == streamId)
+            return i;
+        if (m_slots[i].streamId == 0)
+            return -1;
+    }
+}
+
+QHttpServerHttp2StreamState *QHttpServerHttp2StreamMap::find(quint32 streamId)
+{
+    const qsizetype i = indexOf(streamId);
+    return i < 0 ? nullptr : &m_slots[i];
+}
+
+QHttpServerHttp2StreamState &QHttpServerHttp2StreamMap::insert(quint32 streamId)
+{
+    Q_ASSERT(streamId != 0);
+    Q_ASSERT(!find(streamId));
+
+    // Keep at least half of the slots free, so that probe sequences stay short
+    if ((m_size + 1) * 2 > qsizetype(m_slots.size()))
+        rehash(std::max<qsizetype>(16, qsizetype(m_slots.size()) * 2));
+
+    const qsizetype mask = qsizetype(m_slots.size()) - 1;
+    qsizetype i = homeSlot(streamId);
+    while (m_slots[i].streamId != 0)
+        i = (i + 1) & mask;
+
+    ++m_size;
+    m_slots[i].streamId = streamId;
+    return m_slots[i];
+}
+
+void QHttpServerHttp2StreamMap::erase(quint32 streamId)
+{
+    qsizetype i = indexOf(streamId);
+    if (i < 0)
+        return;
+
+    // Shift the following entries of the probe sequence back, so that
+    // lookups never need tombstones.
+    const qsizetype mask = qsizetype(m_slots.size()) - 1;
+    for (qsizetype j = (i + 1) & mask; m_slots[j].streamId != 0; j = (j + 1) & mask) {
+        const qsizetype home = homeSlot(m_slots[j].streamId);
+        const bool staysInPlace = i < j ? (i < home && home <= j) : (i < home || home <= j);
+        if (staysInPlace)
+            continue;
+        m_slots[i] = std::move(m_slots[j]);
+        i = j;
+    }
+
+    m_slots[i] = QHttpServerHttp2StreamState();
+    --m_size;
+}
+
+void QHttpServerHttp2StreamMap::rehash(qsizetype capacity)
+{
+    Q_ASSERT((capacity & (capacity - 1)) == 0);
+
+    std::vector<QHttpServerHttp2StreamState> slots(capacity);
+    std::swap(slots, m_slots);
+    m_size = 0;
+    for (QHttpServerHttp2StreamState &state : slots) {
+        if (state.streamId != 0) {
+            const quint32 streamId = state.streamId;
+            insert(streamId) = std::move(state);
+        }
+    }
+}
+
 QHttpServerHttp2ProtocolHandler::QHttpServerHttp2ProtocolHandler(QAbstractHttpServer *server,
-                                                                 QIODevice *socket)
-    : QHttpServerStream(server),
+                                                                 QIODevice *socket, QObject *parent)
+    : QHttpServerStream(parent),
       m_server(server),
       m_socket(socket),
-      m_tcpSocket(qobject_cast<QTcpSocket *>(socket)),
-      m_request(QHttpServerStream::initRequestFromSocket(m_tcpSocket))
+      m_tcpSocket(qobject_cast<QTcpSocket *>(socket))
 {
     socket->setParent(this);
 
@@ -67,9 +181,21 @@ QHttpServerHttp2ProtocolHandler::QHttpServerHttp2ProtocolHandler(QAbstractHttpSe
             &QHttpServerHttp2ProtocolHandler::onStreamCreated);
 }
 
+QHttpServerHttp2ProtocolHandler::~QHttpServerHttp2ProtocolHandler()
+{
+    // Tell a still connected client that no further streams will be
+    // processed, e.g. when the server is destroyed.
+    if (m_connection && !m_connection->isGoingAway()
+        && m_tcpSocket->state() == QAbstractSocket::ConnectedState) {
+        m_connection->close();
+        m_tcpSocket->flush();
+    }
+}
+
 void QHttpServerHttp2ProtocolHandler::responderDestroyed()
 {
     m_responderCounter--;
+    closeIfDrained();
 }
 
 void QHttpServerHttp2ProtocolHandler::startHandlingRequest()
@@ -79,10 +205,85 @@ void QHttpServerHttp2ProtocolHandler::startHandlingRequest()
 
 void QHttpServerHttp2ProtocolHandler::socketDisconnected()
 {
+    cancelRequests(QHttpServerRequestCancellation::Reason::Disconnected);
     if (m_responderCounter == 0)
         deleteLater();
 }
 
+void QHttpServerHttp2ProtocolHandler::drain()
+{
+    m_draining = true;
+    // GOAWAY lets the client retry the streams it opens from now on
+    // elsewhere, while those opened before are still processed.
+    if (m_connection && !m_connection->isGoingAway()) {
+        qCDebug(lcHttpServerHttp2Handler, "Draining connection, sending GOAWAY");
+        m_connection->close();
+    }
+    closeIfDrained();
+}
+
+void QHttpServerHttp2ProtocolHandler::abort()
+{
+    cancelRequests(QHttpServerRequestCancellation::Reason::Aborted);
+    if (m_tcpSocket)
+        m_tcpSocket->abort();
+}
+
+void QHttpServerHttp2ProtocolHandler::cancelRequests(QHttpServerRequestCancellation::Reason reason)
+{
+    // Canceling may call back into the handler, so don't iterate m_streams.
+    std::vector<std::shared_ptr<QHttpServerRequestCancellation>> cancellations;
+    m_streams.forEach([&cancellations](const QHttpServerHttp2StreamState &state) {
+        if (state.cancellation && !state.isResponseFinished)
+            cancellations.push_back(state.cancellation);
+    });
+    for (const auto &cancellation : cancellations)
+        cancellation->cancel(reason);
+}
+
+void QHttpServerHttp2ProtocolHandler::timerEvent(QTimerEvent *event)
+{
+    std::shared_ptr<QHttpServerRequestCancellation> cancellation;
+    m_streams.forEach([&cancellation, timerId = event->timerId()](
+                              QHttpServerHttp2StreamState &state) {
+        if (state.timeoutTimer.timerId() == timerId) {
+            state.timeoutTimer.stop();
+            cancellation = state.cancellation;
+        }
+    });
+    if (!cancellation) {
+        QHttpServerStream::timerEvent(event);
+        return;
+    }
+    cancellation->cancel(QHttpServerRequestCancellation::Reason::TimedOut);
+}
+
+/*!
+    \internal
+
+    Records that the handler wrote the whole response of \a streamId, which
+    is then neither timed out nor canceled when the stream is closed.
+*/
+void QHttpServerHttp2ProtocolHandler::finishResponse(quint32 streamId)
+{
+    if (auto *state = m_streams.find(streamId)) {
+        state->isResponseFinished = true;
+        state->timeoutTimer.stop();
+    }
+}
+
+void QHttpServerHttp2ProtocolHandler::closeIfDrained()
+{
+    if (!m_draining || m_responderCounter > 0 || !m_streams.isEmpty() || !m_tcpSocket)
+        return;
+
+    qCDebug(lcHttpServerHttp2Handler, "Closing drained connection");
+    if (m_tcpSocket->state() == QAbstractSocket::UnconnectedState)
+        deleteLater();
+    else
+        m_tcpSocket->disconnectFromHost();
+}
+
 void QHttpServerHttp2ProtocolHandler::write(const QByteArray &body, const QHttpHeaders &headers,
                                             QHttpServerResponder::StatusCode status,
                                             quint32 streamId)
@@ -99,6 +300,7 @@ void QHttpServerHttp2ProtocolHandler::write(const QByteArray &body, const QHttpH
 
     connect(stream, &QHttp2Stream::uploadFinished, buffer, &QObject::deleteLater);
     stream->sendDATA(buffer, true);
+    finishResponse(streamId);
 }
 
 void QHttpServerHttp2ProtocolHandler::write(QHttpServerResponder::StatusCode status,
@@ -115,6 +317,8 @@ void QHttpServerHttp2ProtocolHandler::write(QHttpServerResponder::StatusCode sta
     bool isInfoStatus = QHttpServerResponder::StatusCode::Continue <= status
                         && status < QHttpServerResponder::StatusCode::Ok;
     writeHeadersAndStatus(headers, status, !isInfoStatus, streamId);
+    if (!isInfoStatus)
+        finishResponse(streamId);
 }
 
 void QHttpServerHttp2ProtocolHandler::write(QIODevice *data, const QHttpHeaders &headers,
@@ -149,6 +353,7 @@ void QHttpServerHttp2ProtocolHandler::write(QIODevice *data, const QHttpHeaders
     }
 
     writeHeadersAndStatus(headers, status, false, streamId);
+    finishResponse(streamId);
 
     if (input->atEnd()) {
         qCDebug(lcHttpServerHttp2Handler, "No more data available.");
@@ -160,6 +365,14 @@ void QHttpServerHttp2ProtocolHandler::write(QIODevice *data, const QHttpHeaders
     stream->sendDATA(input.release(), true);
 }
 
+void QHttpServerHttp2ProtocolHandler::writeInformational(QHttpServerResponder::StatusCode status,
+                                                         const QHttpHeaders &headers,
+                                                         quint32 streamId)
+{
+    // RFC 9113, 8.1: informational responses never end the stream
+    writeHeadersAndStatus(headers, status, false, streamId);
+}
+
 void QHttpServerHttp2ProtocolHandler::writeBeginChunked(const QHttpHeaders &headers,
                                                         QHttpServerResponder::StatusCode status,
                                                         quint32 streamId)
@@ -177,6 +390,7 @@ void QHttpServerHttp2ProtocolHandler::writeEndChunked(const QByteArray &body,
                                                       quint32 streamId)
 {
     enqueueChunk(body, true, trailers, streamId);
+    finishResponse(streamId);
 }
 
 void QHttpServerHttp2ProtocolHandler::enqueueChunk(const QByteArray &body, bool allEnqueued,
@@ -186,16 +400,25 @@ void QHttpServerHttp2ProtocolHandler::enqueueChunk(const QByteArray &body, bool
     if (!stream)
         return;
 
-    auto &queue = m_streamQueue[streamId];
+    auto *state = m_streams.find(streamId);
+    if (!state)
+        return;
+
+    // Only chunked responses send more than one DATA upload
+    if (!state->isUploadFinishedConnected) {
+        state->isUploadFinishedConnected = true;
+        connect(stream, &QHttp2Stream::uploadFinished, this,
+                [this, streamId]() { sendToStream(streamId); });
+    }
 
     if (!trailers.isEmpty()) {
-        Q_ASSERT(queue.trailers.empty());
-        toHeaderPairs(queue.trailers, trailers);
+        Q_ASSERT(state->trailers.empty());
+        toHeaderPairs(state->trailers, trailers, m_headerCache);
     }
 
-    queue.data.enqueue(body);
+    state->data.enqueue(body);
     if (allEnqueued)
-        queue.allEnqueued = true;
+        state->allEnqueued = true;
 
     if (!stream->isUploadingDATA())
         sendToStream(streamId);
@@ -210,8 +433,9 @@ void QHttpServerHttp2ProtocolHandler::writeHeadersAndStatus(const QHttpHeaders &
         return;
 
     HPack::HttpHeader h;
-    h.push_back(HPack::HeaderField(":status", QByteArray::number(quint32(status))));
-    toHeaderPairs(h, headers);
+    h.reserve(headers.size() + 1);
+    h.push_back(QHttpServerHttp2HeaderCache::statusField(status));
+    toHeaderPairs(h, headers, m_headerCache);
     stream->sendHEADERS(h, endStream);
 }
 
@@ -226,60 +450,303 @@ QHttp2Stream *QHttpServerHttp2ProtocolHandler::getStream(quint32 streamId) const
     return nullptr;
 }
 
+bool QHttpServerHttp2ProtocolHandler::admitStream()
+{
+    const quint32 maxStreams = m_server->http2Configuration().maxConcurrentStreams();
+
+    if (quint32(m_streams.size()) >= maxStreams) {
+        qCDebug(lcHttpServerHttp2Handler, "Refusing stream, %u streams are already open",
+                maxStreams);
+    } else if (!m_requestRate.tryAcquire(m_server->configuration().rateLimitPerSecond())) {
+        qCDebug(lcHttpServerHttp2Handler, "Refusing stream, request rate limit exceeded");
+    } else {
+        m_refusedStreams = 0;
+        return true;
+    }
+
+    // A client that keeps opening streams after being refused ignores the
+    // advertised limits, so stop accepting new streams on this connection.
+    if (++m_refusedStreams > maxStreams && !m_connection->isGoingAway()) {
+        qCDebug(lcHttpServerHttp2Handler, "Too many refused streams, sending GOAWAY");
+        m_connection->close();
+    }
+    return false;
+}
+
 void QHttpServerHttp2ProtocolHandler::onStreamCreated(QHttp2Stream *stream)
 {
+    if (!admitStream()) {
+        stream->sendRST_STREAM(Http2::REFUSE_STREAM);
+        return;
+    }
+
     const quint32 id = stream->streamID();
-    m_streamQueue.insert(id, QHttpServerHttp2Queue());
-
-    auto onStateChanged = [this, id](QHttp2Stream::State newState) {
-        switch (newState) {
-        case QHttp2Stream::State::HalfClosedRemote:
-            onStreamHalfClosed(id);
-            break;
-        case QHttp2Stream::State::Closed:
-            onStreamClosed(id);
-            break;
-        default:
-            break;
-        }
-    };
+    m_streams.insert(id).request.reset(
+            new QHttpServerRequest(QHttpServerStream::initRequestFromSocket(m_tcpSocket)));
+
+    // QHttp2Stream emits its signals while it handles a frame, before it
+    // stores the headers or data of the frame. The signals only record what
+    // happened, processStreams() acts on it once the frames are handled.
+    connect(stream, &QHttp2Stream::stateChanged, this,
+            [this, id](QHttp2Stream::State newState) { onStreamStateChanged(id, newState); });
+    connect(stream, &QHttp2Stream::dataReceived, this,
+            [this, id](const QByteArray &data, bool) { onStreamDataReceived(id, data); });
+}
 
-    auto &connections = m_streamConnections[id];
-    connections << connect(stream,
-                           &QHttp2Stream::stateChanged,
-                           this,
-                           onStateChanged,
-                           Qt::QueuedConnection);
+void QHttpServerHttp2ProtocolHandler::onStreamStateChanged(quint32 streamId,
+                                                           QHttp2Stream::State newState)
+{
+    auto *state = m_streams.find(streamId);
+    if (!state)
+        return;
 
-    connections << connect(stream, &QHttp2Stream::uploadFinished, this,
-                           [this, id]() { sendToStream(id); });
+    switch (newState) {
+    case QHttp2Stream::State::Open:
+        state->isHeadersReceived = true;
+        break;
+    case QHttp2Stream::State::HalfClosedRemote:
+        state->isHeadersReceived = true;
+        state->isRequestComplete = true;
+        break;
+    case QHttp2Stream::State::Closed:
+        state->isClosed = true;
+        break;
+    default:
+        return;
+    }
+    scheduleStream(state);
 }
 
-void QHttpServerHttp2ProtocolHandler::onStreamHalfClosed(quint32 streamId)
+void QHttpServerHttp2ProtocolHandler::onStreamDataReceived(quint32 streamId,
+                                                           const QByteArray &data)
 {
-    auto stream = m_connection->getStream(streamId);
-    Q_ASSERT(stream);
+    auto *state = m_streams.find(streamId);
+    if (!state || state->isBodyTooLarge)
+        return;
+
+    state->requestBodySize += data.size();
+
+    const qint64 maxSize = m_server->configuration().maxRequestBodySize();
+    if (maxSize > 0 && state->requestBodySize > maxSize) {
+        qCDebug(lcHttpServerHttp2Handler, "Request body of stream %u exceeds %lld bytes",
+                streamId, maxSize);
+        state->isBodyTooLarge = true;
+        scheduleStream(state);
+    } else if (state->isBodyStreamed) {
+        scheduleStream(state);
+    }
+}
+
+void QHttpServerHttp2ProtocolHandler::scheduleStream(QHttpServerHttp2StreamState *state)
+{
+    if (state->isPending)
+        return;
+
+    state->isPending = true;
+    if (m_pendingStreams.empty()) {
+        QMetaObject::invokeMethod(this, &QHttpServerHttp2ProtocolHandler::processStreams,
+                                  Qt::QueuedConnection);
+    }
+    m_pendingStreams.push_back(state->streamId);
+}
+
+/*!
+    \internal
+
+    Acts on the stream events recorded since the last call, once per batch
+    of frames read from the socket: rejects too large request bodies,
+    dispatches requests, passes streamed bodies on and forgets closed
+    streams.
+*/
+void QHttpServerHttp2ProtocolHandler::processStreams()
+{
+    const std::vector<quint32> streamIds = std::exchange(m_pendingStreams, {});
+    for (const quint32 streamId : streamIds)
+        processStream(streamId);
+
+    if (m_streamedBodyCount > 0 || m_isReadingPaused)
+        updateReading();
+    closeIfDrained();
+}
+
+void QHttpServerHttp2ProtocolHandler::processStream(quint32 streamId)
+{
+    // Looked up again after each step, handlers may open or close streams
+    // from an event loop.
+    auto *state = m_streams.find(streamId);
+    if (!state)
+        return;
+    state->isPending = false;
+
+    if (!state->isDispatched && !state->isClosed) {
+        if (state->isBodyTooLarge) {
+            state->isDispatched = true;
+            rejectRequestBody(streamId);
+        } else if (state->isRequestComplete
+                   || (state->isHeadersReceived && !state->isHeadersHandled)) {
+            state->isHeadersHandled = true;
+            handleRequest(streamId);
+        }
+        state = m_streams.find(streamId);
+        if (!state)
+            return;
+    } else if (state->isBodyStreamed && !state->isClosed) {
+        if (state->isBodyTooLarge) {
+            // The handler may have started to respond, so only reset the stream
+            if (QHttp2Stream *stream = getStream(streamId))
+                stream->sendRST_STREAM(Http2::CANCEL);
+        } else {
+            streamRequestBody(streamId);
+        }
+        state = m_streams.find(streamId);
+        if (!state)
+            return;
+    }
+
+    if (state->isClosed && !state->isPending) {
+        // Closed before the response was finished if the client reset the
+        // stream.
+        if (state->cancellation && !state->isResponseFinished)
+            state->cancellation->cancel(QHttpServerRequestCancellation::Reason::Disconnected);
+        if (state->isBodyStreamed)
+            --m_streamedBodyCount;
+        m_streams.erase(streamId);
+    }
+}
+
+void QHttpServerHttp2ProtocolHandler::rejectRequestBody(quint32 streamId)
+{
+    QHttp2Stream *stream = getStream(streamId);
     if (!stream)
         return;
 
-    m_request.d->parse(stream);
+    // RFC 9113, 8.1: the server may send a complete response before the
+    // client has sent the entire request, and then reset the stream with
+    // NO_ERROR so that the client stops sending the body.
+    write(QHttpServerResponder::StatusCode::PayloadTooLarge, streamId);
+    stream->sendRST_STREAM(Http2::HTTP2_NO_ERROR);
+}
+
+/*!
+    \internal
+
+    Passes the request of \a streamId to the server once it is complete, or
+    once its headers are received if its body is streamed to the handler.
+*/
+void QHttpServerHttp2ProtocolHandler::handleRequest(quint32 streamId)
+{
+    QHttp2Stream *stream = getStream(streamId);
+    auto *state = m_streams.find(streamId);
+    if (!stream || !state)
+        return;
+
+    // Keeps the request alive for the handlers, even if the stream is
+    // closed from an event loop they run.
+    const std::shared_ptr<QHttpServerRequest> request = state->request;
+    request->d->parse(stream);
+
+    if (state->isRequestComplete) {
+        request->d->body = stream->downloadBuffer().readAll();
+        stream->clearDownloadBuffer();
+    } else {
+        if (!QAbstractHttpServerPrivate::get(m_server)->streamsRequestBody(*request))
+            return;
+
+        qCDebug(lcHttpServerHttp2Handler, "Streaming the request body of stream %u", streamId);
+        auto *device = new QHttpServerRequestBodyDevice;
+        device->onConsumed = [self = QPointer<QHttpServerHttp2ProtocolHandler>(this)]() {
+            if (self && self->m_isReadingPaused)
+                self->updateReading();
+        };
+        request->d->bodyDevice.reset(device);
+        state->isBodyStreamed = true;
+        ++m_streamedBodyCount;
+    }
+    state->isDispatched = true;
+
+    qCDebug(lcHttpServerHttp2Handler) << "Request:" << *request;
 
-    qCDebug(lcHttpServerHttp2Handler) << "Request:" << m_request;
+    state->cancellation = startCancellation(*request, m_server->configuration().requestTimeout(),
+                                            &state->timeoutTimer);
 
     QHttpServerResponder responder(this);
     responder.d_ptr->m_streamId = streamId;
 
-    if (!m_server->handleRequest(m_request, responder))
-        m_server->missingHandler(m_request, responder);
+    if (!m_server->handleRequest(*request, responder))
+        m_server->missingHandler(*request, responder);
+
+    // DATA frames handled along with the HEADERS frame
+    if (request->d->bodyDevice)
+        streamRequestBody(streamId);
+}
+
+/*!
+    \internal
+
+    Moves the body data received for \a streamId to the device it is read
+    from by the handler, and finishes the device once the whole body is.
+*/
+void QHttpServerHttp2ProtocolHandler::streamRequestBody(quint32 streamId)
+{
+    auto *state = m_streams.find(streamId);
+    QHttp2Stream *stream = m_connection->getStream(streamId);
+    if (!state || !stream)
+        return;
+
+    const std::shared_ptr<QHttpServerRequest> request = state->request;
+    const bool isComplete = state->isRequestComplete;
+    const QByteDataBuffer data = stream->downloadBuffer();
+    stream->clearDownloadBuffer();
+
+    // Both may call the handler
+    request->d->bodyDevice->append(data);
+    if (isComplete)
+        request->d->bodyDevice->finish();
 }
 
-void QHttpServerHttp2ProtocolHandler::onStreamClosed(quint32 streamId)
+/*!
+    \internal
+
+    Stops reading from the socket while the streamed request bodies that
+    are not read by their handlers exceed the receive window of a stream,
+    so that TCP flow control holds the client back, and reads again once
+    they are read.
+
+    QHttp2Stream updates the HTTP/2 flow control windows as soon as it
+    receives data, so they cannot follow the handlers.
+*/
+void QHttpServerHttp2ProtocolHandler::updateReading()
 {
-    auto connections = m_streamConnections.take(streamId);
-    for (auto &c : connections)
-        disconnect(c);
+    if (!m_tcpSocket)
+        return;
 
-    m_streamQueue.remove(streamId);
+    qint64 unread = 0;
+    m_streams.forEach([&unread](const QHttpServerHttp2StreamState &state) {
+        if (state.isBodyStreamed)
+            unread += state.request->d->bodyDevice->bufferedBytes();
+    });
+
+    const qint64 window = m_server->http2Configuration().streamReceiveWindowSize();
+    const bool pause = unread >= window;
+    if (pause == m_isReadingPaused)
+        return;
+
+    m_isReadingPaused = pause;
+    if (pause) {
+        qCDebug(lcHttpServerHttp2Handler, "Pausing reading, %lld bytes of request body unread",
+                unread);
+        disconnect(m_tcpSocket, &QTcpSocket::readyRead,
+                   m_connection, &QHttp2Connection::handleReadyRead);
+        // Also stops QTcpSocket from reading from the network
+        m_tcpSocket->setReadBufferSize(1);
+    } else {
+        qCDebug(lcHttpServerHttp2Handler, "Resuming reading");
+        m_tcpSocket->setReadBufferSize(0);
+        connect(m_tcpSocket, &QTcpSocket::readyRead,
+                m_connection, &QHttp2Connection::handleReadyRead);
+        QMetaObject::invokeMethod(m_connection, &QHttp2Connection::handleReadyRead,
+                                  Qt::QueuedConnection);
+    }
 }
 
 void QHttpServerHttp2ProtocolHandler::sendToStream(quint32 streamId)
@@ -291,17 +758,20 @@ void QHttpServerHttp2ProtocolHandler::sendToStream(quint32 streamId)
     if (stream->isUploadingDATA())
         return;
 
-    auto &queue = m_streamQueue[streamId];
-    if (!queue.data.isEmpty()) {
+    auto *state = m_streams.find(streamId);
+    if (!state)
+        return;
+
+    if (!state->data.isEmpty()) {
         QBuffer *buffer = new QBuffer(stream);
-        buffer->setData(queue.data.dequeue());
+        buffer->setData(state->data.dequeue());
         buffer->open(QIODevice::ReadOnly);
         connect(stream, &QHttp2Stream::uploadFinished, buffer, &QObject::deleteLater);
-        bool endStream = queue.allEnqueued && queue.data.isEmpty() && queue.trailers.empty();
+        bool endStream = state->allEnqueued && state->data.isEmpty() && state->trailers.empty();
         stream->sendDATA(buffer, endStream);
-    } else if (!queue.trailers.empty()) {
-        stream->sendHEADERS(queue.trailers, true);
-        queue.trailers.clear();
+    } else if (!state->trailers.empty()) {
+        stream->sendHEADERS(state->trailers, true);
+        state->trailers.clear();
     }
 }
 
@@ -6,11 +6,17 @@
 
 #include <QtHttpServer/qthttpserverglobal.h>
 #include <QtHttpServer/qhttpserverrequest.h>
+#include <QtHttpServer/private/qhttpserverrequest_p.h>
 #include <QtHttpServer/private/qhttpserverstream_p.h>
 #include <QtNetwork/private/hpack_p.h>
+#include <QtNetwork/private/qhttp2connection_p.h>
 #include <QtCore/qbytearray.h>
 #include <QtCore/qqueue.h>
 
+#include <array>
+#include <memory>
+#include <vector>
+
 //
 //  W A R N I N G
 //  -------------
@@ -28,14 +34,89 @@ QT_BEGIN_NAMESPACE
 
 class QTcpSocket;
 class QAbstractHttpServer;
-class QHttp2Connection;
-class QHttp2Stream;
 
-struct QHttpServerHttp2Queue
+// Everything the handler keeps for an open stream
+struct QHttpServerHttp2StreamState
 {
+    // 0 for a free slot of QHttpServerHttp2StreamMap
+    quint32 streamId = 0;
+    qint64 requestBodySize = 0;
+
+    // Shared with the dispatch in progress, which may outlive the stream
+    // if a handler runs an event loop.
+    std::shared_ptr<QHttpServerRequest> request;
+
+    // Set from the stream's signals, acted upon by processStreams()
+    bool isPending = false;
+    bool isHeadersReceived = false;
+    bool isRequestComplete = false;
+    bool isBodyTooLarge = false;
+    bool isClosed = false;
+
+    bool isHeadersHandled = false;
+    bool isDispatched = false;
+    // The body is passed to the handler through request->bodyDevice()
+    bool isBodyStreamed = false;
+    bool isUploadFinishedConnected = false;
+
+    // Response chunks waiting for the previous DATA upload to finish
     QQueue<QByteArray> data;
     HPack::HttpHeader trailers;
     bool allEnqueued = false;
+
+    std::shared_ptr<QHttpServerRequestCancellation> cancellation;
+    // Cancels the request at its deadline, stopped once it is answered.
+    QBasicTimer timeoutTimer;
+    // Set once the handler wrote the whole response
+    bool isResponseFinished = false;
+};
+
+// The open streams of a connection, indexed by stream ID. Client initiated
+// streams have odd IDs that mostly grow one by one, so (ID >> 1) spreads
+// them over consecutive slots of an open addressing table.
+// Inserting and erasing invalidate the pointers returned by find().
+class QHttpServerHttp2StreamMap
+{
+public:
+    QHttpServerHttp2StreamState *find(quint32 streamId);
+    QHttpServerHttp2StreamState &insert(quint32 streamId);
+    void erase(quint32 streamId);
+
+    qsizetype size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    template <typename Function>
+    void forEach(Function function)
+    {
+        for (QHttpServerHttp2StreamState &state : m_slots) {
+            if (state.streamId != 0)
+                function(state);
+        }
+    }
+
+private:
+    qsizetype homeSlot(quint32 streamId) const
+    { return qsizetype(streamId >> 1) & (qsizetype(m_slots.size()) - 1); }
+    qsizetype indexOf(quint32 streamId) const;
+    void rehash(qsizetype capacity);
+
+    std::vector<QHttpServerHttp2StreamState> m_slots;
+    qsizetype m_size = 0;
+};
+
+// Small direct-mapped cache of HPACK header fields. Responses produced by the
+// same route tend to repeat the same header names and values (Content-Type,
+// Cache-Control, ...), so reusing the implicitly shared QByteArrays avoids
+// rebuilding them for every response on the connection.
+class QHttpServerHttp2HeaderCache
+{
+public:
+    HPack::HeaderField field(QLatin1StringView name, QByteArrayView value);
+
+    static HPack::HeaderField statusField(QHttpServerResponder::StatusCode status);
+
+private:
+    std::array<HPack::HeaderField, 128> m_fields;
 };
 
 class QHttpServerHttp2ProtocolHandler : public QHttpServerStream
@@ -45,17 +126,27 @@ class QHttpServerHttp2ProtocolHandler : public QHttpServerStream
     friend class QAbstractHttpServerPrivate;
 
 private:
-    QHttpServerHttp2ProtocolHandler(QAbstractHttpServer *server, QIODevice *socket);
+    QHttpServerHttp2ProtocolHandler(QAbstractHttpServer *server, QIODevice *socket, QObject *parent);
+    ~QHttpServerHttp2ProtocolHandler() override;
+
+    void timerEvent(QTimerEvent *event) override;
 
     void responderDestroyed() final;
     void startHandlingRequest() final;
     void socketDisconnected() final;
+    void drain() final;
+    void abort() final;
+    void closeIfDrained();
+    void cancelRequests(QHttpServerRequestCancellation::Reason reason);
+    void finishResponse(quint32 streamId);
 
     void write(const QByteArray &body, const QHttpHeaders &headers,
                QHttpServerResponder::StatusCode status, quint32 streamId) final;
     void write(QHttpServerResponder::StatusCode status, quint32 streamId) final;
     void write(QIODevice *data, const QHttpHeaders &headers,
                QHttpServerResponder::StatusCode status, quint32 streamId) final;
+    void writeInformational(QHttpServerResponder::StatusCode status,
+                            const QHttpHeaders &headers, quint32 streamId) final;
     void writeBeginChunked(const QHttpHeaders &headers,
                            QHttpServerResponder::StatusCode status,
                            quint32 streamId) final;
@@ -69,25 +160,40 @@ private:
                                bool endStream,
                                quint32 streamId);
 
-private slots:
     void onStreamCreated(QHttp2Stream *stream);
-    void onStreamClosed(quint32 streamId);
-    void onStreamHalfClosed(quint32 streamId);
+    void onStreamStateChanged(quint32 streamId, QHttp2Stream::State newState);
+    void onStreamDataReceived(quint32 streamId, const QByteArray &data);
+    void scheduleStream(QHttpServerHttp2StreamState *state);
+    void processStreams();
+    void processStream(quint32 streamId);
+    void rejectRequestBody(quint32 streamId);
+    void handleRequest(quint32 streamId);
+    void streamRequestBody(quint32 streamId);
+    void updateReading();
     void sendToStream(quint32 streamId);
 
-private:
     QHttp2Stream * getStream(quint32 streamId) const;
+    bool admitStream();
     void enqueueChunk(const QByteArray &body, bool allEnqueued, const QHttpHeaders &trailers,
                       quint32 streamId);
 
     QAbstractHttpServer *m_server;
     QIODevice *m_socket;
     QTcpSocket *m_tcpSocket;
-    QHttpServerRequest m_request;
     QHttp2Connection *m_connection;
-    QHash<quint32, QList<QMetaObject::Connection>> m_streamConnections;
-    QHash<quint32, QHttpServerHttp2Queue> m_streamQueue;
+    QHttpServerHttp2StreamMap m_streams;
+    // Streams with events for the next processStreams(), in arrival order
+    std::vector<quint32> m_pendingStreams;
+    QHttpServerHttp2HeaderCache m_headerCache;
+    QHttpServerRequestRate m_requestRate;
+    quint32 m_refusedStreams = 0;
+    // Streams whose body is passed to the handler as it arrives
+    qsizetype m_streamedBodyCount = 0;
+    // Set while too much of the streamed bodies is left unread
+    bool m_isReadingPaused = false;
     qint32 m_responderCounter = 0;
+    // Set by drain(): the connection is closed once its streams are done.
+    bool m_draining = false;
 };
 
 QT_END_NAMESPACE
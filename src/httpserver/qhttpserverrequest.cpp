@@ -308,6 +308,38 @@ QHttpServerRequestPrivate::QHttpServerRequestPrivate(const QHostAddress &remoteA
 }
 #endif
 
+/*!
+    \internal
+
+    Copies the request \a other holds, without the state of the parser and
+    the device of a streamed body.
+*/
+QHttpServerRequestPrivate::QHttpServerRequestPrivate(const QHttpServerRequestPrivate &other)
+    : port(other.port),
+      state(other.state),
+      url(other.url),
+      method(other.method),
+      parser(other.parser),
+      remoteAddress(other.remoteAddress),
+      remotePort(other.remotePort),
+      localAddress(other.localAddress),
+      localPort(other.localPort),
+#if QT_CONFIG(ssl)
+      sslConfiguration(other.sslConfiguration),
+#endif
+      handling(other.handling),
+      bodyLength(other.bodyLength),
+      contentRead(other.contentRead),
+      chunkedTransferEncoding(other.chunkedTransferEncoding),
+      lastChunkRead(other.lastChunkRead),
+      currentChunkRead(other.currentChunkRead),
+      currentChunkSize(other.currentChunkSize),
+      upgrade(other.upgrade),
+      body(other.body),
+      cancellation(other.cancellation)
+{
+}
+
 /*!
     \internal
 */
@@ -383,7 +415,7 @@ bool QHttpServerRequestPrivate::parse(QHttp2Stream *socket)
 
     bodyLength = contentLength(); // cache the length
 
-    body = socket->downloadBuffer().readAll();
+    // The body is set by the protocol handler, as it may still be arriving
 
     return true;
 }
@@ -576,6 +608,41 @@ qsizetype QHttpServerRequestPrivate::getChunkSize(QIODevice *socket, qsizetype *
     return bytes;
 }
 
+/*!
+    \internal
+
+    Cancels the request for \a reason, unless it is canceled already, and
+    calls the functions registered with onCanceled().
+*/
+void QHttpServerRequestCancellation::cancel(Reason reason)
+{
+    Q_ASSERT(reason != Reason::None);
+    std::vector<std::function<void()>> callbacks;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_reason.testAndSetRelease(int(Reason::None), int(reason)))
+            return;
+        callbacks.swap(m_callbacks);
+    }
+    for (const auto &callback : callbacks)
+        callback();
+}
+
+/*!
+    \internal
+*/
+void QHttpServerRequestCancellation::onCanceled(std::function<void()> &&function)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!isCanceled()) {
+            m_callbacks.push_back(std::move(function));
+            return;
+        }
+    }
+    function();
+}
+
 /*!
     \class QHttpServerRequest
     \since 6.4
@@ -638,6 +705,15 @@ QHttpServerRequest::QHttpServerRequest(const QHostAddress &remoteAddress, quint1
 /*!
     Destroys a QHttpServerRequest
 */
+/*!
+    \internal
+
+    Creates a copy of \a other, which shares its cancellation token.
+*/
+QHttpServerRequest::QHttpServerRequest(const QHttpServerRequest &other)
+    : d(new QHttpServerRequestPrivate(*other.d))
+{}
+
 QHttpServerRequest::~QHttpServerRequest()
 {}
 
@@ -691,12 +767,40 @@ QHttpHeaders QHttpServerRequest::headers() &&
 
 /*!
     Returns the body of the request.
+
+    This is empty for a request whose body is streamed to the handler
+    through bodyDevice().
 */
 QByteArray QHttpServerRequest::body() const
 {
     return d->body;
 }
 
+/*!
+    \since 6.9
+
+    Returns the device the body of the request is read from while it is
+    still being received, or \nullptr if the whole body was received before
+    the request was passed to the handler, and is returned by body().
+
+    The body of an HTTP/2 request is streamed to a rule with
+    QHttpServerRouterRule::isBodyStreamingEnabled() whose context object
+    lives in the thread of the connection. The handler is then called as
+    soon as the request headers are received. The device emits
+    \l{QIODevice::}{readyRead()} as the body arrives, and
+    \l{QIODevice::}{readChannelFinished()} once all of it has. The
+    connection stops receiving data while too much of it is left unread.
+
+    The device is destroyed with the request, once the response was sent
+    or the stream was reset.
+
+    \sa body(), QHttpServerRouterRule::setBodyStreamingEnabled()
+*/
+QIODevice *QHttpServerRequest::bodyDevice() const
+{
+    return d->bodyDevice.get();
+}
+
 /*!
     Returns the address of the origin host of the request.
 */
@@ -749,6 +853,45 @@ QSslConfiguration QHttpServerRequest::sslConfiguration() const
 }
 #endif
 
+/*!
+    \since 6.9
+
+    Returns the time by which the response to this request should be sent.
+    The deadline is set by QHttpServerConfiguration::setRequestTimeout()
+    when the request is received, and never expires if no timeout is set.
+
+    A handler doing long work can use it to bound the time it waits for
+    other services.
+
+    \sa isCanceled()
+*/
+QDeadlineTimer QHttpServerRequest::deadline() const
+{
+    return d->cancellation ? d->cancellation->deadline
+                           : QDeadlineTimer(QDeadlineTimer::Forever);
+}
+
+/*!
+    \since 6.9
+
+    Returns \c true if the response to this request is not needed anymore,
+    because the client closed the connection or reset the HTTP/2 stream,
+    deadline() expired, or QAbstractHttpServer::drain() aborted the
+    connection. This function can be called from any thread.
+
+    A request handler doing long work can check it to give up early. The
+    QFuture returned by a handler is canceled along with the request, which
+    prevents a handler passed to QHttpServer::route() with a QThreadPool from
+    starting if it did not yet. A request whose deadline expired is then
+    answered with \l{QHttpServerResponder::StatusCode}{ServiceUnavailable}.
+
+    \sa deadline()
+*/
+bool QHttpServerRequest::isCanceled() const
+{
+    return d->cancellation && d->cancellation->isCanceled();
+}
+
 QT_END_NAMESPACE
 
 #include "moc_qhttpserverrequest.cpp"
@@ -6,6 +6,7 @@
 
 #include <QtHttpServer/qthttpserverglobal.h>
 
+#include <QtCore/qdeadlinetimer.h>
 #include <QtCore/qglobal.h>
 #include <QtCore/qurl.h>
 #include <QtCore/qurlquery.h>
@@ -18,6 +19,7 @@
 
 QT_BEGIN_NAMESPACE
 
+class QIODevice;
 class QRegularExpression;
 class QString;
 class QHttpHeaders;
@@ -25,10 +27,12 @@ class QHttpHeaders;
 class QHttpServerRequestPrivate;
 class QHttpServerRequest final
 {
+    friend class QHttpServer;
     friend class QHttpServerResponse;
     friend class QHttpServerStream;
     friend class QHttpServerHttp1ProtocolHandler;
     friend class QHttpServerHttp2ProtocolHandler;
+    friend class QHttpServerRequestPrivate;
 
     Q_GADGET_EXPORT(Q_HTTPSERVER_EXPORT)
 
@@ -61,6 +65,7 @@ public:
     Q_HTTPSERVER_EXPORT const QHttpHeaders &headers() const &;
     Q_HTTPSERVER_EXPORT QHttpHeaders headers() &&;
     Q_HTTPSERVER_EXPORT QByteArray body() const;
+    Q_HTTPSERVER_EXPORT QIODevice *bodyDevice() const;
     Q_HTTPSERVER_EXPORT QHostAddress remoteAddress() const;
     Q_HTTPSERVER_EXPORT quint16 remotePort() const;
     Q_HTTPSERVER_EXPORT QHostAddress localAddress() const;
@@ -68,9 +73,12 @@ public:
 #if QT_CONFIG(ssl)
     Q_HTTPSERVER_EXPORT QSslConfiguration sslConfiguration() const;
 #endif
+    Q_HTTPSERVER_EXPORT QDeadlineTimer deadline() const;
+    Q_HTTPSERVER_EXPORT bool isCanceled() const;
 
 private:
-    Q_DISABLE_COPY(QHttpServerRequest)
+    Q_HTTPSERVER_EXPORT QHttpServerRequest(const QHttpServerRequest &other);
+    QHttpServerRequest &operator=(const QHttpServerRequest &) = delete;
 
 #if !defined(QT_NO_DEBUG_STREAM)
     friend Q_HTTPSERVER_EXPORT QDebug operator<<(QDebug debug, const QHttpServerRequest &request);
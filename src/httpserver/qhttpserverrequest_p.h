@@ -5,9 +5,18 @@
 #define QHTTPSERVERREQUEST_P_H
 
 #include <QtHttpServer/qhttpserverrequest.h>
+#include <QtHttpServer/private/qhttpserverrequestbodydevice_p.h>
 #include <QtNetwork/private/qhttpheaderparser_p.h>
 #include <QtCore/private/qbytedata_p.h>
 
+#include <QtCore/qatomic.h>
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qmutex.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
 //
 //  W A R N I N G
 //  -------------
@@ -22,6 +31,35 @@ QT_BEGIN_NAMESPACE
 
 class QHttp2Stream;
 
+// The cancellation token of a request, shared with the code producing its
+// response in any thread. A request is canceled once, for the first of the
+// reasons to happen.
+class QHttpServerRequestCancellation
+{
+public:
+    enum class Reason {
+        None,
+        Disconnected, // The client closed the connection or reset the stream
+        TimedOut, // The deadline of the request expired
+        Aborted, // The server was drained and its deadline expired
+    };
+
+    explicit QHttpServerRequestCancellation(QDeadlineTimer deadline) : deadline(deadline) { }
+
+    void cancel(Reason reason);
+    bool isCanceled() const { return m_reason.loadAcquire() != int(Reason::None); }
+    Reason reason() const { return Reason(m_reason.loadAcquire()); }
+    // Calls function when the request is canceled, right away if it already is.
+    void onCanceled(std::function<void()> &&function);
+
+    const QDeadlineTimer deadline;
+
+private:
+    QAtomicInt m_reason;
+    QMutex m_mutex;
+    std::vector<std::function<void()>> m_callbacks;
+};
+
 class QHttpServerRequestPrivate
 {
 public:
@@ -32,6 +70,19 @@ public:
                               const QHostAddress &localAddress, quint16 localPort,
                               const QSslConfiguration &sslConfiguration);
 #endif
+    QHttpServerRequestPrivate(const QHttpServerRequestPrivate &other);
+
+    static QHttpServerRequestPrivate *get(QHttpServerRequest *request)
+    {
+        return request->d.get();
+    }
+
+    // A copy of request for the code that responds to it after its handler
+    // returned, as the request itself is reused or destroyed by then.
+    static std::shared_ptr<const QHttpServerRequest> copy(const QHttpServerRequest &request)
+    {
+        return std::shared_ptr<const QHttpServerRequest>(new QHttpServerRequest(request));
+    }
 
     quint16 port = 0;
 
@@ -86,6 +137,11 @@ public:
     QByteArray fragment;
     QByteDataBuffer bodyBuffer;
     QByteArray body;
+    // Set instead of body when the body is streamed to the handler.
+    std::unique_ptr<QHttpServerRequestBodyDevice> bodyDevice;
+
+    // Replaced for every request handled.
+    std::shared_ptr<QHttpServerRequestCancellation> cancellation;
 };
 
 QT_END_NAMESPACE
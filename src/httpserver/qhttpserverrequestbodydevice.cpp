@@ -0,0 +1,73 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include "qhttpserverrequestbodydevice_p.h"
+
+QT_BEGIN_NAMESPACE
+
+QHttpServerRequestBodyDevice::QHttpServerRequestBodyDevice()
+{
+    // Unbuffered, so that the data is only held once, in m_buffer.
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+QHttpServerRequestBodyDevice::~QHttpServerRequestBodyDevice()
+    = default;
+
+qint64 QHttpServerRequestBodyDevice::bytesAvailable() const
+{
+    return m_buffer.byteAmount() + QIODevice::bytesAvailable();
+}
+
+bool QHttpServerRequestBodyDevice::atEnd() const
+{
+    return m_finished && bytesAvailable() == 0;
+}
+
+/*!
+    \internal
+
+    Adds \a data to the received body and tells the reader about it.
+*/
+void QHttpServerRequestBodyDevice::append(const QByteDataBuffer &data)
+{
+    if (data.isEmpty())
+        return;
+
+    m_buffer.append(data);
+    emit readyRead();
+}
+
+/*!
+    \internal
+
+    Marks the body as completely received.
+*/
+void QHttpServerRequestBodyDevice::finish()
+{
+    if (m_finished)
+        return;
+
+    m_finished = true;
+    emit readChannelFinished();
+}
+
+qint64 QHttpServerRequestBodyDevice::readData(char *data, qint64 maxSize)
+{
+    if (m_buffer.isEmpty())
+        return m_finished ? -1 : 0;
+
+    const qint64 read = m_buffer.read(data, maxSize);
+    if (onConsumed)
+        onConsumed();
+    return read;
+}
+
+qint64 QHttpServerRequestBodyDevice::writeData(const char *data, qint64 size)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return -1;
+}
+
+QT_END_NAMESPACE
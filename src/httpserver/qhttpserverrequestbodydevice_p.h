@@ -0,0 +1,62 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERREQUESTBODYDEVICE_P_H
+#define QHTTPSERVERREQUESTBODYDEVICE_P_H
+
+#include <QtHttpServer/qthttpserverglobal.h>
+#include <QtCore/private/qbytedata_p.h>
+#include <QtCore/qiodevice.h>
+
+#include <functional>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of QHttpServer. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+
+QT_BEGIN_NAMESPACE
+
+// The body of a request that is passed to its handler while it is still
+// being received. The protocol handler appends the data as it arrives and
+// the handler reads it, both in the thread of the connection.
+class QHttpServerRequestBodyDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    QHttpServerRequestBodyDevice();
+    ~QHttpServerRequestBodyDevice() override;
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    bool atEnd() const override;
+
+    // Unread bytes received so far, not counting what QIODevice buffered.
+    qint64 bufferedBytes() const { return m_buffer.byteAmount(); }
+    bool isFinished() const { return m_finished; }
+
+    void append(const QByteDataBuffer &data);
+    void finish();
+
+    // Called after data was read, so that the protocol handler can receive
+    // more of it.
+    std::function<void()> onConsumed;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    QByteDataBuffer m_buffer;
+    bool m_finished = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // QHTTPSERVERREQUESTBODYDEVICE_P_H
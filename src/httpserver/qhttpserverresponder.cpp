@@ -11,6 +11,7 @@
 #include <private/qhttpserverstream_p.h>
 #include <QtCore/qjsondocument.h>
 #include <QtCore/qloggingcategory.h>
+#include <QtCore/qthread.h>
 #include <memory>
 
 QT_BEGIN_NAMESPACE
@@ -34,6 +35,7 @@ QT_BEGIN_NAMESPACE
     \value Continue
     \value SwitchingProtocols
     \value Processing
+    \value EarlyHints
 
     \value Ok
     \value Created
@@ -102,9 +104,9 @@ QT_BEGIN_NAMESPACE
 /*!
     \internal
 */
-QHttpServerResponderPrivate::QHttpServerResponderPrivate(QHttpServerStream *stream) : stream(stream)
+QHttpServerResponderPrivate::QHttpServerResponderPrivate(QHttpServerStream *stream)
+    : streamRef(stream->m_ref)
 {
-    Q_ASSERT(stream);
     stream->startHandlingRequest();
 }
 
@@ -113,8 +115,38 @@ QHttpServerResponderPrivate::QHttpServerResponderPrivate(QHttpServerStream *stre
 */
 QHttpServerResponderPrivate::~QHttpServerResponderPrivate()
 {
-    Q_ASSERT(stream);
-    stream->responderDestroyed();
+    callStream([](QHttpServerStream *target) { target->responderDestroyed(); });
+}
+
+/*!
+    \internal
+
+    Calls \a function with the stream in the thread of the stream. A responder
+    used by a handler running in another thread queues the calls on the
+    stream, which makes them in order, after the calls queued before.
+
+    Returns \c false, without calling \a function, if the stream was
+    destroyed already, together with its connection or worker thread.
+*/
+template <typename Function>
+bool QHttpServerResponderPrivate::callStream(Function &&function)
+{
+    QReadLocker locker(&streamRef->lock);
+    QHttpServerStream *target = streamRef->stream;
+    if (!target)
+        return false;
+    if (target->thread() == QThread::currentThread()) {
+        // The stream is only destroyed in its own thread, so it needs no lock
+        // here, and the call may destroy it.
+        locker.unlock();
+        // The responder may have been used in another thread before.
+        if (target->hasQueuedCalls())
+            target->flushQueuedCalls();
+        function(target);
+        return true;
+    }
+    target->queueCall(std::forward<Function>(function));
+    return true;
 }
 
 /*!
@@ -122,8 +154,10 @@ QHttpServerResponderPrivate::~QHttpServerResponderPrivate()
 */
 void QHttpServerResponderPrivate::write(QHttpServerResponder::StatusCode status)
 {
-    Q_ASSERT(stream);
-    stream->write(status, m_streamId);
+    statusCode = int(status);
+    callStream([status, streamId = m_streamId](QHttpServerStream *target) {
+        target->write(status, streamId);
+    });
 }
 
 /*!
@@ -132,8 +166,10 @@ void QHttpServerResponderPrivate::write(QHttpServerResponder::StatusCode status)
 void QHttpServerResponderPrivate::write(const QByteArray &body, const QHttpHeaders &headers,
                                         QHttpServerResponder::StatusCode status)
 {
-    Q_ASSERT(stream);
-    stream->write(body, headers, status, m_streamId);
+    statusCode = int(status);
+    callStream([body, headers, status, streamId = m_streamId](QHttpServerStream *target) {
+        target->write(body, headers, status, streamId);
+    });
 }
 
 /*!
@@ -142,8 +178,34 @@ void QHttpServerResponderPrivate::write(const QByteArray &body, const QHttpHeade
 void QHttpServerResponderPrivate::write(QIODevice *data, const QHttpHeaders &headers,
                                         QHttpServerResponder::StatusCode status)
 {
-    Q_ASSERT(stream);
-    stream->write(data, headers, status, m_streamId);
+    statusCode = int(status);
+    QThread *streamThread = nullptr;
+    {
+        QReadLocker locker(&streamRef->lock);
+        if (streamRef->stream)
+            streamThread = streamRef->stream->thread();
+    }
+    if (streamThread && data->thread() != streamThread) {
+        data->setParent(nullptr);
+        data->moveToThread(streamThread);
+    }
+    const bool called = callStream([data, headers, status, streamId = m_streamId](
+                                           QHttpServerStream *target) {
+        target->write(data, headers, status, streamId);
+    });
+    if (!called)
+        data->deleteLater();
+}
+
+/*!
+    \internal
+*/
+void QHttpServerResponderPrivate::writeInformational(QHttpServerResponder::StatusCode status,
+                                                     const QHttpHeaders &headers)
+{
+    callStream([status, headers, streamId = m_streamId](QHttpServerStream *target) {
+        target->writeInformational(status, headers, streamId);
+    });
 }
 
 /*!
@@ -152,8 +214,10 @@ void QHttpServerResponderPrivate::write(QIODevice *data, const QHttpHeaders &hea
 void QHttpServerResponderPrivate::writeBeginChunked(const QHttpHeaders &headers,
                                                     QHttpServerResponder::StatusCode status)
 {
-    Q_ASSERT(stream);
-    stream->writeBeginChunked(headers, status, m_streamId);
+    statusCode = int(status);
+    callStream([headers, status, streamId = m_streamId](QHttpServerStream *target) {
+        target->writeBeginChunked(headers, status, streamId);
+    });
 }
 
 /*!
@@ -161,8 +225,9 @@ void QHttpServerResponderPrivate::writeBeginChunked(const QHttpHeaders &headers,
 */
 void QHttpServerResponderPrivate::writeChunk(const QByteArray &data)
 {
-    Q_ASSERT(stream);
-    stream->writeChunk(data, m_streamId);
+    callStream([data, streamId = m_streamId](QHttpServerStream *target) {
+        target->writeChunk(data, streamId);
+    });
 }
 
 /*!
@@ -171,8 +236,9 @@ void QHttpServerResponderPrivate::writeChunk(const QByteArray &data)
 void QHttpServerResponderPrivate::writeEndChunked(const QByteArray &data,
                                                   const QHttpHeaders &trailers)
 {
-    Q_ASSERT(stream);
-    stream->writeEndChunked(data, trailers, m_streamId);
+    callStream([data, trailers, streamId = m_streamId](QHttpServerStream *target) {
+        target->writeEndChunked(data, trailers, streamId);
+    });
 }
 
 /*!
@@ -182,7 +248,6 @@ void QHttpServerResponderPrivate::writeEndChunked(const QByteArray &data,
 QHttpServerResponder::QHttpServerResponder(QHttpServerStream *stream)
     : d_ptr(new QHttpServerResponderPrivate(stream))
 {
-    Q_ASSERT(stream);
 }
 
 /*!
@@ -343,6 +408,39 @@ void QHttpServerResponder::sendResponse(const QHttpServerResponse &response)
     d->write(r->data, allHeaders, r->statusCode);
 }
 
+/*!
+    Sends a \c{103 Early Hints} informational response carrying \a headers
+    ahead of the final response.
+
+    This is typically used to announce resources the client will need to
+    render the final response, so that it can start fetching them on the
+    same connection while the request is still being processed:
+
+    \code
+    server.route("/", [](QHttpServerResponder &responder) {
+        QHttpHeaders hints;
+        hints.append(QHttpHeaders::WellKnownHeader::Link,
+                     "</app.css>; rel=preload; as=style");
+        hints.append(QHttpHeaders::WellKnownHeader::Link,
+                     "</app.js>; rel=preload; as=script");
+        responder.writeEarlyHints(hints);
+        responder.write(renderIndex(), "text/html");
+    });
+    \endcode
+
+    The preloaded resources are requested by the client as ordinary requests
+    and are served through the router like any other request. This function
+    can be called any number of times before the final response is written.
+
+    \since 6.9
+    \sa {https://www.rfc-editor.org/rfc/rfc8297}{RFC 8297}
+*/
+void QHttpServerResponder::writeEarlyHints(const QHttpHeaders &headers)
+{
+    Q_D(QHttpServerResponder);
+    d->writeInformational(StatusCode::EarlyHints, headers);
+}
+
 /*!
     Start sending chunks of data with \a headers and and the status
     code \a status. This call must be followed up with an arbitrary
@@ -28,6 +28,8 @@ class QHttpServerResponder final
 
     friend class QHttpServerHttp1ProtocolHandler;
     friend class QHttpServerHttp2ProtocolHandler;
+    friend class QHttpServerRouterPrivate;
+    friend class QHttpServerRouterRulePrivate;
 
 public:
     enum class StatusCode {
@@ -35,6 +37,7 @@ public:
         Continue = 100,
         SwitchingProtocols,
         Processing,
+        EarlyHints,
 
         // 2xx: Success
         Ok = 200,
@@ -139,6 +142,8 @@ public:
 
     Q_HTTPSERVER_EXPORT void sendResponse(const QHttpServerResponse &response);
 
+    Q_HTTPSERVER_EXPORT void writeEarlyHints(const QHttpHeaders &headers);
+
     Q_HTTPSERVER_EXPORT void writeBeginChunked(const QHttpHeaders &headers,
                                                StatusCode status = StatusCode::Ok);
 
@@ -8,6 +8,7 @@
 #include <QtHttpServer/qhttpserverrequest.h>
 #include <QtHttpServer/qhttpserverresponder.h>
 
+#include <private/qhttpserverconcurrencylimiter_p.h>
 #include <private/qhttpserverstream_p.h>
 
 #include <QtCore/qcoreapplication.h>
@@ -16,6 +17,7 @@
 #include <QtCore/qsysinfo.h>
 
 #include <type_traits>
+#include <vector>
 
 //
 //  W A R N I N G
@@ -35,21 +37,32 @@ public:
     QHttpServerResponderPrivate(QHttpServerStream *stream);
     ~QHttpServerResponderPrivate();
 
+    static QHttpServerResponder create(QHttpServerStream *stream)
+    {
+        return QHttpServerResponder(stream);
+    }
+
     void write(const QByteArray &body, const QHttpHeaders &headers,
                QHttpServerResponder::StatusCode status);
     void write(QHttpServerResponder::StatusCode status);
     void write(QIODevice *data, const QHttpHeaders &headers,
                QHttpServerResponder::StatusCode status);
+    void writeInformational(QHttpServerResponder::StatusCode status, const QHttpHeaders &headers);
     void writeBeginChunked(const QHttpHeaders &headers, QHttpServerResponder::StatusCode status);
     void writeChunk(const QByteArray &body);
     void writeEndChunked(const QByteArray &data, const QHttpHeaders &trailers);
 
-#if defined(QT_DEBUG)
-    const QPointer<QHttpServerStream> stream;
-#else
-    QHttpServerStream *const stream;
-#endif
+    template <typename Function>
+    bool callStream(Function &&function);
+
+    const std::shared_ptr<QHttpServerStreamRef> streamRef;
     quint32 m_streamId = 0;
+
+    // The status of the response written, or 0 if none was written yet.
+    int statusCode = 0;
+
+    // The admissions of the request, released with the responder.
+    std::vector<QHttpServerConcurrencyLimiter::Permit> permits;
 };
 
 QT_END_NAMESPACE
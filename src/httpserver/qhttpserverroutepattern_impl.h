@@ -0,0 +1,96 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERROUTEPATTERN_IMPL_H
+#define QHTTPSERVERROUTEPATTERN_IMPL_H
+
+#include <QtCore/qglobal.h>
+#include <QtCore/qstring.h>
+
+#include <array>
+#include <cstddef>
+
+QT_BEGIN_NAMESPACE
+
+namespace QtPrivate {
+
+// A route pattern given as a string literal, whose placeholders are found
+// at compile time. It can be used as a template argument with C++20, which
+// lets the number of placeholders be checked against the handler arguments
+// and spares the rule from searching the pattern for them.
+template<std::size_t N>
+struct RoutePattern
+{
+    static constexpr char Placeholder[] = "<arg>";
+    static constexpr std::size_t PlaceholderSize = sizeof(Placeholder) - 1;
+
+    char text[N] = {};
+
+    constexpr RoutePattern(const char (&pattern)[N])
+    {
+        for (std::size_t i = 0; i < N; ++i)
+            text[i] = pattern[i];
+    }
+
+    static constexpr std::size_t size() { return N - 1; }
+
+    constexpr bool isPlaceholderAt(std::size_t offset) const
+    {
+        if (offset + PlaceholderSize > size())
+            return false;
+        for (std::size_t i = 0; i < PlaceholderSize; ++i) {
+            if (text[offset + i] != Placeholder[i])
+                return false;
+        }
+        return true;
+    }
+
+    constexpr std::size_t placeholderCount() const
+    {
+        std::size_t count = 0;
+        for (std::size_t offset = 0; offset < size();) {
+            if (isPlaceholderAt(offset)) {
+                ++count;
+                offset += PlaceholderSize;
+            } else {
+                ++offset;
+            }
+        }
+        return count;
+    }
+
+    constexpr bool isAscii() const
+    {
+        for (std::size_t i = 0; i < size(); ++i) {
+            if (static_cast<unsigned char>(text[i]) > 0x7f)
+                return false;
+        }
+        return true;
+    }
+
+    // The offsets of the first Count placeholders in the pattern. These are
+    // their indexes in toString() only if the pattern isAscii().
+    template<std::size_t Count>
+    constexpr std::array<qsizetype, Count> placeholderOffsets() const
+    {
+        std::array<qsizetype, Count> offsets = {};
+        std::size_t count = 0;
+        for (std::size_t offset = 0; offset < size() && count < Count;) {
+            if (isPlaceholderAt(offset)) {
+                offsets[count++] = qsizetype(offset);
+                offset += PlaceholderSize;
+            } else {
+                ++offset;
+            }
+        }
+        return offsets;
+    }
+
+    QString toString() const { return QString::fromUtf8(text, qsizetype(size())); }
+};
+
+} // namespace QtPrivate
+
+QT_END_NAMESPACE
+
+#endif // QHTTPSERVERROUTEPATTERN_IMPL_H
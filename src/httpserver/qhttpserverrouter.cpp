@@ -8,10 +8,19 @@
 #include <QtHttpServer/qhttpserverrequest.h>
 #include <QtHttpServer/qhttpserver.h>
 
+#include <private/qabstracthttpserver_p.h>
+#include <private/qhttpserverrequest_p.h>
+#include <private/qhttpserverresponder_p.h>
 #include <private/qhttpserverrouterrule_p.h>
+#include <private/qhttpserverliterals_p.h>
 
+#include <QtCore/qalgorithms.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qmetatype.h>
+#include <QtCore/qstringlist.h>
+
+#include <algorithm>
+#include <chrono>
 
 QT_BEGIN_NAMESPACE
 
@@ -44,6 +53,36 @@ static const QHash<QMetaType, QString> defaultConverters = {
     { QMetaType::fromType<void>(), u""_s },
 };
 
+/*!
+    \internal
+
+    Returns \c true if \a pattern can be an alternative in a combined
+    expression. Back references, named groups and other constructs that
+    depend on group numbers or names would change meaning there.
+*/
+static bool isCombinablePattern(const QRegularExpression &pattern)
+{
+    if (!pattern.isValid())
+        return false;
+
+    const QString source = pattern.pattern();
+    for (qsizetype i = 0; i + 1 < source.size(); ++i) {
+        const QChar c = source.at(i);
+        const QChar next = source.at(i + 1);
+        if (c == u'\\') {
+            if (next.isDigit() || next == u'g' || next == u'k')
+                return false;
+            ++i;
+        } else if (c == u'(' && next == u'*') {
+            return false;
+        } else if (c == u'(' && next == u'?'
+                   && (i + 2 >= source.size() || source.at(i + 2) != u':')) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*!
     \class QHttpServerRouter
     \since 6.4
@@ -59,8 +98,37 @@ static const QHash<QMetaType, QString> defaultConverters = {
     handler gets the placeholders value as a \l QRegularExpressionMatch. The
     arguments can be of any type for which a \l{converters}{converter} is
     available. The handler creation can be simplified with
-    QHttpServerRouterRule::bindCaptured. A QHttpServerRouter instance must not
-    be modifed by its rules.
+    QHttpServerRouterRule::bindCaptured.
+
+    The handler of a rule is called in the thread of its context object. If
+    the context object lives in another thread than the connection, the
+    handler is invoked through the event loop of that thread, and its
+    responses are sent back to the thread of the connection.
+
+    Rules can be added at any time, also by request handlers and from other
+    threads. A request is dispatched with the rules that were added before it
+    arrived; rules added while it is handled apply to the requests that follow.
+
+    Rules are tried in the order they were added, and the first rule that
+    matches handles the request. Rules without placeholders are looked up by
+    their path, without evaluating a regular expression for each request.
+    The router indexes the path segments of
+    rules whose patterns only consist of literal text and placeholders of the
+    built-in numeric, QString and QByteArray types. A path segment is checked
+    against such a placeholder like the converter of its type does, so that
+    only the regular expression of the rule that handles the request is
+    evaluated, to capture the values passed to its handler.
+    The patterns of other rules are combined into a few regular expressions
+    per request method, which are built when the first request arrives after
+    rules were added. Rules of a class that overrides
+    QHttpServerRouterRule::matches() are tried for every request.
+
+    If no rule matches a request, but indexed rules match its path for other
+    request methods, the router answers with
+    \l{QHttpServerResponder::StatusCode}{MethodNotAllowed} and an \c Allow
+    header listing those methods. An \c OPTIONS request for such a path that
+    no rule handles is answered with the \c Allow header. No rule handler is
+    called in either case.
 
     \note This is a low-level routing API for an HTTP server.
 
@@ -130,15 +198,19 @@ static const QHash<QMetaType, QString> defaultConverters = {
     \endcode
 */
 
-/*! \fn template <typename ViewHandler, typename ViewTraits = QHttpServerRouterViewTraits<ViewHandler>> bool QHttpServerRouter::addRule(std::unique_ptr<QHttpServerRouterRule> rule)
+/*! \fn template <typename ViewHandler, typename ViewTraits = QHttpServerRouterViewTraits<ViewHandler>, typename Rule = QHttpServerRouterRule> bool QHttpServerRouter::addRule(std::unique_ptr<Rule> rule)
     Adds a new \a rule to the router.
 
+    Rule is QHttpServerRouterRule or a class derived from it. Rules of a
+    class that does not override QHttpServerRouterRule::matches() are
+    looked up by their path, others are tried one by one.
+
     Returns a pointer to the new rule if successful or \c nullptr otherwise.
 
     Inside addRule, we determine ViewHandler arguments and generate a list of
     their QMetaType::Type ids. Then we parse the URL and replace each \c <arg>
-    with a regexp for its type from the list. The \a rule must not modify the
-    QHttpServerRouter instance.
+    with a regexp for its type from the list. The new rule applies to the
+    requests received after the call.
 
     \code
     QHttpServerRouter router;
@@ -156,8 +228,32 @@ static const QHash<QMetaType, QString> defaultConverters = {
     \endcode
 */
 
+QHttpServerRouteTable::QHttpServerRouteTable()
+    : segmentTree(1)
+{
+}
+
+QHttpServerRouteTable::QHttpServerRouteTable(const QHttpServerRouteTable &other)
+    : routes(other.routes),
+      staticRules(other.staticRules),
+      segmentTree(other.segmentTree),
+      regexpRules(other.regexpRules),
+      unindexedRules(other.unindexedRules),
+      firstDerivedRule(other.firstDerivedRule),
+      routeCacheCapacity(other.routeCacheCapacity)
+{
+    setRouteCacheSize(routeCacheCapacity);
+}
+
+QHttpServerRouteTable::~QHttpServerRouteTable()
+{
+    clearCombinedMatchers();
+}
+
 QHttpServerRouterPrivate::QHttpServerRouterPrivate(QAbstractHttpServer *server)
-    : converters(defaultConverters), server(server)
+    : converters(defaultConverters),
+      server(server),
+      publishedTable(std::make_shared<const QHttpServerRouteTable>())
 {}
 
 /*!
@@ -257,49 +353,956 @@ QHash<QMetaType, QString> QHttpServerRouter::converters() &&
 
 QHttpServerRouterRule *QHttpServerRouter::addRuleImpl(std::unique_ptr<QHttpServerRouterRule> rule,
                                     std::initializer_list<QMetaType> metaTypes)
+{
+    // The class of the rule is not known, so it may override matches().
+    return addRuleImpl(std::move(rule), metaTypes, false);
+}
+
+/*!
+    \internal
+
+    Adds \a rule, whose handler takes arguments of \a metaTypes. If
+    \a matchesByPath is \c true, the class of \a rule does not override
+    QHttpServerRouterRule::matches(), so that the rule can be indexed by path.
+*/
+QHttpServerRouterRule *QHttpServerRouter::addRuleImpl(std::unique_ptr<QHttpServerRouterRule> rule,
+                                    std::initializer_list<QMetaType> metaTypes,
+                                    bool matchesByPath)
 {
     Q_D(QHttpServerRouter);
 
     if (!rule->hasValidMethods() || !rule->createPathRegexp(metaTypes, d->converters)) {
         return nullptr;
     }
-    if (!d->verifyThreadAffinity(rule->contextObject())) {
-        return nullptr;
-    }
+    auto *ruleD = rule->d_func();
+    QHttpServerRouterRule *added = rule.get();
 
-    return d->rules.emplace_back(std::move(rule)).get();
+    QMutexLocker locker(&d->tableMutex);
+    ruleD->setStatisticsEnabled(d->statisticsEnabled);
+    d->editableTable().addRoute(std::move(rule), ruleD, matchesByPath);
+    return added;
 }
 
 /*!
     Handles each new \a request for the HTTP server using \a responder.
 
-    Iterates through the list of rules to find the first that matches,
-    then executes this rule, returning \c true. Returns \c false if no rule
-    matches the request.
+    Iterates through the rules that can match the request path, in the order
+    they were added, to find the first that matches, then executes this rule,
+    returning \c true.
+
+    If no rule matches, but rules match the request path for other methods,
+    answers the request with the methods allowed for the path and returns
+    \c true. Returns \c false otherwise.
 */
 bool QHttpServerRouter::handleRequest(const QHttpServerRequest &request,
                                       QHttpServerResponder &responder) const
 {
     Q_D(const QHttpServerRouter);
-    for (const auto &rule : d->rules) {
-        if (!rule->contextObject())
+    const std::shared_ptr<const QHttpServerRouteTable> table = d->table();
+    QRegularExpressionMatch match;
+    const qsizetype index = d->matchRoute(*table, request, &match);
+    if (index != -1) {
+        d->callHandler(table->routes[index], match, request, responder);
+        return true;
+    }
+
+    const QHttpServerRequest::Methods allowed = d->allowedMethods(*table, request.url().path());
+    if (!allowed)
+        return false;
+
+    d->writeAllowedMethods(request, responder, allowed);
+    return true;
+}
+
+/*!
+    \since 6.9
+
+    Sets \a size as the number of request paths for which the router
+    remembers the rule that handled them, together with the values captured
+    from the path. Further requests with the same method and path are passed
+    to that rule without matching them again. When more paths are handled,
+    the least recently used ones are forgotten. A value of \c 0 disables the
+    cache, which is the default.
+
+    Larger caches are split by path into parts that are locked on their
+    own, so that requests handled in several threads rarely wait for each
+    other. The least recently used path is then forgotten from its part.
+
+    Only rules added before the first rule of a class overriding
+    QHttpServerRouterRule::matches() are remembered, as such a rule may
+    decide on more than the method and path. Adding a rule clears the cache.
+
+    \sa routeCacheSize()
+*/
+void QHttpServerRouter::setRouteCacheSize(qsizetype size)
+{
+    Q_D(QHttpServerRouter);
+    QMutexLocker locker(&d->tableMutex);
+    d->editableTable().setRouteCacheSize(size);
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of request paths for which the router remembers the
+    rule that handled them.
+
+    \sa setRouteCacheSize()
+*/
+qsizetype QHttpServerRouter::routeCacheSize() const
+{
+    Q_D(const QHttpServerRouter);
+    return d->table()->routeCacheSize();
+}
+
+/*!
+    \since 6.9
+
+    Sets whether the router collects statistics for its rules to \a enabled.
+    Statistics are disabled by default.
+
+    While enabled, the router counts the requests passed to each rule, the
+    time its handler takes and the status codes of its responses. The
+    counters are cheap to update from several threads at once, but timing
+    the handlers adds some overhead to each request.
+
+    Disabling statistics keeps the counts collected so far.
+
+    \sa isStatisticsEnabled(), statistics(), QHttpServerRouterRule::statistics()
+*/
+void QHttpServerRouter::setStatisticsEnabled(bool enabled)
+{
+    Q_D(QHttpServerRouter);
+    QMutexLocker locker(&d->tableMutex);
+    d->statisticsEnabled = enabled;
+    const auto table = d->latestTable();
+    for (const auto &route : table->routes)
+        route.d->setStatisticsEnabled(enabled);
+}
+
+/*!
+    \since 6.9
+
+    Returns \c true if the router collects statistics for its rules.
+
+    \sa setStatisticsEnabled()
+*/
+bool QHttpServerRouter::isStatisticsEnabled() const
+{
+    Q_D(const QHttpServerRouter);
+    QMutexLocker locker(&d->tableMutex);
+    return d->statisticsEnabled;
+}
+
+/*!
+    \since 6.9
+
+    Returns the statistics collected for all rules of the router together.
+    Use QHttpServerRouterRule::statistics() to get the statistics of a single
+    rule.
+
+    \sa setStatisticsEnabled(), resetStatistics()
+*/
+QHttpServerRouteStatistics QHttpServerRouter::statistics() const
+{
+    Q_D(const QHttpServerRouter);
+    QHttpServerRouteStatistics statistics;
+    const auto table = d->table();
+    for (const auto &route : table->routes) {
+        if (const auto *counters = route.d->counters.load(std::memory_order_acquire))
+            counters->addTo(&statistics);
+    }
+    return statistics;
+}
+
+/*!
+    \since 6.9
+
+    Sets the statistics collected for all rules of the router to zero.
+
+    \sa statistics()
+*/
+void QHttpServerRouter::resetStatistics()
+{
+    Q_D(QHttpServerRouter);
+    const auto table = d->table();
+    for (const auto &route : table->routes) {
+        if (auto *counters = route.d->counters.load(std::memory_order_acquire))
+            counters->reset();
+    }
+}
+
+/*!
+    \internal
+
+    Returns the index in \a table of the first rule that handles \a request,
+    in the order they were added, and sets \a match to the values it
+    captured from the request path. Returns \c -1 if there is none.
+*/
+qsizetype QHttpServerRouterPrivate::matchRoute(const QHttpServerRouteTable &table,
+                                               const QHttpServerRequest &request,
+                                               QRegularExpressionMatch *match) const
+{
+    const QString path = request.url().path();
+    const QHttpServerRouteTable::RouteCacheKey cacheKey{ path, request.method() };
+    const bool useCache = table.routeCacheSize() > 0;
+    if (useCache) {
+        if (const auto cached = table.cachedRoute(cacheKey)) {
+            if (table.routes[cached->ruleIndex].rule->contextObject()) {
+                *match = cached->match;
+                return cached->ruleIndex;
+            }
+            table.uncacheRoute(cacheKey);
+        }
+    }
+
+    QHttpServerRouteTable::RuleIndexes candidates;
+    table.candidateRules(path, request.method(), &candidates);
+
+    // The combined expressions are only run once the candidates added
+    // before the first rule they hold have not matched.
+    const qsizetype lowestRegexp = table.lowestRegexpRule(request.method());
+    bool regexpsTried = lowestRegexp == -1;
+    qsizetype regexpHit = -1;
+
+    for (qsizetype i = 0; ; ++i) {
+        if (!regexpsTried && (i == candidates.size() || lowestRegexp < candidates[i])) {
+            regexpsTried = true;
+            regexpHit = table.firstRegexpRule(path, request.method());
+            if (regexpHit != -1) {
+                candidates.insert(std::lower_bound(candidates.begin() + i, candidates.end(),
+                                                   regexpHit),
+                                  regexpHit);
+            }
+        }
+        if (i == candidates.size())
+            break;
+
+        const qsizetype index = candidates[i];
+        const auto &route = table.routes[index];
+        const auto &rule = route.rule;
+        if (rule->contextObject()) {
+            const auto *ruleD = route.d;
+            if (!ruleD->isPlain) {
+                if (ruleD->routerHandler && rule->matches(request, match))
+                    return index;
+                *match = QRegularExpressionMatch();
+            } else {
+                if (ruleD->staticMatch.hasMatch() && ruleD->staticMatch.capturedView() == path)
+                    *match = ruleD->staticMatch;
+                else if (!rule->matches(request, match))
+                    *match = QRegularExpressionMatch();
+
+                if (match->hasMatch()) {
+                    if (useCache && index < table.firstDerivedRule)
+                        table.cacheRoute(cacheKey, { index, *match });
+                    return index;
+                }
+            }
+        }
+
+        // The combined expressions only report the first rule whose pattern
+        // matches. If it does not handle the request, the later ones have
+        // to be tried one by one.
+        if (index == regexpHit) {
+            const qsizetype tried = i + 1;
+            table.appendRegexpRules(request.method(), index, &candidates);
+            std::sort(candidates.begin() + tried, candidates.end());
+        }
+    }
+    return -1;
+}
+
+/*!
+    \internal
+
+    Returns \c true if the body of \a request, whose headers are received,
+    is to be streamed to the handler of its rule. Called in the thread of
+    the connection, for which the rule's handler has to be called directly.
+*/
+bool QHttpServerRouterPrivate::streamsRequestBody(const QHttpServerRequest &request) const
+{
+    if (QHttpServerRouterRulePrivate::bodyStreamingRuleCount.loadRelaxed() == 0)
+        return false;
+
+    const std::shared_ptr<const QHttpServerRouteTable> table = this->table();
+    QRegularExpressionMatch match;
+    const qsizetype index = matchRoute(*table, request, &match);
+    if (index == -1)
+        return false;
+
+    const auto &route = table->routes[index];
+    return route.d->streamsBody.load(std::memory_order_relaxed)
+            && QAbstractHttpServerPrivate::get(server)->callsDirectly(route.rule->contextObject());
+}
+
+/*!
+    \internal
+
+    Calls the handler of \a route once the request is admitted by the limits
+    on the requests in flight, of the server and of the rule.
+*/
+void QHttpServerRouterPrivate::callHandler(const QHttpServerRouteTable::Route &route,
+                                           const QRegularExpressionMatch &match,
+                                           const QHttpServerRequest &request,
+                                           QHttpServerResponder &responder) const
+{
+    if (!QAbstractHttpServerPrivate::get(server)->requestLimiter->isLimited()
+        && !route.d->limiter->isLimited()) {
+        dispatchHandler(route, match, request, responder);
+        return;
+    }
+    admitHandler(route, match, request, responder);
+}
+
+/*!
+    \internal
+
+    Acquires a permit from each limiter \a responder does not hold one of
+    yet, and calls the handler of \a route once it holds them all. A request
+    that has to wait for a permit is moved to a waiter, with a copy of the
+    request, which calls this function again in the same thread when it is
+    admitted.
+
+    The permit of the rule is acquired first, so that a request waiting for
+    a busy rule does not keep one of the server from requests to other rules.
+*/
+void QHttpServerRouterPrivate::admitHandler(const QHttpServerRouteTable::Route &route,
+                                            const QRegularExpressionMatch &match,
+                                            const QHttpServerRequest &request,
+                                            QHttpServerResponder &responder) const
+{
+    const QAbstractHttpServerPrivate *serverD = QAbstractHttpServerPrivate::get(server);
+    const QHttpServerConfiguration configuration = server->configuration();
+    route.d->limiter->setAdaptive(configuration.isAdaptiveConcurrencyEnabled());
+
+    std::vector<QHttpServerConcurrencyLimiter::Permit> &permits = responder.d_ptr->permits;
+    for (QHttpServerConcurrencyLimiter *limiter :
+         { route.d->limiter.get(), serverD->requestLimiter.get() }) {
+        const auto isFromLimiter = [limiter](const QHttpServerConcurrencyLimiter::Permit &permit) {
+            return permit.isFrom(limiter);
+        };
+        if (!limiter->isLimited() || std::any_of(permits.cbegin(), permits.cend(), isFromLimiter))
             continue;
-        if (!d->verifyThreadAffinity(rule->contextObject()))
+        if (QHttpServerConcurrencyLimiter::Permit permit = limiter->tryAcquire()) {
+            permits.push_back(std::move(permit));
             continue;
-        if (rule->exec(request, responder))
-            return true;
+        }
+
+        const std::chrono::milliseconds timeout = configuration.admissionTimeout();
+        if (timeout <= std::chrono::milliseconds::zero()) {
+            rejectRequest(request, responder, timeout);
+            return;
+        }
+
+        qCDebug(lcRouter) << "Waiting to admit" << request.url().path();
+        auto heldResponder = std::make_shared<QHttpServerResponder>(std::move(responder));
+        std::shared_ptr<const QHttpServerRequest> heldRequest =
+                QHttpServerRequestPrivate::copy(request);
+        limiter->acquire(
+                serverD->connectionContext(), timeout,
+                [this, route, match, heldRequest, heldResponder](
+                        QHttpServerConcurrencyLimiter::Permit &&permit) {
+                    heldResponder->d_ptr->permits.push_back(std::move(permit));
+                    admitHandler(route, match, *heldRequest, *heldResponder);
+                },
+                [this, heldRequest, heldResponder, timeout]() {
+                    rejectRequest(*heldRequest, *heldResponder, timeout);
+                });
+        return;
     }
+    dispatchHandler(route, match, request, responder);
+}
 
-    return false;
+/*!
+    \internal
+
+    Answers a request that was not admitted within \a admissionTimeout with
+    \c {503 Service Unavailable}. Clients are asked to retry once a request
+    waiting for admission would have given up.
+*/
+void QHttpServerRouterPrivate::rejectRequest(const QHttpServerRequest &request,
+                                             QHttpServerResponder &responder,
+                                             std::chrono::milliseconds admissionTimeout) const
+{
+    qCDebug(lcRouter) << "Too many requests in flight, rejecting" << request.url().path();
+    const auto retryAfter = std::max(std::chrono::ceil<std::chrono::seconds>(admissionTimeout),
+                                     std::chrono::seconds(1));
+    QHttpHeaders headers;
+    headers.append(QHttpHeaders::WellKnownHeader::RetryAfter,
+                   QByteArray::number(qint64(retryAfter.count())));
+    responder.write(headers, QHttpServerResponder::StatusCode::ServiceUnavailable);
 }
 
-bool QHttpServerRouterPrivate::verifyThreadAffinity(const QObject *contextObject) const
+/*!
+    \internal
+
+    Calls the handler of \a route, in the thread of its context object: a
+    handler whose context object lives in another thread is invoked through
+    the event loop of that thread, with \a responder and a copy of
+    \a request moved to it.
+*/
+void QHttpServerRouterPrivate::dispatchHandler(const QHttpServerRouteTable::Route &route,
+                                               const QRegularExpressionMatch &match,
+                                               const QHttpServerRequest &request,
+                                               QHttpServerResponder &responder) const
 {
-    if (contextObject && (contextObject->thread() != server->thread())) {
-        qCWarning(lcRouter, "QHttpServerRouter: the context object must reside in the same thread");
-        return false;
+    const QObject *context = route.rule->contextObject();
+    if (QAbstractHttpServerPrivate::get(server)->callsDirectly(context)) {
+        route.d->callHandler(match, request, responder);
+        return;
+    }
+
+    qCDebug(lcRouter) << "Queuing the handler for" << request.url().path() << "to"
+                      << context->thread();
+    QAbstractHttpServerPrivate::invokeQueued(
+            context, std::move(responder),
+            [rule = route.rule, ruleD = route.d, match,
+             heldRequest = QHttpServerRequestPrivate::copy(request)](
+                    QHttpServerResponder &responder) {
+                ruleD->callHandler(match, *heldRequest, responder);
+            });
+}
+
+/*!
+    \internal
+
+    Returns the route table to dispatch a request with, first publishing the
+    changes made since the last call.
+*/
+std::shared_ptr<const QHttpServerRouteTable> QHttpServerRouterPrivate::table() const
+{
+    if (hasPendingTable.loadAcquire()) {
+        QMutexLocker locker(&tableMutex);
+        if (pendingTable) {
+            storeTable(std::move(pendingTable));
+            pendingTable.reset();
+            hasPendingTable.storeRelease(false);
+        }
+    }
+    return loadTable();
+}
+
+/*!
+    \internal
+
+    Returns the route table changes are to be made to. This is a copy of the
+    published table, which replaces it with the next call to table(). The
+    caller must hold tableMutex.
+*/
+QHttpServerRouteTable &QHttpServerRouterPrivate::editableTable()
+{
+    if (!pendingTable) {
+        pendingTable = std::make_shared<QHttpServerRouteTable>(*loadTable());
+        hasPendingTable.storeRelease(true);
+    }
+    return *pendingTable;
+}
+
+/*!
+    \internal
+
+    Returns the table with all changes made so far, published or not. The
+    caller must hold tableMutex.
+*/
+std::shared_ptr<const QHttpServerRouteTable> QHttpServerRouterPrivate::latestTable() const
+{
+    if (pendingTable)
+        return pendingTable;
+    return loadTable();
+}
+
+std::shared_ptr<const QHttpServerRouteTable> QHttpServerRouterPrivate::loadTable() const
+{
+#if defined(__cpp_lib_atomic_shared_ptr)
+    return publishedTable.load(std::memory_order_acquire);
+#else
+    return std::atomic_load_explicit(&publishedTable, std::memory_order_acquire);
+#endif
+}
+
+void QHttpServerRouterPrivate::storeTable(std::shared_ptr<const QHttpServerRouteTable> table) const
+{
+#if defined(__cpp_lib_atomic_shared_ptr)
+    publishedTable.store(std::move(table), std::memory_order_release);
+#else
+    std::atomic_store_explicit(&publishedTable, std::move(table), std::memory_order_release);
+#endif
+}
+
+/*!
+    \internal
+
+    Adds \a rule, whose private part is \a d, and indexes it. Only \a isPlain
+    rules, whose class does not override matches(), are indexed.
+*/
+void QHttpServerRouteTable::addRoute(std::unique_ptr<QHttpServerRouterRule> rule,
+                                     QHttpServerRouterRulePrivate *d, bool isPlain)
+{
+    const qsizetype index = qsizetype(routes.size());
+    const IndexedRule indexed{ index, d->methods };
+    d->isPlain = isPlain;
+    if (!isPlain) {
+        unindexedRules.push_back(index);
+        firstDerivedRule = qMin(firstDerivedRule, index);
+    } else if (!d->isSegmentIndexable) {
+        if (isCombinablePattern(d->pathRegexp)) {
+            regexpRules.push_back(indexed);
+            clearCombinedMatchers();
+        } else {
+            unindexedRules.push_back(index);
+        }
+    } else if (std::none_of(d->pathSegments.cbegin(), d->pathSegments.cend(),
+                            [](const auto &segment) { return segment.isCapture(); })) {
+        QStringList literals;
+        for (const auto &segment : std::as_const(d->pathSegments))
+            literals.append(segment.literal);
+        const QString path = literals.join(u'/');
+        d->staticMatch = d->pathRegexp.match(path);
+        Q_ASSERT(d->staticMatch.hasMatch());
+        staticRules[path].push_back(indexed);
+    } else {
+        indexRule(indexed, d->pathSegments);
+    }
+    clearRouteCache();
+
+    routes.push_back({ std::shared_ptr<QHttpServerRouterRule>(std::move(rule)), d });
+}
+
+/*!
+    \internal
+
+    Sets the number of routes the cache holds to \a size, split over as many
+    shards as fit MinRoutesPerShard routes each. Only called before the
+    table is published.
+*/
+void QHttpServerRouteTable::setRouteCacheSize(qsizetype size)
+{
+    routeCacheCapacity = qMax(size, qsizetype(0));
+    const qsizetype shardCount = std::clamp(routeCacheCapacity / MinRoutesPerShard,
+                                            qsizetype(1), MaxRouteCacheShards);
+    if (shardCount != routeCacheShardCount) {
+        // The keys would be looked up in other shards.
+        clearRouteCache();
+        routeCacheShardCount = shardCount;
+    }
+    for (qsizetype i = 0; i < MaxRouteCacheShards; ++i) {
+        // The shards share the remainder of the division.
+        const qsizetype shardSize = i < shardCount
+                ? routeCacheCapacity / shardCount + (i < routeCacheCapacity % shardCount)
+                : 0;
+        routeCacheShards[i].cache.setMaxCost(shardSize);
+    }
+}
+
+QHttpServerRouteTable::RouteCacheShard &
+QHttpServerRouteTable::routeCacheShard(const RouteCacheKey &key) const
+{
+    if (routeCacheShardCount == 1)
+        return routeCacheShards[0];
+    return routeCacheShards[qHash(key) % size_t(routeCacheShardCount)];
+}
+
+void QHttpServerRouteTable::clearRouteCache()
+{
+    for (RouteCacheShard &shard : routeCacheShards) {
+        QMutexLocker locker(&shard.mutex);
+        shard.cache.clear();
+    }
+}
+
+std::optional<QHttpServerRouteTable::CachedRoute>
+QHttpServerRouteTable::cachedRoute(const RouteCacheKey &key) const
+{
+    RouteCacheShard &shard = routeCacheShard(key);
+    QMutexLocker locker(&shard.mutex);
+    if (const CachedRoute *cached = shard.cache.object(key)) {
+        CachedRoute route = *cached;
+        locker.unlock();
+        routeCacheHitCount.fetchAndAddRelaxed(1);
+        return route;
+    }
+    return std::nullopt;
+}
+
+void QHttpServerRouteTable::cacheRoute(const RouteCacheKey &key, const CachedRoute &route) const
+{
+    RouteCacheShard &shard = routeCacheShard(key);
+    QMutexLocker locker(&shard.mutex);
+    shard.cache.insert(key, new CachedRoute(route));
+}
+
+void QHttpServerRouteTable::uncacheRoute(const RouteCacheKey &key) const
+{
+    RouteCacheShard &shard = routeCacheShard(key);
+    QMutexLocker locker(&shard.mutex);
+    shard.cache.remove(key);
+}
+
+bool QHttpServerRouteTable::isRouteCached(const RouteCacheKey &key) const
+{
+    RouteCacheShard &shard = routeCacheShard(key);
+    QMutexLocker locker(&shard.mutex);
+    return shard.cache.contains(key);
+}
+
+quint64 QHttpServerRouteTable::routeCacheHits() const
+{
+    return routeCacheHitCount.loadRelaxed();
+}
+
+void QHttpServerRouteTable::indexRule(
+        const IndexedRule &rule, const QList<QHttpServerRouterRulePrivate::PathSegment> &segments)
+{
+    qsizetype node = 0;
+    for (const auto &segment : segments) {
+        if (segment.isCapture()) {
+            auto &captureChildren = segmentTree[node].captureChildren;
+            const auto it = std::find_if(captureChildren.cbegin(), captureChildren.cend(),
+                                         [&segment](const auto &child) {
+                                             return child.first == segment.capture;
+                                         });
+            if (it != captureChildren.cend()) {
+                node = it->second;
+            } else {
+                const qsizetype child = qsizetype(segmentTree.size());
+                captureChildren.emplace_back(segment.capture, child);
+                segmentTree.emplace_back();
+                node = child;
+            }
+            continue;
+        }
+
+        auto &children = segmentTree[node].literalChildren;
+        auto it = std::lower_bound(children.begin(), children.end(), segment.literal,
+                                   [](const auto &child, const QString &literal) {
+                                       return child.first < literal;
+                                   });
+        if (it != children.end() && it->first == segment.literal) {
+            node = it->second;
+        } else {
+            const qsizetype child = qsizetype(segmentTree.size());
+            children.emplace(it, segment.literal, child);
+            segmentTree.emplace_back();
+            node = child;
+        }
+    }
+    segmentTree[node].rules.push_back(rule);
+}
+
+/*!
+    \internal
+
+    Fills \a candidates with the indexes of the rules that can match \a path
+    for \a method, in the order the rules were added. Rules without captures
+    are looked up by their whole path, other indexed rules by path segment.
+    A segment holding a capture is checked like the converter of its type
+    does, so only the rules whose captures can match are returned. Their
+    regular expression is still evaluated for the rule that handles the
+    request, to give its handler the captured values.
+*/
+void QHttpServerRouteTable::candidateRules(const QString &path,
+                                           QHttpServerRequest::Method method,
+                                           RuleIndexes *candidates) const
+{
+    // '$' also matches before a final newline, so treat such a path like
+    // the same path without it.
+    QStringView lookupPath = path;
+    if (lookupPath.endsWith(u'\n'))
+        lookupPath.chop(1);
+
+    const auto it = staticRules.constFind(lookupPath.size() == path.size()
+                                                  ? path : lookupPath.toString());
+    if (it != staticRules.cend()) {
+        for (const IndexedRule &rule : *it) {
+            if (rule.methods & method)
+                candidates->append(rule.index);
+        }
+    }
+
+    QVarLengthArray<QStringView, 16> segments;
+    for (QStringView segment : lookupPath.tokenize(u'/'))
+        segments.append(segment);
+
+    collectRules(0, segments, method, candidates);
+    for (qsizetype index : unindexedRules)
+        candidates->append(index);
+    std::sort(candidates->begin(), candidates->end());
+}
+
+void QHttpServerRouteTable::collectRules(qsizetype node, QSpan<const QStringView> segments,
+                                         QHttpServerRequest::Methods methods,
+                                         RuleIndexes *candidates) const
+{
+    const SegmentNode &current = segmentTree[node];
+    if (segments.empty()) {
+        for (const IndexedRule &rule : current.rules) {
+            if (rule.methods & methods)
+                candidates->append(rule.index);
+        }
+        return;
+    }
+
+    const QStringView segment = segments.front();
+    const auto &children = current.literalChildren;
+    const auto it = std::lower_bound(children.cbegin(), children.cend(), segment,
+                                     [](const auto &child, QStringView literal) {
+                                         return QStringView(child.first) < literal;
+                                     });
+    if (it != children.cend() && it->first == segment)
+        collectRules(it->second, segments.subspan(1), methods, candidates);
+    for (const auto &[kind, child] : current.captureChildren) {
+        if (QHttpServerRouterRulePrivate::acceptsCapture(kind, segment))
+            collectRules(child, segments.subspan(1), methods, candidates);
+    }
+}
+
+void QHttpServerRouteTable::clearCombinedMatchers()
+{
+    for (auto &matchers : combinedMatchers)
+        delete matchers.fetchAndStoreRelaxed(nullptr);
+}
+
+/*!
+    \internal
+
+    Returns the combined expressions for the rules in regexpRules that accept
+    \a method, building them on first use. Each expression holds a bounded
+    number of alternatives, as the size of a compiled expression is limited.
+*/
+const QHttpServerRouteTable::CombinedMatchers &
+QHttpServerRouteTable::combinedMatchersFor(QHttpServerRequest::Method method) const
+{
+    constexpr qsizetype MaxAlternatives = 128;
+
+    // Once published, the matchers are not modified any more and are used
+    // without taking the lock.
+    auto &published = combinedMatchers[qCountTrailingZeroBits(uint(method))];
+    if (const CombinedMatchers *matchers = published.loadAcquire())
+        return *matchers;
+
+    QMutexLocker locker(&lazyMutex);
+    if (const CombinedMatchers *matchers = published.loadRelaxed())
+        return *matchers;
+
+    auto matchers = std::make_unique<CombinedMatchers>();
+    CombinedMatcher current;
+    QString pattern;
+    int group = 1;
+    const auto finish = [&]() {
+        if (current.alternatives.empty())
+            return;
+        current.regexp.setPattern(pattern);
+        current.regexp.optimize();
+        if (!current.regexp.isValid()) {
+            qCDebug(lcRouter) << "Could not combine route patterns:"
+                              << current.regexp.errorString();
+        }
+        matchers->push_back(std::move(current));
+        current = {};
+        pattern.clear();
+        group = 1;
+    };
+
+    for (const IndexedRule &indexed : regexpRules) {
+        if (!(indexed.methods & method))
+            continue;
+        const QRegularExpression &ruleRegexp = routes[indexed.index].d->pathRegexp;
+        if (!pattern.isEmpty())
+            pattern += u'|';
+        pattern += u'(';
+        pattern += ruleRegexp.pattern();
+        pattern += u')';
+        current.alternatives.emplace_back(indexed.index, group);
+        group += 1 + ruleRegexp.captureCount();
+        if (qsizetype(current.alternatives.size()) == MaxAlternatives)
+            finish();
+    }
+    finish();
+
+    published.storeRelease(matchers.get());
+    return *matchers.release();
+}
+
+/*!
+    \internal
+
+    Returns the index of the first rule in regexpRules that accepts \a method,
+    or -1 if there is none. No rule in regexpRules can handle a request for
+    \a method before it.
+*/
+qsizetype QHttpServerRouteTable::lowestRegexpRule(QHttpServerRequest::Method method) const
+{
+    if (regexpRules.empty() || method == QHttpServerRequest::Method::Unknown)
+        return -1;
+
+    const CombinedMatchers &matchers = combinedMatchersFor(method);
+    return matchers.empty() ? -1 : matchers.front().alternatives.front().first;
+}
+
+/*!
+    \internal
+
+    Returns the index of the first rule in regexpRules whose pattern matches
+    \a path and that accepts \a method, or -1 if there is none.
+*/
+qsizetype QHttpServerRouteTable::firstRegexpRule(const QString &path,
+                                                 QHttpServerRequest::Method method) const
+{
+    if (regexpRules.empty() || method == QHttpServerRequest::Method::Unknown)
+        return -1;
+
+    for (const CombinedMatcher &matcher : combinedMatchersFor(method)) {
+        if (!matcher.regexp.isValid()) {
+            for (const auto &[index, group] : matcher.alternatives) {
+                if (routes[index].d->pathRegexp.match(path).hasMatch())
+                    return index;
+            }
+            continue;
+        }
+
+        const QRegularExpressionMatch match = matcher.regexp.match(path);
+        if (!match.hasMatch())
+            continue;
+        for (const auto &[index, group] : matcher.alternatives) {
+            if (match.capturedStart(group) != -1)
+                return index;
+        }
+    }
+    return -1;
+}
+
+/*!
+    \internal
+
+    Appends the rules in regexpRules that accept \a method and were added
+    after the rule at index \a after to \a candidates.
+*/
+void QHttpServerRouteTable::appendRegexpRules(QHttpServerRequest::Method method,
+                                              qsizetype after,
+                                              RuleIndexes *candidates) const
+{
+    for (const IndexedRule &indexed : regexpRules) {
+        if (indexed.index > after && (indexed.methods & method))
+            candidates->append(indexed.index);
+    }
+}
+
+/*!
+    \internal
+
+    Returns \c true if the rule for \a path and \a method is in the route
+    cache of the current table. Used by the tests.
+*/
+bool QHttpServerRouterPrivate::isRouteCached(const QString &path,
+                                             QHttpServerRequest::Method method) const
+{
+    return table()->isRouteCached({ path, method });
+}
+
+/*!
+    \internal
+
+    Returns the number of requests whose rule was found in the route cache
+    of the current table. Used by the tests.
+*/
+quint64 QHttpServerRouterPrivate::routeCacheHits() const
+{
+    return table()->routeCacheHits();
+}
+
+bool QHttpServerRouterPrivate::isDispatchable(const QHttpServerRouteTable &table,
+                                              qsizetype index) const
+{
+    return table.routes[index].rule->contextObject() != nullptr;
+}
+
+/*!
+    \internal
+
+    Returns the methods of the rules in \a table that match \a path. Rules
+    overriding matches() are not taken into account, as their matches() may
+    depend on more than the path and method.
+*/
+QHttpServerRequest::Methods
+QHttpServerRouterPrivate::allowedMethods(const QHttpServerRouteTable &table,
+                                         const QString &path) const
+{
+    QHttpServerRouteTable::RuleIndexes matching;
+    table.candidateRules(path, QHttpServerRequest::Method::AnyKnown, &matching);
+
+    QHttpServerRequest::Methods allowed;
+    for (qsizetype index : std::as_const(matching)) {
+        const auto *ruleD = table.routes[index].d;
+        if (!ruleD->isSegmentIndexable || !isDispatchable(table, index))
+            continue;
+        if (!ruleD->staticMatch.hasMatch()) {
+            const QRegularExpressionMatch match = ruleD->pathRegexp.match(path);
+            if (!match.hasMatch() || ruleD->pathRegexp.captureCount() != match.lastCapturedIndex())
+                continue;
+        }
+        allowed |= ruleD->methods;
+    }
+
+    for (const auto &indexed : table.regexpRules) {
+        if ((allowed & indexed.methods) == indexed.methods || !isDispatchable(table, indexed.index))
+            continue;
+        const QRegularExpression &regexp = table.routes[indexed.index].d->pathRegexp;
+        const QRegularExpressionMatch match = regexp.match(path);
+        if (match.hasMatch() && regexp.captureCount() == match.lastCapturedIndex())
+            allowed |= indexed.methods;
+    }
+    return allowed;
+}
+
+/*!
+    \internal
+
+    Answers \a request, which no rule handles, with the \a methods allowed
+    for its path: an \c OPTIONS request with success, any other with
+    \l{QHttpServerResponder::StatusCode}{MethodNotAllowed}.
+*/
+void QHttpServerRouterPrivate::writeAllowedMethods(const QHttpServerRequest &request,
+                                                   QHttpServerResponder &responder,
+                                                   QHttpServerRequest::Methods methods) const
+{
+    static constexpr std::pair<QHttpServerRequest::Method, const char *> methodNames[] = {
+        { QHttpServerRequest::Method::Get, "GET" },
+        { QHttpServerRequest::Method::Head, "HEAD" },
+        { QHttpServerRequest::Method::Post, "POST" },
+        { QHttpServerRequest::Method::Put, "PUT" },
+        { QHttpServerRequest::Method::Delete, "DELETE" },
+        { QHttpServerRequest::Method::Connect, "CONNECT" },
+        { QHttpServerRequest::Method::Options, "OPTIONS" },
+        { QHttpServerRequest::Method::Trace, "TRACE" },
+        { QHttpServerRequest::Method::Patch, "PATCH" },
+    };
+
+    // The router itself answers OPTIONS for every path it knows.
+    methods |= QHttpServerRequest::Method::Options;
+
+    QByteArray allow;
+    for (const auto &[method, name] : methodNames) {
+        if (!(methods & method))
+            continue;
+        if (!allow.isEmpty())
+            allow += ", ";
+        allow += name;
+    }
+
+    QHttpHeaders headers;
+    headers.append(QHttpHeaders::WellKnownHeader::ContentType,
+                   QHttpServerLiterals::contentTypeXEmpty());
+    headers.append(QHttpHeaders::WellKnownHeader::Allow, allow);
+
+    if (request.method() == QHttpServerRequest::Method::Options) {
+        qCDebug(lcRouter) << "Answering OPTIONS for" << request.url().path() << "with" << allow;
+        responder.write(headers, QHttpServerResponder::StatusCode::Ok);
+    } else {
+        qCDebug(lcRouter) << "Method not allowed for" << request.url().path() << ", allowed:"
+                          << allow;
+        responder.write(headers, QHttpServerResponder::StatusCode::MethodNotAllowed);
     }
-    return true;
 }
 
 QT_END_NAMESPACE
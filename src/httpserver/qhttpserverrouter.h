@@ -5,6 +5,7 @@
 #define QHTTPSERVERROUTER_H
 
 #include <QtHttpServer/qthttpserverglobal.h>
+#include <QtHttpServer/qhttpserverroutestatistics.h>
 #include <QtHttpServer/qhttpserverrouterviewtraits.h>
 
 #include <QtCore/qscopedpointer.h>
@@ -13,6 +14,7 @@
 #include <functional>
 #include <initializer_list>
 #include <memory>
+#include <typeinfo>
 
 QT_BEGIN_NAMESPACE
 
@@ -27,6 +29,8 @@ class QHttpServerRouter
     Q_DECLARE_PRIVATE(QHttpServerRouter)
     Q_DISABLE_COPY_MOVE(QHttpServerRouter)
 
+    friend class QHttpServerPrivate;
+
 public:
     Q_HTTPSERVER_EXPORT QHttpServerRouter(QAbstractHttpServer *server);
     Q_HTTPSERVER_EXPORT ~QHttpServerRouter();
@@ -53,27 +57,44 @@ public:
     Q_HTTPSERVER_EXPORT const QHash<QMetaType, QString> &converters() const &;
     Q_HTTPSERVER_EXPORT QHash<QMetaType, QString> converters() &&;
 
-    template<typename ViewHandler, typename ViewTraits = QHttpServerRouterViewTraits<ViewHandler>>
-    QHttpServerRouterRule *addRule(std::unique_ptr<QHttpServerRouterRule> rule)
+    template<typename ViewHandler, typename ViewTraits = QHttpServerRouterViewTraits<ViewHandler>,
+             typename Rule = QHttpServerRouterRule>
+    QHttpServerRouterRule *addRule(std::unique_ptr<Rule> rule)
     {
-        return addRuleHelper<ViewTraits>(
-                std::move(rule),
-                typename ViewTraits::Arguments::Indexes{});
+        static_assert(std::is_base_of_v<QHttpServerRouterRule, Rule>,
+                      "Rule must be derived from QHttpServerRouterRule");
+        // The rule may be of a class derived from Rule, which overrides matches().
+        const bool matchesByPath = QHttpServerRouterRule::InheritsMatches<Rule>::value
+                && typeid(*rule) == typeid(Rule);
+        return addRuleHelper<ViewTraits>(std::move(rule), matchesByPath,
+                                         typename ViewTraits::Arguments::Indexes{});
     }
 
     Q_HTTPSERVER_EXPORT bool handleRequest(const QHttpServerRequest &request,
                                            QHttpServerResponder &responder) const;
 
+    Q_HTTPSERVER_EXPORT void setRouteCacheSize(qsizetype size);
+    Q_HTTPSERVER_EXPORT qsizetype routeCacheSize() const;
+
+    Q_HTTPSERVER_EXPORT void setStatisticsEnabled(bool enabled);
+    Q_HTTPSERVER_EXPORT bool isStatisticsEnabled() const;
+    Q_HTTPSERVER_EXPORT QHttpServerRouteStatistics statistics() const;
+    Q_HTTPSERVER_EXPORT void resetStatistics();
+
 private:
     template<typename ViewTraits, size_t ... Idx>
     QHttpServerRouterRule *addRuleHelper(std::unique_ptr<QHttpServerRouterRule> rule,
-                       std::index_sequence<Idx...>)
+                                         bool matchesByPath, std::index_sequence<Idx...>)
     {
-        return addRuleImpl(std::move(rule), {ViewTraits::Arguments::template metaType<Idx>()...});
+        return addRuleImpl(std::move(rule), {ViewTraits::Arguments::template metaType<Idx>()...},
+                           matchesByPath);
     }
 
     Q_HTTPSERVER_EXPORT QHttpServerRouterRule *addRuleImpl(std::unique_ptr<QHttpServerRouterRule> rule,
                                          std::initializer_list<QMetaType> metaTypes);
+    Q_HTTPSERVER_EXPORT QHttpServerRouterRule *addRuleImpl(std::unique_ptr<QHttpServerRouterRule> rule,
+                                         std::initializer_list<QMetaType> metaTypes,
+                                         bool matchesByPath);
 
     std::unique_ptr<QHttpServerRouterPrivate> d_ptr;
 };
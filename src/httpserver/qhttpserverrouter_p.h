@@ -7,10 +7,23 @@
 #include <QtHttpServer/qhttpserverrouter.h>
 #include <QtHttpServer/qhttpserverrouterrule.h>
 
+#include <private/qhttpserverrouterrule_p.h>
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qcache.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qregularexpression.h>
+#include <QtCore/qspan.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qvarlengtharray.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <vector>
 
 //
@@ -25,16 +38,202 @@
 
 QT_BEGIN_NAMESPACE
 
+// The rules of a QHttpServerRouter and the indexes built over them. Once
+// published by the router, a table is only read; changes are made to a copy
+// that replaces it. Request dispatch holds a reference to the table it
+// started with, so it is not affected by rules being added concurrently.
+class QHttpServerRouteTable
+{
+public:
+    using RuleIndexes = QVarLengthArray<qsizetype, 16>;
+
+    struct Route
+    {
+        std::shared_ptr<QHttpServerRouterRule> rule;
+        QHttpServerRouterRulePrivate *d;
+    };
+
+    // An indexed rule together with the methods it accepts, so that rules
+    // for other methods are skipped without being looked at.
+    struct IndexedRule
+    {
+        qsizetype index;
+        QHttpServerRequest::Methods methods;
+    };
+    using IndexedRules = std::vector<IndexedRule>;
+
+    // A node of the path segment tree. Rules whose pattern ends at this node
+    // are listed in registration order.
+    struct SegmentNode
+    {
+        std::vector<std::pair<QString, qsizetype>> literalChildren; // sorted by segment
+        std::vector<std::pair<QHttpServerRouterRulePrivate::CaptureKind, qsizetype>>
+                captureChildren;
+        IndexedRules rules;
+    };
+
+    // One alternation of the patterns of several rules, each wrapped in a
+    // capture group that tells which rule matched.
+    struct CombinedMatcher
+    {
+        QRegularExpression regexp;
+        std::vector<std::pair<qsizetype, int>> alternatives; // rule index, capture group
+    };
+    using CombinedMatchers = std::vector<CombinedMatcher>;
+
+    struct RouteCacheKey
+    {
+        QString path;
+        QHttpServerRequest::Method method;
+
+        friend bool operator==(const RouteCacheKey &lhs, const RouteCacheKey &rhs) noexcept
+        {
+            return lhs.method == rhs.method && lhs.path == rhs.path;
+        }
+        friend size_t qHash(const RouteCacheKey &key, size_t seed = 0) noexcept
+        {
+            return qHashMulti(seed, key.path, int(key.method));
+        }
+    };
+
+    struct CachedRoute
+    {
+        qsizetype ruleIndex;
+        QRegularExpressionMatch match;
+    };
+
+    QHttpServerRouteTable();
+    QHttpServerRouteTable(const QHttpServerRouteTable &other);
+    QHttpServerRouteTable &operator=(const QHttpServerRouteTable &) = delete;
+    ~QHttpServerRouteTable();
+
+    std::vector<Route> routes;
+
+    QHash<QString, IndexedRules> staticRules;
+    std::vector<SegmentNode> segmentTree;
+    IndexedRules regexpRules;
+    std::vector<qsizetype> unindexedRules;
+    qsizetype firstDerivedRule = std::numeric_limits<qsizetype>::max();
+
+    void addRoute(std::unique_ptr<QHttpServerRouterRule> rule, QHttpServerRouterRulePrivate *d,
+                  bool isPlain);
+    void setRouteCacheSize(qsizetype size);
+    qsizetype routeCacheSize() const { return routeCacheCapacity; }
+
+    void candidateRules(const QString &path, QHttpServerRequest::Method method,
+                        RuleIndexes *candidates) const;
+    qsizetype lowestRegexpRule(QHttpServerRequest::Method method) const;
+    qsizetype firstRegexpRule(const QString &path, QHttpServerRequest::Method method) const;
+    void appendRegexpRules(QHttpServerRequest::Method method, qsizetype after,
+                           RuleIndexes *candidates) const;
+
+    std::optional<CachedRoute> cachedRoute(const RouteCacheKey &key) const;
+    void cacheRoute(const RouteCacheKey &key, const CachedRoute &route) const;
+    void uncacheRoute(const RouteCacheKey &key) const;
+    bool isRouteCached(const RouteCacheKey &key) const;
+    quint64 routeCacheHits() const;
+
+private:
+    void indexRule(const IndexedRule &rule,
+                   const QList<QHttpServerRouterRulePrivate::PathSegment> &segments);
+    void collectRules(qsizetype node, QSpan<const QStringView> segments,
+                      QHttpServerRequest::Methods methods, RuleIndexes *candidates) const;
+    const CombinedMatchers &combinedMatchersFor(QHttpServerRequest::Method method) const;
+    void clearCombinedMatchers();
+
+    // A part of the route cache, with its own lock. Looking a route up
+    // reorders the LRU list, so even hits need exclusive access; requests
+    // handled in several threads at once mostly take different locks.
+    struct RouteCacheShard
+    {
+        QMutex mutex;
+        QCache<RouteCacheKey, CachedRoute> cache{0};
+    };
+    static constexpr qsizetype MaxRouteCacheShards = 16;
+    // Caches smaller than this many routes per shard are not split, so that
+    // they evict exactly the least recently used route.
+    static constexpr qsizetype MinRoutesPerShard = 16;
+
+    RouteCacheShard &routeCacheShard(const RouteCacheKey &key) const;
+    void clearRouteCache();
+
+    // Set before the table is published, then only read.
+    qsizetype routeCacheCapacity = 0;
+
+    // Built on first use, from several threads once published. lazyMutex
+    // serializes building the matchers, which are then read without it.
+    mutable QMutex lazyMutex;
+    mutable std::array<QAtomicPointer<const CombinedMatchers>, 9> combinedMatchers;
+
+    // Resolved routes, only for rules added before the first rule overriding
+    // matches(), as such a rule may decide on more than the method and path.
+    // Spread by the hash of the key over routeCacheShardCount shards.
+    qsizetype routeCacheShardCount = 1;
+    mutable std::array<RouteCacheShard, MaxRouteCacheShards> routeCacheShards;
+    mutable QAtomicInteger<quint64> routeCacheHitCount;
+};
+
 class QHttpServerRouterPrivate
 {
 public:
     QHttpServerRouterPrivate(QAbstractHttpServer *server);
 
+    static const QHttpServerRouterPrivate *get(const QHttpServerRouter *router)
+    {
+        return router->d_func();
+    }
+
     QHash<QMetaType, QString> converters;
-    std::vector<std::unique_ptr<QHttpServerRouterRule>> rules;
     QAbstractHttpServer *server;
 
-    bool verifyThreadAffinity(const QObject *contextObject) const;
+    std::shared_ptr<const QHttpServerRouteTable> table() const;
+    QHttpServerRouteTable &editableTable();
+    std::shared_ptr<const QHttpServerRouteTable> latestTable() const;
+    mutable QMutex tableMutex;
+
+    // Guarded by tableMutex.
+    bool statisticsEnabled = false;
+
+    qsizetype matchRoute(const QHttpServerRouteTable &table, const QHttpServerRequest &request,
+                         QRegularExpressionMatch *match) const;
+    bool streamsRequestBody(const QHttpServerRequest &request) const;
+
+    void callHandler(const QHttpServerRouteTable::Route &route,
+                     const QRegularExpressionMatch &match, const QHttpServerRequest &request,
+                     QHttpServerResponder &responder) const;
+    void admitHandler(const QHttpServerRouteTable::Route &route,
+                      const QRegularExpressionMatch &match, const QHttpServerRequest &request,
+                      QHttpServerResponder &responder) const;
+    void dispatchHandler(const QHttpServerRouteTable::Route &route,
+                         const QRegularExpressionMatch &match, const QHttpServerRequest &request,
+                         QHttpServerResponder &responder) const;
+    void rejectRequest(const QHttpServerRequest &request, QHttpServerResponder &responder,
+                       std::chrono::milliseconds admissionTimeout) const;
+
+    Q_AUTOTEST_EXPORT bool isRouteCached(const QString &path,
+                                         QHttpServerRequest::Method method) const;
+    Q_AUTOTEST_EXPORT quint64 routeCacheHits() const;
+
+    QHttpServerRequest::Methods allowedMethods(const QHttpServerRouteTable &table,
+                                               const QString &path) const;
+    void writeAllowedMethods(const QHttpServerRequest &request, QHttpServerResponder &responder,
+                             QHttpServerRequest::Methods methods) const;
+
+private:
+    bool isDispatchable(const QHttpServerRouteTable &table, qsizetype index) const;
+
+    std::shared_ptr<const QHttpServerRouteTable> loadTable() const;
+    void storeTable(std::shared_ptr<const QHttpServerRouteTable> table) const;
+
+    // The table request dispatch uses, replaced atomically.
+#if defined(__cpp_lib_atomic_shared_ptr)
+    mutable std::atomic<std::shared_ptr<const QHttpServerRouteTable>> publishedTable;
+#else
+    mutable std::shared_ptr<const QHttpServerRouteTable> publishedTable;
+#endif
+    // Changes not yet published, guarded by tableMutex.
+    mutable std::shared_ptr<QHttpServerRouteTable> pendingTable;
+    mutable QAtomicInteger<bool> hasPendingTable = false;
 };
 
 QT_END_NAMESPACE
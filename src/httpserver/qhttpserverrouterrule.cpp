@@ -6,17 +6,157 @@
 
 #include <private/qhttpserverrouterrule_p.h>
 #include <private/qhttpserverrequest_p.h>
+#include <private/qhttpserverresponder_p.h>
 
 #include <QtCore/qmetaobject.h>
 #include <QtCore/qloggingcategory.h>
 #include <QtCore/qregularexpression.h>
 #include <QtCore/qstringbuilder.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qvarlengtharray.h>
+#include <QtCore/qspan.h>
+
+#include <algorithm>
+#include <utility>
 
 QT_BEGIN_NAMESPACE
 
 Q_STATIC_LOGGING_CATEGORY(lcRouterRule, "qt.httpserver.router.rule")
 
+/*!
+    \internal
+
+    Stands in for a capture in the pattern passed to splitPathSegments().
+*/
+static constexpr QChar captureMarker = u'\0';
+
+using CaptureKind = QHttpServerRouterRulePrivate::CaptureKind;
+
+/*!
+    \internal
+
+    Returns how a capture with \a regexp is checked if it is one of the
+    converter expressions known to never match a '/', so that its capture
+    stays within one path segment. Returns CaptureKind::None otherwise.
+*/
+static CaptureKind segmentLocalCaptureKind(QStringView regexp)
+{
+    static constexpr std::pair<QLatin1StringView, CaptureKind> segmentLocalConverters[] = {
+        { QLatin1StringView("[+-]?\\d+"), CaptureKind::SignedInteger },
+        { QLatin1StringView("[+]?\\d+"), CaptureKind::UnsignedInteger },
+        { QLatin1StringView("[+-]?(?:[0-9]+(?:[.][0-9]*)?|[.][0-9]+)"), CaptureKind::Number },
+        { QLatin1StringView("[^/]+"), CaptureKind::Text },
+    };
+    for (const auto &[converter, kind] : segmentLocalConverters) {
+        if (regexp == converter)
+            return kind;
+    }
+    return CaptureKind::None;
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a text is a non-empty run of digits. The digits of
+    other scripts also match \c{\d}, so they are left for the regular
+    expression to check.
+*/
+static bool isDigits(QStringView text)
+{
+    if (text.isEmpty())
+        return false;
+    for (QChar c : text) {
+        if (c.unicode() >= 0x80)
+            return true;
+        if (c < u'0' || c > u'9')
+            return false;
+    }
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a segment of a request path can be captured as
+    \a kind. The checks are those of the converter expressions, so that
+    only the regular expression of a rule that can match is evaluated.
+*/
+bool QHttpServerRouterRulePrivate::acceptsCapture(CaptureKind kind, QStringView segment)
+{
+    switch (kind) {
+    case CaptureKind::None:
+        return false;
+    case CaptureKind::SignedInteger:
+        if (segment.startsWith(u'+') || segment.startsWith(u'-'))
+            segment = segment.sliced(1);
+        return isDigits(segment);
+    case CaptureKind::UnsignedInteger:
+        if (segment.startsWith(u'+'))
+            segment = segment.sliced(1);
+        return isDigits(segment);
+    case CaptureKind::Number: {
+        if (segment.startsWith(u'+') || segment.startsWith(u'-'))
+            segment = segment.sliced(1);
+        const qsizetype dot = segment.indexOf(u'.');
+        const auto isAsciiDigits = [](QStringView text) {
+            return std::all_of(text.cbegin(), text.cend(),
+                               [](QChar c) { return c >= u'0' && c <= u'9'; });
+        };
+        if (dot == -1)
+            return !segment.isEmpty() && isAsciiDigits(segment);
+        const QStringView integral = segment.first(dot);
+        const QStringView fraction = segment.sliced(dot + 1);
+        return isAsciiDigits(integral) && isAsciiDigits(fraction)
+                && (!integral.isEmpty() || !fraction.isEmpty());
+    }
+    case CaptureKind::Text:
+        return !segment.isEmpty();
+    case CaptureKind::Any:
+        return true;
+    }
+    Q_UNREACHABLE_RETURN(false);
+}
+
+/*!
+    \internal
+
+    Splits \a pattern, in which every capture has been replaced by
+    captureMarker, into its path segments. A segment that only consists of
+    a capture is checked as the corresponding entry of \a captureKinds.
+    Returns \c false if the pattern contains regular expression syntax, in
+    which case it can only be matched by running the rule's regular
+    expression.
+*/
+static bool splitPathSegments(QStringView pattern, QSpan<const CaptureKind> captureKinds,
+                              QList<QHttpServerRouterRulePrivate::PathSegment> *segments)
+{
+    if (pattern.startsWith(u'^'))
+        pattern = pattern.sliced(1);
+    if (pattern.endsWith(u'$'))
+        pattern.chop(1);
+
+    const QLatin1StringView metaCharacters("\\^$.|?*+()[]{}");
+    for (QChar c : pattern) {
+        if (metaCharacters.contains(c))
+            return false;
+    }
+
+    segments->clear();
+    qsizetype capture = 0;
+    for (QStringView part : pattern.tokenize(u'/')) {
+        const qsizetype captures = part.count(captureMarker);
+        if (captures == 0) {
+            segments->append({ part.toString(), CaptureKind::None });
+        } else if (part.size() == 1) {
+            segments->append({ QString(), captureKinds[capture] });
+        } else {
+            segments->append({ QString(), CaptureKind::Any });
+        }
+        capture += captures;
+    }
+    return true;
+}
+
 /*!
     \class QHttpServerRouterRule
     \since 6.4
@@ -241,12 +381,148 @@ bool QHttpServerRouterRule::exec(const QHttpServerRequest &request,
     if (!matches(request, &match))
         return false;
 
-    void *args[] = { nullptr, &match, const_cast<QHttpServerRequest *>(&request), &responder };
-    Q_ASSERT(d->routerHandler);
-    d->routerHandler->call(nullptr, args);
+    d->callHandler(match, request, responder);
     return true;
 }
 
+/*!
+    Returns the request counts and handler times collected for this rule
+    while statistics were enabled on the router it was added to.
+
+    \since 6.9
+    \sa QHttpServerRouter::setStatisticsEnabled()
+*/
+QHttpServerRouteStatistics QHttpServerRouterRule::statistics() const
+{
+    Q_D(const QHttpServerRouterRule);
+    QHttpServerRouteStatistics statistics;
+    if (const auto *counters = d->counters.load(std::memory_order_acquire))
+        counters->addTo(&statistics);
+    return statistics;
+}
+
+/*!
+    Sets \a maxRequests as the maximum number of requests this rule handles
+    at the same time. A value of \c 0, the default, disables the limit.
+
+    A request counts from the moment the handler of the rule is called until
+    its QHttpServerResponder is destroyed. Requests beyond the limit are
+    handled like those beyond QHttpServerConfiguration::maxConcurrentRequests():
+    they wait for up to QHttpServerConfiguration::admissionTimeout(), and are
+    answered with \l{QHttpServerResponder::StatusCode}{ServiceUnavailable}
+    if no other request finishes in time. The limit adapts to the latency of
+    the requests when
+    QHttpServerConfiguration::isAdaptiveConcurrencyEnabled() is \c true.
+
+    \since 6.9
+    \sa maxConcurrentRequests()
+*/
+void QHttpServerRouterRule::setMaxConcurrentRequests(quint32 maxRequests)
+{
+    Q_D(QHttpServerRouterRule);
+    d->limiter->setMaxConcurrency(maxRequests);
+}
+
+/*!
+    Returns the maximum number of requests this rule handles at the same
+    time, or \c 0 if there is no limit.
+
+    \since 6.9
+    \sa setMaxConcurrentRequests()
+*/
+quint32 QHttpServerRouterRule::maxConcurrentRequests() const
+{
+    Q_D(const QHttpServerRouterRule);
+    return d->limiter->maxConcurrency();
+}
+
+/*!
+    Enables passing the body of a request to the handler of this rule while
+    it is still being received, if \a enabled is \c true. This keeps the
+    memory used by large uploads bounded. The default is \c false.
+
+    The handler is then called as soon as the headers of an HTTP/2 request
+    are received, and reads the body from QHttpServerRequest::bodyDevice().
+    This is only done when the context object of the rule lives in the
+    thread of the connection. Other requests are passed to the handler once
+    their whole body is received, as it is by default.
+
+    \note HTTP/1 requests are always passed to the handler with their whole
+    body.
+
+    \since 6.9
+    \sa isBodyStreamingEnabled(), QHttpServerRequest::bodyDevice()
+*/
+void QHttpServerRouterRule::setBodyStreamingEnabled(bool enabled)
+{
+    Q_D(QHttpServerRouterRule);
+    if (d->streamsBody.exchange(enabled, std::memory_order_relaxed) == enabled)
+        return;
+
+    if (enabled)
+        QHttpServerRouterRulePrivate::bodyStreamingRuleCount.ref();
+    else
+        QHttpServerRouterRulePrivate::bodyStreamingRuleCount.deref();
+}
+
+/*!
+    Returns \c true if the body of a request is passed to the handler of
+    this rule while it is still being received.
+
+    \since 6.9
+    \sa setBodyStreamingEnabled()
+*/
+bool QHttpServerRouterRule::isBodyStreamingEnabled() const
+{
+    Q_D(const QHttpServerRouterRule);
+    return d->streamsBody.load(std::memory_order_relaxed);
+}
+
+QBasicAtomicInt QHttpServerRouterRulePrivate::bodyStreamingRuleCount =
+        Q_BASIC_ATOMIC_INITIALIZER(0);
+
+QHttpServerRouterRulePrivate::~QHttpServerRouterRulePrivate()
+{
+    delete counters.load(std::memory_order_relaxed);
+    if (streamsBody.load(std::memory_order_relaxed))
+        bodyStreamingRuleCount.deref();
+}
+
+/*!
+    \internal
+
+    Starts or stops collecting statistics for the rule, as requested by
+    \a enabled. Only called by the router, with its table mutex held.
+*/
+void QHttpServerRouterRulePrivate::setStatisticsEnabled(bool enabled)
+{
+    if (enabled && !counters.load(std::memory_order_relaxed))
+        counters.store(new QHttpServerRouteCounters, std::memory_order_release);
+    collectStatistics.store(enabled, std::memory_order_release);
+}
+
+void QHttpServerRouterRulePrivate::callHandler(const QRegularExpressionMatch &match,
+                                               const QHttpServerRequest &request,
+                                               QHttpServerResponder &responder) const
+{
+    void *args[] = { nullptr, const_cast<QRegularExpressionMatch *>(&match),
+                     const_cast<QHttpServerRequest *>(&request), &responder };
+    Q_ASSERT(routerHandler);
+    if (!collectStatistics.load(std::memory_order_acquire)) {
+        routerHandler->call(nullptr, args);
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    routerHandler->call(nullptr, args);
+    const auto handlerTime = std::chrono::steady_clock::now() - start;
+
+    // A handler that moves the responder away responds later, unseen here.
+    const QHttpServerResponderPrivate *responderD = responder.d_ptr;
+    counters.load(std::memory_order_acquire)
+            ->record(handlerTime, responderD ? responderD->statusCode : 0);
+}
+
 /*!
     Determines whether a given \a request matches this rule.
 
@@ -267,6 +543,19 @@ bool QHttpServerRouterRule::matches(const QHttpServerRequest &request,
     return (match->hasMatch() && d->pathRegexp.captureCount() == match->lastCapturedIndex());
 }
 
+/*!
+    \internal
+
+    Sets the indexes of the \c <arg> placeholders in the path pattern to
+    \a offsets, as found at compile time, so that createPathRegexp() does not
+    search the pattern for them.
+*/
+void QHttpServerRouterRule::setPlaceholderOffsets(QSpan<const qsizetype> offsets)
+{
+    Q_D(QHttpServerRouterRule);
+    d->placeholderOffsets.emplace(offsets.begin(), offsets.end());
+}
+
 /*!
     \internal
 */
@@ -275,8 +564,33 @@ bool QHttpServerRouterRule::createPathRegexp(std::initializer_list<QMetaType> me
 {
     Q_D(QHttpServerRouterRule);
 
-    QString pathRegexp = d->pathPattern;
+    // Find the placeholders once, unless that was done at compile time, then
+    // build the expression and the shape of the path from the literal parts
+    // between them in a single pass.
     const QLatin1StringView arg("<arg>");
+    const QStringView pattern = d->pathPattern;
+    QVarLengthArray<qsizetype, 8> placeholders;
+    if (d->placeholderOffsets) {
+        placeholders = *d->placeholderOffsets;
+        for (qsizetype index : std::as_const(placeholders))
+            Q_ASSERT(pattern.sliced(index).startsWith(arg));
+    } else {
+        for (qsizetype index = pattern.indexOf(arg); index != -1;
+             index = pattern.indexOf(arg, index + arg.size())) {
+            placeholders.append(index);
+        }
+    }
+
+    QString pathRegexp;
+    QString pathShape;
+    QString appendedRegexp;
+    QString appendedShape;
+    pathRegexp.reserve(pattern.size() + 16 * qsizetype(metaTypes.size()));
+    pathShape.reserve(pattern.size());
+    qsizetype usedPlaceholders = 0;
+    qsizetype copied = 0;
+    bool capturesAreSegmentLocal = true;
+    QVarLengthArray<CaptureKind, 8> captureKinds;
     for (auto metaType : metaTypes) {
         if (metaType.id() >= QMetaType::User
             && !QMetaType::hasRegisteredConverterFunction(QMetaType::fromType<QString>(), metaType)) {
@@ -296,22 +610,32 @@ bool QHttpServerRouterRule::createPathRegexp(std::initializer_list<QMetaType> me
         if (it->isEmpty())
             continue;
 
-        const auto index = pathRegexp.indexOf(arg);
-        const QString &regexp = QLatin1Char('(') % *it % QLatin1Char(')');
-        if (index == -1)
-            pathRegexp.append(regexp);
-        else
-            pathRegexp.replace(index, arg.size(), regexp);
+        // Types beyond the placeholders capture at the end of the path.
+        if (usedPlaceholders == placeholders.size()) {
+            appendedRegexp += QLatin1Char('(') % *it % QLatin1Char(')');
+            appendedShape += captureMarker;
+        } else {
+            const qsizetype index = placeholders[usedPlaceholders++];
+            const QStringView literal = pattern.sliced(copied, index - copied);
+            pathRegexp += literal % QLatin1Char('(') % *it % QLatin1Char(')');
+            pathShape += literal % captureMarker;
+            copied = index + arg.size();
+        }
+        const CaptureKind kind = segmentLocalCaptureKind(*it);
+        capturesAreSegmentLocal = capturesAreSegmentLocal && kind != CaptureKind::None;
+        captureKinds.append(kind);
     }
 
-    if (pathRegexp.indexOf(arg) != -1) {
-        qCWarning(lcRouterRule) << "not enough types or one of the types is not supported, regexp:"
-                                << pathRegexp
+    if (usedPlaceholders != placeholders.size()) {
+        qCWarning(lcRouterRule) << "not enough types or one of the types is not supported"
                                 << ", pattern:" << d->pathPattern
                                 << ", types:" << metaTypes;
         return false;
     }
 
+    pathRegexp += pattern.sliced(copied) % appendedRegexp;
+    pathShape += pattern.sliced(copied) % appendedShape;
+
     if (!pathRegexp.startsWith(QLatin1Char('^')))
         pathRegexp = QLatin1Char('^') % pathRegexp;
     if (!pathRegexp.endsWith(QLatin1Char('$')))
@@ -321,6 +645,11 @@ bool QHttpServerRouterRule::createPathRegexp(std::initializer_list<QMetaType> me
 
     d->pathRegexp.setPattern(pathRegexp);
     d->pathRegexp.optimize();
+
+    d->isSegmentIndexable = capturesAreSegmentLocal
+            && splitPathSegments(pathShape, captureKinds, &d->pathSegments);
+    if (!d->isSegmentIndexable)
+        d->pathSegments.clear();
     return true;
 }
 
@@ -6,13 +6,19 @@
 
 #include <QtHttpServer/qhttpserverrequest.h>
 #include <QtHttpServer/qhttpserverresponder.h>
+#include <QtHttpServer/qhttpserverroutestatistics.h>
 #include <QtHttpServer/qhttpserverrouterviewtraits.h>
 
 #include <QtCore/qcontainerfwd.h>
 #include <QtCore/qregularexpression.h>
+#include <QtCore/qspan.h>
+#include <QtCore/quuid.h>
+#include <QtCore/qvariant.h>
 
+#include <charconv>
 #include <initializer_list>
 #include <memory>
+#include <type_traits>
 
 QT_BEGIN_NAMESPACE
 
@@ -97,6 +103,14 @@ public:
 
     const QObject *contextObject() const;
 
+    QHttpServerRouteStatistics statistics() const;
+
+    void setMaxConcurrentRequests(quint32 maxRequests);
+    quint32 maxConcurrentRequests() const;
+
+    void setBodyStreamingEnabled(bool enabled);
+    bool isBodyStreamingEnabled() const;
+
     virtual ~QHttpServerRouterRule();
 
 protected:
@@ -135,20 +149,82 @@ protected:
         if constexpr (std::is_member_function_pointer_v<ViewHandler>) {
             return bind_front(
                 handler, const_cast<typename QtPrivate::ContextTypeForFunctor<ViewHandler>::ContextType*>(context),
-                QVariant(match.captured(Cx + 1))
-                        .value<typename ViewTraits::Arguments::template Arg<Cx>::CleanType>()...);
+                convertCaptured<typename ViewTraits::Arguments::template Arg<Cx>::CleanType>(
+                        match, int(Cx + 1))...);
         } else {
             Q_UNUSED(context);
             return bind_front(
                     handler,
-                    QVariant(match.captured(Cx + 1))
-                            .value<typename ViewTraits::Arguments::template Arg<Cx>::CleanType>()...);
+                    convertCaptured<typename ViewTraits::Arguments::template Arg<Cx>::CleanType>(
+                            match, int(Cx + 1))...);
+        }
+    }
+
+    template<typename T>
+    static constexpr bool isCapturedInteger =
+            std::is_same_v<T, short> || std::is_same_v<T, unsigned short>
+            || std::is_same_v<T, int> || std::is_same_v<T, unsigned int>
+            || std::is_same_v<T, long> || std::is_same_v<T, unsigned long>
+            || std::is_same_v<T, long long> || std::is_same_v<T, unsigned long long>;
+
+    // Converts the capture at index to T. The types with a default converter
+    // are parsed from the matched text directly; other types go through
+    // their registered QString converter.
+    template<typename T>
+    static T convertCaptured(const QRegularExpressionMatch &match, int index)
+    {
+        if constexpr (std::is_same_v<T, QString>) {
+            return match.captured(index);
+        } else if constexpr (std::is_same_v<T, QByteArray>) {
+            return match.capturedView(index).toUtf8();
+        } else if constexpr (std::is_same_v<T, QUuid>) {
+            return QUuid::fromString(match.capturedView(index));
+        } else if constexpr (std::is_same_v<T, float>) {
+            return match.capturedView(index).toFloat();
+        } else if constexpr (std::is_same_v<T, double>) {
+            return match.capturedView(index).toDouble();
+        } else if constexpr (isCapturedInteger<T>) {
+            const QStringView text = match.capturedView(index);
+            char digits[32];
+            if (text.size() <= qsizetype(sizeof(digits))) {
+                qsizetype size = 0;
+                for (QChar c : text) {
+                    if (c.unicode() > 0x7f)
+                        break;
+                    digits[size++] = char(c.unicode());
+                }
+                if (size == text.size()) {
+                    const char *begin = digits;
+                    const char *end = digits + size;
+                    if (begin != end && *begin == '+')
+                        ++begin;
+                    T value = 0;
+                    const auto result = std::from_chars(begin, end, value);
+                    if (result.ec != std::errc() || result.ptr != end)
+                        return T(0);
+                    return value;
+                }
+            }
+            return QVariant(text.toString()).value<T>();
+        } else {
+            return QVariant(match.captured(index)).value<T>();
         }
     }
 
 private:
+    // Tells whether Rule keeps the matches() of this class, which only looks
+    // at the method and path of a request, so that the router can index it.
+    template <typename Rule, typename = void>
+    struct InheritsMatches : std::false_type {};
+    template <typename Rule>
+    struct InheritsMatches<Rule, std::void_t<decltype(&Rule::matches)>>
+        : std::is_same<decltype(&Rule::matches), decltype(&QHttpServerRouterRule::matches)> {};
+
+    void setPlaceholderOffsets(QSpan<const qsizetype> offsets);
+
     std::unique_ptr<QHttpServerRouterRulePrivate> d_ptr;
 
+    friend class QHttpServer;
     friend class QHttpServerRouter;
 };
 
@@ -6,9 +6,19 @@
 
 #include <QtHttpServer/qhttpserverrouterrule.h>
 
+#include <private/qhttpserverconcurrencylimiter_p.h>
+#include <private/qhttpserverroutestatistics_p.h>
+
+#include <QtCore/qatomic.h>
 #include <QtCore/qregularexpression.h>
 #include <QtCore/qstring.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qvarlengtharray.h>
+
+#include <atomic>
+#include <memory>
+#include <optional>
 
 //
 //  W A R N I N G
@@ -25,12 +35,74 @@ QT_BEGIN_NAMESPACE
 class QHttpServerRouterRulePrivate
 {
 public:
+    // How a path segment holding a capture is checked before the regular
+    // expression of the rule is evaluated, following the converter of the
+    // captured type. Custom converters are only checked by the expression.
+    enum class CaptureKind : quint8 {
+        None, // A literal segment
+        SignedInteger,
+        UnsignedInteger,
+        Number,
+        Text,
+        Any, // A segment mixing captures and literal text
+    };
+
+    struct PathSegment
+    {
+        QString literal;
+        CaptureKind capture = CaptureKind::None;
+
+        bool isCapture() const { return capture != CaptureKind::None; }
+    };
+
+    static bool acceptsCapture(CaptureKind kind, QStringView segment);
+
     QString pathPattern;
     QHttpServerRequest::Methods methods;
     QtPrivate::SlotObjUniquePtr routerHandler;
     QPointer<const QObject> context;
 
+    // The indexes of the <arg> placeholders in pathPattern, when they were
+    // found at compile time by QHttpServer::route().
+    std::optional<QVarLengthArray<qsizetype, 8>> placeholderOffsets;
+
     QRegularExpression pathRegexp;
+
+    // The path split at '/', set by createPathRegexp() when the pattern has
+    // no regular expression syntax and every capture stays within a segment.
+    // QHttpServerRouter uses it to index the rule.
+    QList<PathSegment> pathSegments;
+    bool isSegmentIndexable = false;
+
+    // Set by the router for rules whose class does not override matches(),
+    // which then only depends on the request method and path.
+    bool isPlain = false;
+
+    // For a rule without captures, the match of its one path, which the
+    // router passes to the handler instead of matching every request.
+    QRegularExpressionMatch staticMatch;
+
+    // Created by the router when statistics are first enabled for the rule,
+    // and kept until the rule is destroyed.
+    std::atomic<QHttpServerRouteCounters *> counters = nullptr;
+    std::atomic<bool> collectStatistics = false;
+
+    // Bounds the requests in flight for this rule, as set by
+    // QHttpServerRouterRule::setMaxConcurrentRequests().
+    const std::shared_ptr<QHttpServerConcurrencyLimiter> limiter =
+            std::make_shared<QHttpServerConcurrencyLimiter>();
+
+    // Set by QHttpServerRouterRule::setBodyStreamingEnabled(). The number of
+    // rules it is set for, in any router, lets protocol handlers skip looking
+    // up the rule of a request before its body is received when there are none.
+    std::atomic<bool> streamsBody = false;
+    static QBasicAtomicInt bodyStreamingRuleCount;
+
+    ~QHttpServerRouterRulePrivate();
+
+    void setStatisticsEnabled(bool enabled);
+    void callHandler(const QRegularExpressionMatch &match, const QHttpServerRequest &request,
+                     QHttpServerResponder &responder) const;
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,240 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtHttpServer/qhttpserverroutestatistics.h>
+
+#include <private/qhttpserverroutestatistics_p.h>
+
+#include <QtCore/qalgorithms.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QHttpServerRouteStatistics
+    \since 6.9
+    \inmodule QtHttpServer
+    \brief The QHttpServerRouteStatistics class holds the request counts and
+    handler times of routes.
+
+    QHttpServerRouteStatistics is a snapshot of the statistics a
+    QHttpServerRouter collects for its rules while
+    QHttpServerRouter::isStatisticsEnabled() is \c true. It is returned by
+    QHttpServerRouterRule::statistics() for a single rule, and by
+    QHttpServerRouter::statistics() for all rules of a router.
+
+    The time a handler takes is measured from the moment it is called until
+    it returns. It is counted in one of the LatencyBucketCount buckets of a
+    histogram, whose limits are given by latencyBucketLimit(). Responses are
+    counted by the class of their status code. A response that is written
+    after the handler returned, through a QHttpServerResponder the handler
+    moved elsewhere, is not counted.
+
+    \sa QHttpServerRouter::setStatisticsEnabled()
+*/
+
+/*!
+    \enum QHttpServerRouteStatistics::StatusClass
+
+    This enum type describes the class of an HTTP status code.
+
+    \value Informational    Status codes 100 to 199.
+    \value Successful       Status codes 200 to 299.
+    \value Redirection      Status codes 300 to 399.
+    \value ClientError      Status codes 400 to 499.
+    \value ServerError      Status codes 500 to 599.
+*/
+
+/*!
+    \variable QHttpServerRouteStatistics::LatencyBucketCount
+
+    The number of buckets of the handler time histogram.
+
+    \sa latencyCount(), latencyBucketLimit()
+*/
+
+QT_DEFINE_QESDP_SPECIALIZATION_DTOR(QHttpServerRouteStatisticsPrivate)
+
+/*!
+    Default constructs a QHttpServerRouteStatistics object.
+
+    All counts of such an object are \c 0.
+*/
+QHttpServerRouteStatistics::QHttpServerRouteStatistics()
+    : d(new QHttpServerRouteStatisticsPrivate)
+{
+}
+
+/*!
+    Copy-constructs this QHttpServerRouteStatistics from \a other.
+*/
+QHttpServerRouteStatistics::QHttpServerRouteStatistics(const QHttpServerRouteStatistics &other)
+    = default;
+
+/*!
+    \fn QHttpServerRouteStatistics::QHttpServerRouteStatistics(QHttpServerRouteStatistics &&other) noexcept
+
+    Move-constructs this QHttpServerRouteStatistics from \a other.
+*/
+
+/*!
+    Copy-assigns \a other to this QHttpServerRouteStatistics.
+*/
+QHttpServerRouteStatistics &
+QHttpServerRouteStatistics::operator=(const QHttpServerRouteStatistics &other) = default;
+
+/*!
+    \fn QHttpServerRouteStatistics &QHttpServerRouteStatistics::operator=(QHttpServerRouteStatistics &&other) noexcept
+
+    Move-assigns \a other to this QHttpServerRouteStatistics.
+*/
+
+/*!
+    Destructor.
+*/
+QHttpServerRouteStatistics::~QHttpServerRouteStatistics()
+    = default;
+
+/*!
+    \fn void QHttpServerRouteStatistics::swap(QHttpServerRouteStatistics &other) noexcept
+
+    Swaps these statistics with the \a other statistics.
+*/
+
+/*!
+    Returns the number of requests that were passed to the handler.
+*/
+quint64 QHttpServerRouteStatistics::matchCount() const
+{
+    return d->matches;
+}
+
+/*!
+    Returns the number of responses with a status code of \a statusClass
+    written by the handler.
+*/
+quint64 QHttpServerRouteStatistics::responseCount(StatusClass statusClass) const
+{
+    const qsizetype index = qsizetype(statusClass) - 1;
+    if (index < 0 || index >= qsizetype(d->statusClasses.size()))
+        return 0;
+    return d->statusClasses[index];
+}
+
+/*!
+    Returns the time spent in the handler for all requests.
+
+    Divided by matchCount(), this gives the mean time a request takes.
+*/
+std::chrono::nanoseconds QHttpServerRouteStatistics::totalHandlerTime() const
+{
+    return std::chrono::nanoseconds(d->totalNanoseconds);
+}
+
+/*!
+    Returns the number of requests for which the handler took less than
+    latencyBucketLimit(\a bucket), but at least the limit of the previous
+    bucket.
+
+    \sa latencyBucketLimit()
+*/
+quint64 QHttpServerRouteStatistics::latencyCount(qsizetype bucket) const
+{
+    if (bucket < 0 || bucket >= LatencyBucketCount)
+        return 0;
+    return d->latencies[bucket];
+}
+
+/*!
+    Returns the upper limit of the handler times counted in \a bucket.
+
+    The limit of the first bucket is one microsecond, and doubles with every
+    further bucket. The last bucket has no limit.
+
+    \sa latencyCount()
+*/
+std::chrono::nanoseconds QHttpServerRouteStatistics::latencyBucketLimit(qsizetype bucket)
+{
+    using namespace std::chrono;
+    if (bucket < 0)
+        return nanoseconds::zero();
+    if (bucket >= LatencyBucketCount - 1)
+        return nanoseconds::max();
+    return microseconds(qint64(1) << bucket);
+}
+
+/*!
+    \internal
+
+    Returns the shard the calling thread writes to. Threads are assigned to
+    shards in turn when they first record a request.
+*/
+qsizetype QHttpServerRouteCounters::currentShard()
+{
+    static std::atomic<qsizetype> nextShard = 0;
+    thread_local const qsizetype shard =
+            nextShard.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+    return shard;
+}
+
+/*!
+    \internal
+
+    Counts a request whose handler took \a handlerTime and responded with
+    \a statusCode, which is \c 0 if the response is not known.
+*/
+void QHttpServerRouteCounters::record(std::chrono::nanoseconds handlerTime, int statusCode)
+{
+    Shard &shard = shards[currentShard()];
+    shard.matches.fetch_add(1, std::memory_order_relaxed);
+    const quint64 nanoseconds = quint64(qMax(handlerTime.count(), qint64(0)));
+    shard.totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    const qsizetype statusClass = statusCode / 100 - 1;
+    if (statusClass >= 0 && statusClass < qsizetype(shard.statusClasses.size()))
+        shard.statusClasses[statusClass].fetch_add(1, std::memory_order_relaxed);
+
+    const quint64 microseconds = nanoseconds / 1000;
+    const qsizetype bucket = microseconds ? qsizetype(64 - qCountLeadingZeroBits(microseconds))
+                                          : 0;
+    shard.latencies[qMin(bucket, QHttpServerRouteStatistics::LatencyBucketCount - 1)]
+            .fetch_add(1, std::memory_order_relaxed);
+}
+
+/*!
+    \internal
+
+    Adds the counts of all shards to \a statistics.
+*/
+void QHttpServerRouteCounters::addTo(QHttpServerRouteStatistics *statistics) const
+{
+    statistics->d.detach();
+    QHttpServerRouteStatisticsPrivate *d = statistics->d.data();
+    for (const Shard &shard : shards) {
+        d->matches += shard.matches.load(std::memory_order_relaxed);
+        d->totalNanoseconds += shard.totalNanoseconds.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < shard.statusClasses.size(); ++i)
+            d->statusClasses[i] += shard.statusClasses[i].load(std::memory_order_relaxed);
+        for (size_t i = 0; i < shard.latencies.size(); ++i)
+            d->latencies[i] += shard.latencies[i].load(std::memory_order_relaxed);
+    }
+}
+
+/*!
+    \internal
+
+    Sets all counts to \c 0. Requests recorded concurrently may be counted
+    partially.
+*/
+void QHttpServerRouteCounters::reset()
+{
+    for (Shard &shard : shards) {
+        shard.matches.store(0, std::memory_order_relaxed);
+        shard.totalNanoseconds.store(0, std::memory_order_relaxed);
+        for (auto &count : shard.statusClasses)
+            count.store(0, std::memory_order_relaxed);
+        for (auto &count : shard.latencies)
+            count.store(0, std::memory_order_relaxed);
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,59 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERROUTESTATISTICS_H
+#define QHTTPSERVERROUTESTATISTICS_H
+
+#include <QtHttpServer/qthttpserverglobal.h>
+
+#include <QtCore/qshareddata.h>
+
+#include <chrono>
+
+QT_BEGIN_NAMESPACE
+
+class QHttpServerRouteStatisticsPrivate;
+QT_DECLARE_QESDP_SPECIALIZATION_DTOR_WITH_EXPORT(QHttpServerRouteStatisticsPrivate,
+                                                 Q_HTTPSERVER_EXPORT)
+
+class QHttpServerRouteStatistics
+{
+public:
+    enum class StatusClass {
+        Informational = 1,
+        Successful,
+        Redirection,
+        ClientError,
+        ServerError,
+    };
+
+    static constexpr qsizetype LatencyBucketCount = 24;
+
+    Q_HTTPSERVER_EXPORT QHttpServerRouteStatistics();
+    Q_HTTPSERVER_EXPORT QHttpServerRouteStatistics(const QHttpServerRouteStatistics &other);
+    QHttpServerRouteStatistics(QHttpServerRouteStatistics &&other) noexcept = default;
+    Q_HTTPSERVER_EXPORT QHttpServerRouteStatistics &
+    operator=(const QHttpServerRouteStatistics &other);
+    QT_MOVE_ASSIGNMENT_OPERATOR_IMPL_VIA_PURE_SWAP(QHttpServerRouteStatistics)
+    Q_HTTPSERVER_EXPORT ~QHttpServerRouteStatistics();
+
+    void swap(QHttpServerRouteStatistics &other) noexcept { d.swap(other.d); }
+
+    Q_HTTPSERVER_EXPORT quint64 matchCount() const;
+    Q_HTTPSERVER_EXPORT quint64 responseCount(StatusClass statusClass) const;
+    Q_HTTPSERVER_EXPORT std::chrono::nanoseconds totalHandlerTime() const;
+    Q_HTTPSERVER_EXPORT quint64 latencyCount(qsizetype bucket) const;
+
+    Q_HTTPSERVER_EXPORT static std::chrono::nanoseconds latencyBucketLimit(qsizetype bucket);
+
+private:
+    QExplicitlySharedDataPointer<QHttpServerRouteStatisticsPrivate> d;
+
+    friend class QHttpServerRouteCounters;
+};
+
+Q_DECLARE_SHARED(QHttpServerRouteStatistics)
+
+QT_END_NAMESPACE
+
+#endif // QHTTPSERVERROUTESTATISTICS_H
@@ -0,0 +1,64 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERROUTESTATISTICS_P_H
+#define QHTTPSERVERROUTESTATISTICS_P_H
+
+#include <QtHttpServer/qhttpserverroutestatistics.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists for the convenience
+// of QHttpServer. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+
+QT_BEGIN_NAMESPACE
+
+class QHttpServerRouteStatisticsPrivate : public QSharedData
+{
+public:
+    quint64 matches = 0;
+    quint64 totalNanoseconds = 0;
+    std::array<quint64, 5> statusClasses = {};
+    std::array<quint64, QHttpServerRouteStatistics::LatencyBucketCount> latencies = {};
+};
+
+// The counters of one rule. They are spread over several shards, each
+// written by a subset of the threads, so that threads handling requests for
+// the same rule do not contend for one cache line. Reading them sums the
+// shards.
+class QHttpServerRouteCounters
+{
+public:
+    void record(std::chrono::nanoseconds handlerTime, int statusCode);
+    void addTo(QHttpServerRouteStatistics *statistics) const;
+    void reset();
+
+private:
+    static constexpr qsizetype ShardCount = 8;
+
+    struct alignas(64) Shard
+    {
+        std::atomic<quint64> matches = 0;
+        std::atomic<quint64> totalNanoseconds = 0;
+        std::array<std::atomic<quint64>, 5> statusClasses = {};
+        std::array<std::atomic<quint64>, QHttpServerRouteStatistics::LatencyBucketCount>
+                latencies = {};
+    };
+
+    static qsizetype currentShard();
+
+    std::array<Shard, ShardCount> shards;
+};
+
+QT_END_NAMESPACE
+
+#endif // QHTTPSERVERROUTESTATISTICS_P_H
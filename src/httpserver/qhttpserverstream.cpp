@@ -3,6 +3,11 @@
 
 #include "qhttpserverstream_p.h"
 
+#include <private/qabstracthttpserver_p.h>
+#include <private/qhttpserverrequest_p.h>
+
+#include <QtCore/qmetaobject.h>
+#include <QtCore/qthread.h>
 #include <QtNetwork/qtcpsocket.h>
 
 #if QT_CONFIG(ssl)
@@ -11,9 +16,105 @@
 
 QT_BEGIN_NAMESPACE
 
+QHttpServerStreamCallQueue::QHttpServerStreamCallQueue()
+    : m_head(&m_stub), m_tail(&m_stub)
+{
+}
+
+QHttpServerStreamCallQueue::~QHttpServerStreamCallQueue()
+{
+    while (pop()) { }
+}
+
+void QHttpServerStreamCallQueue::pushNode(Node *node)
+{
+    node->next.storeRelaxed(nullptr);
+    Node *previous = m_head.fetchAndStoreOrdered(node);
+    // Until this store, the consumer sees the queue as ending at previous.
+    previous->next.storeRelease(node);
+}
+
+bool QHttpServerStreamCallQueue::push(Call &&call)
+{
+    auto *node = new Node;
+    node->call = std::move(call);
+    pushNode(node);
+    return m_wakeUpPending.fetchAndStoreOrdered(1) == 0;
+}
+
+QHttpServerStreamCallQueue::Call QHttpServerStreamCallQueue::pop()
+{
+    Node *tail = m_tail;
+    Node *next = tail->next.loadAcquire();
+    if (tail == &m_stub) {
+        if (!next)
+            return {};
+        m_tail = next;
+        tail = next;
+        next = next->next.loadAcquire();
+    }
+
+    if (!next) {
+        // A push is in progress: its producer wakes the consumer up again,
+        // as it sets m_wakeUpPending after linking its node.
+        if (tail != m_head.loadAcquire())
+            return {};
+        // tail is the last node: the stub takes its place, so that it can
+        // be handed out.
+        pushNode(&m_stub);
+        next = tail->next.loadAcquire();
+        if (!next)
+            return {};
+    }
+
+    m_tail = next;
+    Call call = std::move(tail->call);
+    delete tail;
+    return call;
+}
+
 QHttpServerStream::QHttpServerStream(QObject *parent)
     : QObject(parent)
 {
+    m_ref->stream = this;
+}
+
+QHttpServerStream::~QHttpServerStream()
+{
+    {
+        QWriteLocker locker(&m_ref->lock);
+        m_ref->stream = nullptr;
+    }
+
+    // Not a connection to destroyed(): it would be gone already when the
+    // parent deletes this stream.
+    if (m_server)
+        m_server->handlerDestroyed();
+}
+
+/*!
+    \internal
+
+    Queues \a call from a thread other than the one of this stream. A single
+    wake-up is posted for the calls queued until the stream handles them.
+*/
+void QHttpServerStream::queueCall(QHttpServerStreamCallQueue::Call &&call)
+{
+    if (m_queuedCalls.push(std::move(call)))
+        QMetaObject::invokeMethod(this, &QHttpServerStream::flushQueuedCalls, Qt::QueuedConnection);
+}
+
+/*!
+    \internal
+
+    Makes the calls queued from other threads, in the thread of this stream.
+*/
+void QHttpServerStream::flushQueuedCalls()
+{
+    Q_ASSERT(thread() == QThread::currentThread());
+    m_queuedCalls.startPopping();
+    while (QHttpServerStreamCallQueue::Call call = m_queuedCalls.pop())
+        call(this);
 }
 
 QHttpServerRequest QHttpServerStream::initRequestFromSocket(QTcpSocket *tcpSocket)
@@ -33,4 +134,27 @@ QHttpServerRequest QHttpServerStream::initRequestFromSocket(QTcpSocket *tcpSocke
     return QHttpServerRequest(QHostAddress::LocalHost, 0, QHostAddress::LocalHost, 0);
 }
 
+/*!
+    \internal
+
+    Gives \a request a new cancellation token, whose deadline expires after
+    \a timeout, \c 0 meaning never. \a timer is started for the deadline,
+    so that the subclass cancels the request from timerEvent() unless the
+    response is finished before.
+*/
+std::shared_ptr<QHttpServerRequestCancellation>
+QHttpServerStream::startCancellation(QHttpServerRequest &request,
+                                     std::chrono::milliseconds timeout, QBasicTimer *timer)
+{
+    const bool hasTimeout = timeout > std::chrono::milliseconds::zero();
+    auto cancellation = std::make_shared<QHttpServerRequestCancellation>(
+            hasTimeout ? QDeadlineTimer(timeout) : QDeadlineTimer(QDeadlineTimer::Forever));
+    if (hasTimeout)
+        timer->start(timeout, this);
+    else
+        timer->stop();
+    request.d->cancellation = cancellation;
+    return cancellation;
+}
+
 QT_END_NAMESPACE
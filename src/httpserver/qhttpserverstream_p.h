@@ -4,12 +4,20 @@
 #ifndef QHTTPSERVERSTREAM_P_H
 #define QHTTPSERVERSTREAM_P_H
 
+#include <QtCore/qatomic.h>
+#include <QtCore/qbasictimer.h>
+#include <QtCore/qelapsedtimer.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qreadwritelock.h>
 
 #include <QtHttpServer/qthttpserverglobal.h>
 #include <QtHttpServer/qhttpserverresponder.h>
 #include <QtHttpServer/qhttpserverrequest.h>
 
+#include <chrono>
+#include <functional>
+#include <memory>
+
 //
 //  W A R N I N G
 //  -------------
@@ -23,25 +31,109 @@
 QT_BEGIN_NAMESPACE
 
 class QTcpSocket;
+class QAbstractHttpServerPrivate;
+class QHttpServerRequestCancellation;
+class QHttpServerStream;
+
+// Counts the requests of a connection in fixed one second windows to enforce
+// QHttpServerConfiguration::rateLimitPerSecond().
+class QHttpServerRequestRate
+{
+public:
+    bool tryAcquire(quint32 maxRequestsPerSecond)
+    {
+        if (maxRequestsPerSecond == 0)
+            return true;
+
+        if (!m_window.isValid() || m_window.hasExpired(1000)) {
+            m_window.start();
+            m_requests = 0;
+        }
+        return ++m_requests <= maxRequestsPerSecond;
+    }
+
+private:
+    QElapsedTimer m_window;
+    quint32 m_requests = 0;
+};
 
-class QHttpServerStream : public QObject
+// The calls made on a stream by responders in other threads. Any thread may
+// push, only the thread of the stream pops, in the order of the pushes.
+// This is Dmitry Vyukov's intrusive MPSC queue: a push takes a single atomic
+// exchange and never waits for the consumer.
+class QHttpServerStreamCallQueue
+{
+public:
+    using Call = std::function<void(QHttpServerStream *)>;
+
+    QHttpServerStreamCallQueue();
+    ~QHttpServerStreamCallQueue();
+    Q_DISABLE_COPY_MOVE(QHttpServerStreamCallQueue)
+
+    // Returns true if the consumer must be woken up, which is the case for
+    // the first call pushed after it started to pop.
+    bool push(Call &&call);
+    // Reads the last wake-up request, so that the calls pushed before it are
+    // seen by the following pops.
+    void startPopping() { m_wakeUpPending.fetchAndStoreOrdered(0); }
+    Call pop();
+    // Only called by the consumer.
+    bool isEmpty() const { return m_tail == &m_stub && !m_stub.next.loadAcquire(); }
+
+private:
+    struct Node
+    {
+        QAtomicPointer<Node> next;
+        Call call;
+    };
+
+    void pushNode(Node *node);
+
+    // Written by the producers.
+    QAtomicPointer<Node> m_head;
+    QAtomicInt m_wakeUpPending;
+    // Only used by the consumer.
+    Node *m_tail;
+    Node m_stub;
+};
+
+// Refers to a stream for its responders, which may outlive it when they are
+// kept by a handler in another thread. The stream clears it when it is
+// destroyed, and the responders then drop their calls.
+struct QHttpServerStreamRef
+{
+    QReadWriteLock lock;
+    QHttpServerStream *stream = nullptr;
+};
+
+class Q_AUTOTEST_EXPORT QHttpServerStream : public QObject
 {
     Q_OBJECT
 
+    friend class QAbstractHttpServerPrivate;
     friend class QHttpServerResponderPrivate;
 
 protected:
     QHttpServerStream(QObject *parent = nullptr);
+    ~QHttpServerStream() override;
 
     virtual void responderDestroyed() = 0;
     virtual void startHandlingRequest() = 0;
     virtual void socketDisconnected() = 0;
 
+    // Closes the connection once the requests in progress are done, and
+    // tells the client not to send further requests on it.
+    virtual void drain() = 0;
+    // Closes the connection right away.
+    virtual void abort() = 0;
+
     virtual void write(const QByteArray &body, const QHttpHeaders &headers,
                        QHttpServerResponder::StatusCode status, quint32 streamId) = 0;
     virtual void write(QHttpServerResponder::StatusCode status, quint32 streamId) = 0;
     virtual void write(QIODevice *data, const QHttpHeaders &headers,
                        QHttpServerResponder::StatusCode status, quint32 streamId) = 0;
+    virtual void writeInformational(QHttpServerResponder::StatusCode status,
+                                    const QHttpHeaders &headers, quint32 streamId) = 0;
 
     virtual void writeBeginChunked(const QHttpHeaders &headers,
                                    QHttpServerResponder::StatusCode status,
@@ -52,6 +144,20 @@ protected:
                                  quint32 streamId) = 0;
 
     static QHttpServerRequest initRequestFromSocket(QTcpSocket *socket);
+
+    std::shared_ptr<QHttpServerRequestCancellation>
+    startCancellation(QHttpServerRequest &request, std::chrono::milliseconds timeout,
+                      QBasicTimer *timer);
+
+private:
+    void queueCall(QHttpServerStreamCallQueue::Call &&call);
+    bool hasQueuedCalls() const { return !m_queuedCalls.isEmpty(); }
+    void flushQueuedCalls();
+
+    QHttpServerStreamCallQueue m_queuedCalls;
+    const std::shared_ptr<QHttpServerStreamRef> m_ref = std::make_shared<QHttpServerStreamRef>();
+    // Set by the server that counts this stream, told when it is destroyed.
+    QAbstractHttpServerPrivate *m_server = nullptr;
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,122 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtHttpServer/qhttpservertask.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QHttpServerTask
+    \since 6.9
+    \inmodule QtHttpServer
+    \brief The QHttpServerTask class is the return type of coroutine request
+    handlers.
+
+    QHttpServerTask is only available when compiling with C++20 coroutine
+    support, in which case the \c QT_HTTPSERVER_HAS_COROUTINES macro is
+    defined. A request handler passed to QHttpServer::route() may be a
+    coroutine returning \c {QHttpServerTask<QHttpServerResponse>}:
+
+    \code
+    server.route("/wait/", [] (const QHttpServerRequest &request)
+                 -> QHttpServerTask<QHttpServerResponse> {
+        co_await QtHttpServer::sleepFor(std::chrono::milliseconds(500));
+        co_return QHttpServerResponse(request.body());
+    });
+    \endcode
+
+    The coroutine is started by the server in the thread handling the
+    request, and resumed in that thread by the awaiters of the QtHttpServer
+    namespace. A suspended coroutine costs its frame only, which lets a
+    server wait for many requests at once, for instance for long polling.
+
+    A QHttpServerTask producing any other type can be awaited by another
+    coroutine with \c co_await, which starts it and resumes the awaiting
+    coroutine with its result once it finishes. A task that is destroyed
+    before it finished destroys its coroutine frame.
+
+    \sa QHttpServer::route()
+*/
+
+/*!
+    \fn template <typename T> QHttpServerTask<T>::QHttpServerTask(QHttpServerTask &&other)
+
+    Move-constructs a task from \a other, which is left invalid.
+*/
+
+/*!
+    \fn template <typename T> QHttpServerTask<T> &QHttpServerTask<T>::operator=(QHttpServerTask &&other)
+
+    Move-assigns \a other to this task and returns a reference to it.
+*/
+
+/*!
+    \fn template <typename T> QHttpServerTask<T>::~QHttpServerTask()
+
+    Destroys the task, and its coroutine frame if it is still owned by it.
+*/
+
+/*!
+    \fn template <typename T> void QHttpServerTask<T>::swap(QHttpServerTask &other)
+
+    Swaps this task with \a other.
+*/
+
+/*!
+    \fn template <typename T> bool QHttpServerTask<T>::isValid() const
+
+    Returns \c true if the task owns a coroutine frame.
+*/
+
+/*!
+    \fn template <typename T> bool QHttpServerTask<T>::isFinished() const
+
+    Returns \c true if the coroutine of the task ran to its end.
+*/
+
+/*!
+    \namespace QtHttpServer
+    \inmodule QtHttpServer
+    \since 6.9
+    \brief The QtHttpServer namespace contains the awaiters for coroutine
+    request handlers.
+
+    The functions of this namespace return objects a QHttpServerTask
+    coroutine can \c co_await. They suspend the coroutine until something
+    happens, and resume it from the event loop of the thread that awaited.
+
+    \sa QHttpServerTask
+*/
+
+/*!
+    \fn QtHttpServer::sleepFor(std::chrono::milliseconds duration)
+
+    Suspends the awaiting coroutine for \a duration. A \a duration that is
+    not positive does not suspend it.
+*/
+
+/*!
+    \fn QtHttpServer::readyRead(QIODevice *device)
+
+    Suspends the awaiting coroutine until \a device has data to read, is
+    closed or destroyed. The \c co_await expression is \c true if data can
+    be read from \a device.
+*/
+
+/*!
+    \fn template <typename Sender, typename Signal> QtHttpServer::signalEmitted(const Sender *sender, Signal signal)
+
+    Suspends the awaiting coroutine until \a sender emits \a signal, or is
+    destroyed. The \c co_await expression is \c true if \a signal was
+    emitted. This lets a coroutine wait for downstream I/O, for instance for
+    QNetworkReply::finished().
+*/
+
+/*!
+    \fn template <typename T> QtHttpServer::finished(QFuture<T> future)
+
+    Suspends the awaiting coroutine until \a future is finished or canceled.
+    The \c co_await expression is \a future.
+*/
+
+QT_END_NAMESPACE
@@ -0,0 +1,338 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef QHTTPSERVERTASK_H
+#define QHTTPSERVERTASK_H
+
+#include <QtHttpServer/qthttpserverglobal.h>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#  define QT_HTTPSERVER_HAS_COROUTINES
+#endif
+
+#include <type_traits>
+
+QT_BEGIN_NAMESPACE
+
+template <typename T>
+class QHttpServerTask;
+
+namespace QtPrivate {
+template <typename T>
+constexpr bool IsHttpServerTask = false;
+template <typename T>
+constexpr bool IsHttpServerTask<QHttpServerTask<T>> = true;
+} // namespace QtPrivate
+
+QT_END_NAMESPACE
+
+#ifdef QT_HTTPSERVER_HAS_COROUTINES
+
+#include <QtCore/qiodevice.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qtimer.h>
+
+#if QT_CONFIG(future)
+#  include <QtCore/qfuture.h>
+#  include <QtCore/qfuturewatcher.h>
+#endif
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+class QHttpServer;
+
+template <typename T>
+class QHttpServerTask
+{
+    static_assert(!std::is_void_v<T> && !std::is_reference_v<T>,
+                  "QHttpServerTask must produce a value.");
+
+public:
+    class promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+private:
+    // The frame of a task run by start(), until it completes or is
+    // destroyed by destroyStarted().
+    struct Started
+    {
+        Handle handle;
+    };
+
+public:
+
+    class promise_type
+    {
+    public:
+        QHttpServerTask get_return_object() noexcept
+        {
+            return QHttpServerTask(Handle::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+
+        auto final_suspend() const noexcept
+        {
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(Handle handle) const noexcept
+                {
+                    promise_type &promise = handle.promise();
+                    if (promise.m_continuation)
+                        return promise.m_continuation;
+                    if (promise.m_onFinished) {
+                        // Started by start(): nobody owns the frame anymore.
+                        if (const auto started = promise.m_started.lock())
+                            started->handle = {};
+                        auto onFinished = std::move(promise.m_onFinished);
+                        std::optional<T> result = std::move(promise.m_result);
+                        handle.destroy();
+                        onFinished(std::move(result));
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept { }
+            };
+            return FinalAwaiter{};
+        }
+
+        void return_value(T value) { m_result.emplace(std::move(value)); }
+
+        void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+
+    private:
+        friend class QHttpServerTask;
+
+        std::optional<T> m_result;
+        std::exception_ptr m_exception;
+        std::coroutine_handle<> m_continuation;
+        std::function<void(std::optional<T> &&)> m_onFinished;
+        std::weak_ptr<Started> m_started;
+    };
+
+    QHttpServerTask(QHttpServerTask &&other) noexcept
+        : m_handle(std::exchange(other.m_handle, {}))
+    {
+    }
+    QT_MOVE_ASSIGNMENT_OPERATOR_IMPL_VIA_MOVE_AND_SWAP(QHttpServerTask)
+    ~QHttpServerTask()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    void swap(QHttpServerTask &other) noexcept { std::swap(m_handle, other.m_handle); }
+
+    bool isValid() const noexcept { return bool(m_handle); }
+    bool isFinished() const noexcept { return m_handle && m_handle.done(); }
+
+    bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_handle.promise().m_continuation = awaiting;
+        return m_handle;
+    }
+
+    T await_resume()
+    {
+        Q_ASSERT(m_handle);
+        promise_type &promise = m_handle.promise();
+        if (promise.m_exception)
+            std::rethrow_exception(promise.m_exception);
+        Q_ASSERT(promise.m_result);
+        return std::move(*promise.m_result);
+    }
+
+private:
+    friend class QHttpServer;
+
+    explicit QHttpServerTask(Handle handle) noexcept : m_handle(handle) { }
+    Q_DISABLE_COPY(QHttpServerTask)
+
+    // Runs the coroutine until its first suspension, and calls onFinished
+    // with its result, or with an empty optional if it threw, once it
+    // completed. The frame then destroys itself. The returned object lets
+    // destroyStarted() destroy the frame before, while it is suspended.
+    template <typename Function>
+    std::shared_ptr<Started> start(Function &&onFinished) &&
+    {
+        Q_ASSERT(m_handle);
+        Handle handle = std::exchange(m_handle, {});
+        auto started = std::make_shared<Started>(Started{ handle });
+        handle.promise().m_onFinished = std::forward<Function>(onFinished);
+        handle.promise().m_started = started;
+        handle.resume();
+        return started;
+    }
+
+    // Destroys the suspended frame of a task run by start(), without calling
+    // its onFinished. Returns false if the task completed already. Must not
+    // be called while the coroutine runs.
+    static bool destroyStarted(const std::shared_ptr<Started> &started)
+    {
+        Handle handle = std::exchange(started->handle, {});
+        if (!handle)
+            return false;
+        handle.destroy();
+        return true;
+    }
+
+    Handle m_handle;
+};
+
+namespace QtPrivate {
+
+// Resumes the awaiting coroutine from the event loop of its thread. The
+// context is destroyed with the awaiter, which disconnects what is left.
+class HttpServerResumingAwaiter
+{
+protected:
+    void resume()
+    {
+        if (auto handle = std::exchange(m_handle, {}))
+            handle.resume();
+    }
+
+    std::coroutine_handle<> m_handle;
+    QObject m_context;
+};
+
+class HttpServerSleepAwaiter : private HttpServerResumingAwaiter
+{
+public:
+    explicit HttpServerSleepAwaiter(std::chrono::milliseconds duration) : m_duration(duration) { }
+
+    bool await_ready() const noexcept { return m_duration <= std::chrono::milliseconds::zero(); }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        QTimer::singleShot(m_duration, &m_context, [this] { resume(); });
+    }
+    void await_resume() const noexcept { }
+
+private:
+    std::chrono::milliseconds m_duration;
+};
+
+class HttpServerReadyReadAwaiter : private HttpServerResumingAwaiter
+{
+public:
+    explicit HttpServerReadyReadAwaiter(QIODevice *device) : m_device(device) { }
+
+    bool await_ready() const
+    {
+        return !m_device || !m_device->isOpen() || m_device->bytesAvailable() > 0;
+    }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        QObject::connect(m_device, &QIODevice::readyRead, &m_context, [this] { resume(); });
+        QObject::connect(m_device, &QIODevice::aboutToClose, &m_context, [this] { resume(); });
+        QObject::connect(m_device, &QObject::destroyed, &m_context, [this] { resume(); });
+    }
+    bool await_resume() const { return m_device && m_device->bytesAvailable() > 0; }
+
+private:
+    QPointer<QIODevice> m_device;
+};
+
+template <typename Sender, typename Signal>
+class HttpServerSignalAwaiter : private HttpServerResumingAwaiter
+{
+public:
+    HttpServerSignalAwaiter(const Sender *sender, Signal signal)
+        : m_sender(sender), m_signal(signal)
+    {
+    }
+
+    bool await_ready() const noexcept { return !m_sender; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        QObject::connect(m_sender, m_signal, &m_context, [this] {
+            m_emitted = true;
+            resume();
+        });
+        QObject::connect(m_sender, &QObject::destroyed, &m_context, [this] { resume(); });
+    }
+    bool await_resume() const noexcept { return m_emitted; }
+
+private:
+    QPointer<const Sender> m_sender;
+    Signal m_signal;
+    bool m_emitted = false;
+};
+
+#if QT_CONFIG(future)
+template <typename T>
+class HttpServerFutureAwaiter
+{
+public:
+    explicit HttpServerFutureAwaiter(QFuture<T> future) : m_future(std::move(future)) { }
+
+    bool await_ready() const { return m_future.isFinished(); }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        QObject::connect(&m_watcher, &QFutureWatcherBase::finished, &m_watcher,
+                         [handle] { handle.resume(); });
+        m_watcher.setFuture(m_future);
+    }
+    QFuture<T> await_resume() const { return m_future; }
+
+private:
+    QFuture<T> m_future;
+    QFutureWatcher<T> m_watcher;
+};
+#endif
+
+} // namespace QtPrivate
+
+namespace QtHttpServer {
+
+inline QtPrivate::HttpServerSleepAwaiter sleepFor(std::chrono::milliseconds duration)
+{
+    return QtPrivate::HttpServerSleepAwaiter(duration);
+}
+
+inline QtPrivate::HttpServerReadyReadAwaiter readyRead(QIODevice *device)
+{
+    return QtPrivate::HttpServerReadyReadAwaiter(device);
+}
+
+template <typename Sender, typename Signal>
+QtPrivate::HttpServerSignalAwaiter<Sender, Signal> signalEmitted(const Sender *sender,
+                                                                 Signal signal)
+{
+    static_assert(QtPrivate::FunctionPointer<Signal>::IsPointerToMemberFunction,
+                  "signalEmitted() takes a pointer to a signal of the sender.");
+    return QtPrivate::HttpServerSignalAwaiter<Sender, Signal>(sender, signal);
+}
+
+#if QT_CONFIG(future)
+template <typename T>
+QtPrivate::HttpServerFutureAwaiter<T> finished(QFuture<T> future)
+{
+    return QtPrivate::HttpServerFutureAwaiter<T>(std::move(future));
+}
+#endif
+
+} // namespace QtHttpServer
+
+QT_END_NAMESPACE
+
+#endif // QT_HTTPSERVER_HAS_COROUTINES
+
+#endif // QHTTPSERVERTASK_H
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
 #include <QtHttpServer/qabstracthttpserver.h>
+#include <QtHttpServer/qhttpserverconfiguration.h>
 
 #if defined(QT_WEBSOCKETS_LIB)
 #  include <QtWebSockets/qwebsocket.h>
@@ -151,6 +152,9 @@ private slots:
     void http2handshake();
     void http2request();
     void socketDisconnected();
+    void http2RefuseStreamsOverRateLimit();
+    void maxConnections();
+    void drain();
 
 private:
 #if QT_CONFIG(ssl)
@@ -876,6 +880,202 @@ void tst_QAbstractHttpServer::socketDisconnected()
 #endif // QT_CONFIG(ssl)
 }
 
+void tst_QAbstractHttpServer::http2RefuseStreamsOverRateLimit()
+{
+#if QT_CONFIG(ssl)
+    if (!hasServerAlpn)
+        QSKIP("Server-side ALPN is unsupported, skipping test");
+
+    struct HttpServer : QAbstractHttpServer
+    {
+        int requestCount = 0;
+
+        bool handleRequest(const QHttpServerRequest &, QHttpServerResponder &responder) override
+        {
+            ++requestCount;
+            responder.write(QHttpServerResponder::StatusCode::Ok);
+            return true;
+        }
+
+        void missingHandler(const QHttpServerRequest &, QHttpServerResponder &) override
+        {
+            Q_ASSERT(false);
+        }
+    } server;
+
+    QHttpServerConfiguration config;
+    config.setRateLimitPerSecond(1);
+    server.setConfiguration(config);
+    QCOMPARE(server.configuration(), config);
+
+    auto sslserver = std::make_unique<QSslServer>();
+    QSslConfiguration serverConfig = QSslConfiguration::defaultConfiguration();
+    serverConfig.setLocalCertificate(QSslCertificate(g_certificate));
+    serverConfig.setPrivateKey(QSslKey(g_privateKey, QSsl::Rsa));
+    serverConfig.setAllowedNextProtocols({ QSslConfiguration::ALPNProtocolHTTP2 });
+    sslserver->setSslConfiguration(serverConfig);
+    QVERIFY2(sslserver->listen(QHostAddress::LocalHost), "HTTPS server listen failed");
+    QVERIFY2(server.bind(sslserver.get()), "HTTPS server bind failed");
+    sslserver.release();
+
+    const auto serverPtr = server.servers().constFirst();
+    QSslSocketPtr socket = createNewConnection(serverPtr);
+    QVERIFY(socket->isEncrypted());
+    QCOMPARE(socket->state(), QAbstractSocket::ConnectedState);
+
+    QHttp2Connection *connection = QHttp2Connection::createDirectConnection(socket.get(), {});
+
+    QSignalSpy settingsFrameReceivedSpy{ connection, &QHttp2Connection::settingsFrameReceived };
+    connect(socket.get(), &QIODevice::readyRead, connection, &QHttp2Connection::handleReadyRead);
+    connection->handleReadyRead();
+
+    auto acceptedStream = connection->createStream().unwrap();
+    QVERIFY(acceptedStream);
+    auto refusedStream = connection->createStream().unwrap();
+    QVERIFY(refusedStream);
+
+    QVERIFY(settingsFrameReceivedSpy.wait());
+
+    QSignalSpy headersReceivedSpy{ acceptedStream, &QHttp2Stream::headersReceived };
+
+    HPack::HttpHeader headers = HPack::HttpHeader{
+       { ":authority", "example.com" },
+       { ":method", "GET" },
+       { ":path", "/" },
+       { ":scheme", "https" },
+    };
+    acceptedStream->sendHEADERS(headers, true);
+    refusedStream->sendHEADERS(headers, true);
+
+    QVERIFY(headersReceivedSpy.wait());
+    QTRY_COMPARE(refusedStream->state(), QHttp2Stream::State::Closed);
+    QCOMPARE(server.requestCount, 1);
+#else
+    QSKIP("TLS/SSL is not available, skipping test");
+#endif // QT_CONFIG(ssl)
+}
+
+void tst_QAbstractHttpServer::maxConnections()
+{
+    struct HttpServer : QAbstractHttpServer
+    {
+        int requestCount = 0;
+
+        bool handleRequest(const QHttpServerRequest &, QHttpServerResponder &responder) override
+        {
+            ++requestCount;
+            responder.write(QHttpServerResponder::StatusCode::Ok);
+            return true;
+        }
+
+        void missingHandler(const QHttpServerRequest &, QHttpServerResponder &) override
+        {
+            Q_ASSERT(false);
+        }
+    } server;
+
+    QHttpServerConfiguration config;
+    config.setMaxConnections(1);
+    server.setConfiguration(config);
+
+    auto tcpServer = new QTcpServer;
+    QVERIFY(tcpServer->listen(QHostAddress::LocalHost));
+    QVERIFY(server.bind(tcpServer));
+    const quint16 port = tcpServer->serverPort();
+
+    const QByteArray request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    QTcpSocket first;
+    first.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(first.waitForConnected());
+    first.write(request);
+    QTRY_VERIFY(first.bytesAvailable() > 0);
+    QVERIFY(first.readAll().startsWith("HTTP/1.1 200"));
+    QCOMPARE(server.requestCount, 1);
+
+    // The second connection waits in the listen backlog while the first
+    // one is open.
+    QTcpSocket second;
+    second.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(second.waitForConnected());
+    second.write(request);
+    QTest::qWait(200);
+    QCOMPARE(server.requestCount, 1);
+    QCOMPARE(second.bytesAvailable(), 0);
+
+    first.disconnectFromHost();
+    QTRY_VERIFY(second.bytesAvailable() > 0);
+    QVERIFY(second.readAll().startsWith("HTTP/1.1 200"));
+    QCOMPARE(server.requestCount, 2);
+}
+
+void tst_QAbstractHttpServer::drain()
+{
+    struct HttpServer : QAbstractHttpServer
+    {
+        std::unique_ptr<QHttpServerResponder> pending;
+
+        bool handleRequest(const QHttpServerRequest &request,
+                           QHttpServerResponder &responder) override
+        {
+            if (request.url().path() == "/worker"_L1)
+                responder.write(QHttpServerResponder::StatusCode::Ok);
+            else
+                pending = std::make_unique<QHttpServerResponder>(std::move(responder));
+            return true;
+        }
+
+        void missingHandler(const QHttpServerRequest &, QHttpServerResponder &) override
+        {
+            Q_ASSERT(false);
+        }
+    } server;
+
+    auto tcpServer = new QTcpServer;
+    QVERIFY(tcpServer->listen(QHostAddress::LocalHost));
+    QVERIFY(server.bind(tcpServer));
+    const quint16 port = tcpServer->serverPort();
+
+    // A connection destroyed together with its worker thread is not waited
+    // for.
+    server.setWorkerThreadCount(1);
+    QTcpSocket stopped;
+    stopped.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(stopped.waitForConnected());
+    stopped.write("GET /worker HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QTRY_VERIFY(stopped.bytesAvailable() > 0);
+    QVERIFY(stopped.readAll().startsWith("HTTP/1.1 200"));
+    server.setWorkerThreadCount(0);
+    QTRY_COMPARE(stopped.state(), QAbstractSocket::UnconnectedState);
+
+    QTcpSocket busy;
+    busy.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(busy.waitForConnected());
+    busy.write("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QTRY_VERIFY(server.pending);
+
+    QTcpSocket idle;
+    idle.connectToHost(QHostAddress::LocalHost, port);
+    QVERIFY(idle.waitForConnected());
+
+    QSignalSpy drainedSpy(&server, &QAbstractHttpServer::drained);
+    server.drain();
+    QVERIFY(server.isDraining());
+    QTRY_VERIFY(!tcpServer->isListening());
+
+    // The idle connection is closed, the request in progress is answered.
+    QTRY_COMPARE(idle.state(), QAbstractSocket::UnconnectedState);
+    QCOMPARE(busy.state(), QAbstractSocket::ConnectedState);
+    QCOMPARE(drainedSpy.size(), 0);
+
+    server.pending->write(QHttpServerResponder::StatusCode::Ok);
+    server.pending.reset();
+    QTRY_COMPARE(busy.state(), QAbstractSocket::UnconnectedState);
+    const QByteArray response = busy.readAll();
+    QVERIFY(response.startsWith("HTTP/1.1 200"));
+    QVERIFY(response.contains("Connection: close\r\n"));
+    QTRY_COMPARE(drainedSpy.size(), 1);
+}
+
 QT_END_NAMESPACE
 
 QTEST_MAIN(tst_QAbstractHttpServer)
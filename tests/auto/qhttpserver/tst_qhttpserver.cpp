@@ -2,11 +2,13 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
 #include <QtHttpServer/qhttpserver.h>
+#include <QtHttpServer/qhttpserverconfiguration.h>
 #include <QtHttpServer/qhttpserverrequest.h>
 #include <QtHttpServer/qhttpserverrouterrule.h>
 
 #include <QtTest/qtest.h>
 #include <QtTest/qsignalspy.h>
+#include <QtTest/qtesteventloop.h>
 
 #include <QtConcurrent/qtconcurrentrun.h>
 
@@ -19,12 +21,17 @@
 #include <QtCore/qjsonobject.h>
 #include <QtCore/qjsonvalue.h>
 #include <QtCore/qjsonarray.h>
+#include <QtCore/qpromise.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qthreadpool.h>
 #include <QtCore/qtimer.h>
 
 #include <QtNetwork/qnetworkaccessmanager.h>
 #include <QtNetwork/qnetworkreply.h>
 #include <QtNetwork/qnetworkrequest.h>
 #include <QtNetwork/qtcpserver.h>
+#include <QtNetwork/qtcpsocket.h>
 
 #if QT_CONFIG(ssl)
 #include <QtNetwork/qsslconfiguration.h>
@@ -39,6 +46,8 @@
 #endif
 
 #include <array>
+#include <atomic>
+#include <memory>
 
 #if QT_CONFIG(ssl)
 
@@ -228,7 +237,15 @@ private slots:
     void missingHandler();
     void pipelinedFutureRequests();
     void multipleResponses();
-    void contextObjectInOtherThreadWarning();
+    void earlyHints();
+    void maxRequestBodySize();
+    void streamedRequestBody();
+    void contextObjectInOtherThread();
+    void workerThreads();
+    void workerThreadsStoppedWhileHandling();
+    void listenInWorkerThreads();
+    void coroutineHandler();
+    void requestTimeout();
 
 #if QT_CONFIG(localserver)
     void localSocket();
@@ -245,6 +262,14 @@ private:
     ReplyObject replyObject;
 };
 
+static_assert(QtPrivate::RoutePattern("/api/v<arg>/user/<arg>").placeholderCount() == 2);
+static_assert(QtPrivate::RoutePattern("/api/v<arg>/user/").placeholderCount() == 1);
+static_assert(QtPrivate::RoutePattern("/<ar/g>/<arg").placeholderCount() == 0);
+static_assert(QtPrivate::RoutePattern("/api/v<arg>/user/<arg>").placeholderOffsets<2>()[0] == 6);
+static_assert(QtPrivate::RoutePattern("/api/v<arg>/user/<arg>").placeholderOffsets<2>()[1] == 17);
+static_assert(QtPrivate::RoutePattern("/api/<arg>").isAscii());
+static_assert(!QtPrivate::RoutePattern("/caf\xc3\xa9/<arg>").isAscii());
+
 struct CustomArg {
     int data = 10;
 
@@ -257,6 +282,14 @@ static void reqAndRespHandler(QHttpServerResponder &resp, const QHttpServerReque
     resp.write(req.body(), "text/html"_ba);
 }
 
+#ifdef QT_HTTPSERVER_HAS_COROUTINES
+static QHttpServerTask<int> doubledLater(int value)
+{
+    co_await QtHttpServer::sleepFor(std::chrono::milliseconds(10));
+    co_return value * 2;
+}
+#endif
+
 static void testHandler(QHttpServerResponder &responder)
 {
     responder.write("test msg", "text/html"_ba);
@@ -373,6 +406,13 @@ void tst_QHttpServer::initTestCase()
                    .arg(api).arg(user).arg(role, fragment);
     });
 
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+    httpserver.route<"/literal/<arg>/item/<arg>">(
+            this, [] (const quint32 group, const QString &item) {
+        return QString("group %1, item %2").arg(group).arg(item);
+    });
+#endif
+
     auto route = httpserver.route<QueryRequireRouterRule>(
             "/custom/",
             this,
@@ -424,6 +464,19 @@ void tst_QHttpServer::initTestCase()
         responder.writeEndChunked("part 2 of the message");
     });
 
+    httpserver.route("/chunked-from-thread/", this, [](QHttpServerResponder &responder) {
+        // The writes of the thread are queued on the connection, and flushed
+        // in the order they were made.
+        QThread *thread = QThread::create([responder = std::move(responder)]() mutable {
+            responder.writeBeginChunked("text/plain", QHttpServerResponder::StatusCode::Ok);
+            for (int i = 0; i < 100; ++i)
+                responder.writeChunk(QByteArray::number(i) + ',');
+            responder.writeEndChunked("end");
+        });
+        QObject::connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        thread->start();
+    });
+
     httpserver.route("/longChunks/", this, [](QHttpServerResponder &responder) {
         responder.writeBeginChunked("text/plain", QHttpServerResponder::StatusCode::Ok);
         constexpr qsizetype chunkLength = 8 * 1024 * 1024;
@@ -454,6 +507,13 @@ void tst_QHttpServer::initTestCase()
         responder.sendResponse(QHttpServerResponse("done"));
     });
 
+    httpserver.route("/early-hints", this, [](QHttpServerResponder &responder) {
+        QHttpHeaders hints;
+        hints.append(QHttpHeaders::WellKnownHeader::Link, "</style.css>; rel=preload; as=style");
+        responder.writeEarlyHints(hints);
+        responder.write("done", "text/plain");
+    });
+
     httpserver.addAfterRequestHandler(this, [] (const QHttpServerRequest &, QHttpServerResponse &) {
 
     });
@@ -582,6 +642,18 @@ void tst_QHttpServer::routeGet_data()
         << "text/plain"
         << "page: -10";
 
+    QTest::addRow("arg:+int")
+        << "/page/+10"
+        << 200
+        << "text/plain"
+        << "page: 10";
+
+    QTest::addRow("arg:int out of range")
+        << "/page/99999999999"
+        << 200
+        << "text/plain"
+        << "page: 0";
+
     QTest::addRow("arg:uint")
         << "/page/10/detail"
         << 200
@@ -594,6 +666,14 @@ void tst_QHttpServer::routeGet_data()
         << "application/x-empty"
         << "";
 
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+    QTest::addRow("arg:literal pattern")
+        << "/literal/7/item/seven"
+        << 200
+        << "text/plain"
+        << "group 7, item seven";
+#endif
+
     QTest::addRow("arg:string")
         << "/user/test"
         << 200
@@ -733,6 +813,15 @@ void tst_QHttpServer::routeGet_data()
         << "text/plain"
         << "part 1 of the message, part 2 of the message";
 
+    QString chunks;
+    for (int i = 0; i < 100; ++i)
+        chunks += QString::number(i) + u',';
+    QTest::addRow("chunked-from-thread")
+        << "/chunked-from-thread/"
+        << 200
+        << "text/plain"
+        << chunks + u"end";
+
 #if QT_CONFIG(concurrent)
     QTest::addRow("future")
         << "/future/1"
@@ -970,7 +1059,7 @@ void tst_QHttpServer::routeDelete_data()
 
     QTest::addRow("post-and-get, delete")
         << "/post-and-get"
-        << 404
+        << 405
         << "application/x-empty"
         << "";
 
@@ -1092,6 +1181,13 @@ void tst_QHttpServer::invalidRouterArguments()
             return "";
         }),
         nullptr);
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("not enough types"));
+    QCOMPARE(
+        httpserver.route("/placeholders/<arg>/<arg>", this, [] (const QString &name) {
+            return name;
+        }),
+        nullptr);
 }
 
 void tst_QHttpServer::checkRouteLambdaCapture()
@@ -1366,14 +1462,464 @@ void tst_QHttpServer::multipleResponses()
     QCOMPARE(reply->readAll(), "done");
 }
 
-void tst_QHttpServer::contextObjectInOtherThreadWarning()
+void tst_QHttpServer::earlyHints()
 {
-    QThread newThread;
-    ReplyObject replyObject;
-    replyObject.moveToThread(&newThread);
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    if (useHttp2)
+        QSKIP("Informational responses are not supported by QNetworkAccessManager for HTTP 2");
+
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+
+    const QUrl requestUrl(urlBase.arg("/early-hints"));
+    QNetworkRequest req(requestUrl);
+    req.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+    auto reply = networkAccessManager.get(req);
+
+    QTRY_VERIFY(reply->isFinished());
+
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->header(QNetworkRequest::ContentTypeHeader), "text/plain");
+    QCOMPARE(reply->readAll(), "done");
+
+    if (useSsl)
+        return;
+
+    // QNetworkAccessManager swallows the interim response, so look at the
+    // raw bytes on the wire.
+    const auto rawResponse = [&](QByteArrayView requestLine) {
+        QTcpSocket client;
+        client.connectToHost(QHostAddress::LocalHost, requestUrl.port());
+        if (!client.waitForConnected())
+            return QByteArray();
+        client.write(requestLine.toByteArray() + "\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+        QByteArray received;
+        QTestEventLoop loop;
+        connect(&client, &QTcpSocket::readyRead, &loop, [&]() {
+            received += client.readAll();
+            if (received.endsWith("done"))
+                loop.exitLoop();
+        });
+        connect(&client, &QTcpSocket::disconnected, &loop, &QTestEventLoop::exitLoop);
+        loop.enterLoopMSecs(5000);
+        return received + client.readAll();
+    };
+
+    const QByteArray http11 = rawResponse("GET /early-hints HTTP/1.1");
+    QVERIFY2(http11.startsWith("HTTP/1.1 103 Early Hints\r\n"), http11.constData());
+    const qsizetype hintsEnd = http11.indexOf("\r\n\r\n");
+    QVERIFY(hintsEnd > 0);
+    QVERIFY2(http11.left(hintsEnd).toLower().contains(
+                     "\r\nlink: </style.css>; rel=preload; as=style"), http11.constData());
+    QVERIFY2(http11.mid(hintsEnd + 4).startsWith("HTTP/1.1 200 OK\r\n"), http11.constData());
+    QVERIFY(http11.endsWith("done"));
+
+    // No interim responses for HTTP/1.0 clients, RFC 9110 15.2.
+    const QByteArray http10 = rawResponse("GET /early-hints HTTP/1.0");
+    QVERIFY2(http10.startsWith("HTTP/1.1 200 OK\r\n"), http10.constData());
+    QVERIFY(!http10.contains(" 103 "));
+    QVERIFY(http10.endsWith("done"));
+}
+
+void tst_QHttpServer::maxRequestBodySize()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+    QNetworkRequest request(urlBase.arg("/post-body"));
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+
+    const QHttpServerConfiguration defaultConfig = httpserver.configuration();
+    auto guard = QScopeGuard([this, defaultConfig]() {
+        httpserver.setConfiguration(defaultConfig);
+    });
+
+    QHttpServerConfiguration config;
+    config.setMaxRequestBodySize(16);
+    httpserver.setConfiguration(config);
+
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.post(request, "small body"_ba));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->readAll(), "small body");
+
+    reply.reset(networkAccessManager.post(request, QByteArray(1024, 'x')));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 413);
+}
+
+void tst_QHttpServer::streamedRequestBody()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+
+    // The route captures locals, so each row gets its own path.
+    const QString path = u"/streamed-body/%1/%2"_s.arg(int(useSsl)).arg(int(useHttp2));
+    bool streamed = false;
+    int readyReadCount = 0;
+    auto *rule = httpserver.route(path, QHttpServerRequest::Method::Post, this,
+            [&](const QHttpServerRequest &request, QHttpServerResponder &responder) {
+        QIODevice *device = request.bodyDevice();
+        streamed = device != nullptr;
+        if (!device) {
+            responder.write(request.body(), "application/octet-stream");
+            return;
+        }
+
+        // Answered once the whole body is received
+        auto heldResponder = std::make_shared<QHttpServerResponder>(std::move(responder));
+        auto received = std::make_shared<QByteArray>();
+        connect(device, &QIODevice::readyRead, device, [&readyReadCount, device, received]() {
+            ++readyReadCount;
+            *received += device->readAll();
+        });
+        connect(device, &QIODevice::readChannelFinished, device,
+                [device, received, heldResponder]() {
+            *received += device->readAll();
+            heldResponder->write(*received, "application/octet-stream");
+        });
+    });
+    QVERIFY(rule);
+    QVERIFY(!rule->isBodyStreamingEnabled());
+    rule->setBodyStreamingEnabled(true);
+    QVERIFY(rule->isBodyStreamingEnabled());
+
+    QByteArray body(1024 * 1024, Qt::Uninitialized);
+    for (qsizetype i = 0; i < body.size(); ++i)
+        body[i] = char(i % 251);
+
+    QNetworkRequest request(urlBase.arg(path));
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.post(request, body));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->readAll(), body);
+
+    // Only HTTP/2 requests are streamed, in more than one piece for a body
+    // larger than a stream's receive window.
+    QCOMPARE(streamed, useHttp2);
+    if (useHttp2)
+        QVERIFY(readyReadCount > 1);
+}
+
+void tst_QHttpServer::requestTimeout()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
 
-    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(".*context object.*same thread"));
-    QCOMPARE(httpserver.route("/otherThread", &replyObject, &ReplyObject::replyReqResp), nullptr);
+    const QHttpServerConfiguration defaultConfig = httpserver.configuration();
+    auto guard = QScopeGuard([this, defaultConfig]() {
+        httpserver.setConfiguration(defaultConfig);
+    });
+    QHttpServerConfiguration config;
+    config.setRequestTimeout(std::chrono::milliseconds(100));
+    httpserver.setConfiguration(config);
+
+    // Never finished by the handler, so that only the timeout answers. The
+    // route captures locals, so each row gets its own path.
+    const QString path = u"/timeout/%1/%2"_s.arg(int(useSsl)).arg(int(useHttp2));
+    QPromise<QHttpServerResponse> promise;
+    bool hasDeadline = false;
+    QVERIFY(httpserver.route(path, [&](const QHttpServerRequest &request) {
+        hasDeadline = !request.deadline().isForever() && !request.isCanceled();
+        return promise.future();
+    }));
+    promise.start();
+
+    QNetworkRequest request(urlBase.arg(path));
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QVERIFY(hasDeadline);
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 503);
+    QVERIFY(promise.isCanceled());
+    promise.finish();
+}
+
+void tst_QHttpServer::contextObjectInOtherThread()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+
+    QThread otherThread;
+    QObject otherContext;
+    otherContext.moveToThread(&otherThread);
+    otherThread.start();
+    auto guard = qScopeGuard([&otherThread]() {
+        otherThread.quit();
+        otherThread.wait();
+    });
+
+    QVERIFY(httpserver.route("/otherThread", &otherContext, [&otherThread]() {
+        return QThread::currentThread() == &otherThread ? u"other"_s : u"wrong"_s;
+    }));
+    QVERIFY(httpserver.route("/otherThread/responder", &otherContext,
+                             [&otherThread](QHttpServerResponder &responder) {
+        responder.write(QThread::currentThread() == &otherThread ? "other"_ba : "wrong"_ba,
+                        "text/plain"_ba);
+    }));
+
+    for (const char *path : { "/otherThread", "/otherThread/responder" }) {
+        QNetworkRequest request(urlBase.arg(path));
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+        std::unique_ptr<QNetworkReply> reply(networkAccessManager.get(request));
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QNetworkReply::NoError);
+        QCOMPARE(reply->readAll(), "other"_ba);
+    }
+}
+
+void tst_QHttpServer::workerThreads()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+
+    httpserver.setWorkerThreadCount(2);
+    auto guard = qScopeGuard([this]() {
+        httpserver.setWorkerThreadCount(0);
+        networkAccessManager.clearConnectionCache();
+    });
+    QCOMPARE(httpserver.workerThreadCount(), 2);
+
+    // With worker threads the handlers of context objects living in the
+    // thread of the server are called directly in the worker threads
+    QObject serverContext;
+    QThread *serverThread = httpserver.thread();
+    QVERIFY(httpserver.route("/worker-thread", &serverContext, [serverThread]() {
+        return QThread::currentThread() != serverThread ? u"worker"_s : u"server"_s;
+    }));
+
+    // Make sure the requests are sent on new connections
+    networkAccessManager.clearConnectionCache();
+
+    std::vector<std::unique_ptr<QNetworkReply>> replies;
+    for (int i = 0; i < 8; ++i) {
+        QNetworkRequest request(urlBase.arg(i % 2 ? "/worker-thread" : "/test"));
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+        replies.emplace_back(networkAccessManager.get(request));
+    }
+
+    for (qsizetype i = 0; i < qsizetype(replies.size()); ++i) {
+        QNetworkReply *reply = replies[i].get();
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QNetworkReply::NoError);
+        QCOMPARE(reply->readAll(), i % 2 ? "worker"_ba : "test msg"_ba);
+    }
+
+    QNetworkRequest request(urlBase.arg("/missing"));
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+}
+
+void tst_QHttpServer::workerThreadsStoppedWhileHandling()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+
+    httpserver.setWorkerThreadCount(2);
+    auto guard = qScopeGuard([this]() {
+        httpserver.setWorkerThreadCount(0);
+        networkAccessManager.clearConnectionCache();
+    });
+
+    // The responder of a handler running on a thread pool outlives the
+    // connection when the worker thread handling it is stopped. The route
+    // captures locals, so each row gets its own path.
+    QThreadPool pool;
+    QSemaphore started;
+    QSemaphore finish;
+    const QString path = u"/worker-stopped/%1/%2"_s.arg(int(useSsl)).arg(int(useHttp2));
+    QVERIFY(httpserver.route(path, &pool, [&started, &finish]() {
+        started.release();
+        finish.acquire();
+        return u"late"_s;
+    }));
+
+    networkAccessManager.clearConnectionCache();
+    QNetworkRequest request(urlBase.arg(path));
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.get(request));
+    QTRY_VERIFY(started.tryAcquire());
+
+    httpserver.setWorkerThreadCount(0);
+    QCOMPARE(httpserver.workerThreadCount(), 0);
+
+    // The client may send the request again on a new connection.
+    finish.release(2);
+    QTRY_VERIFY(reply->isFinished());
+    QVERIFY(pool.waitForDone());
+    if (reply->error() == QNetworkReply::NoError)
+        QCOMPARE(reply->readAll(), "late"_ba);
+
+    request.setUrl(urlBase.arg("/test"));
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->readAll(), "test msg"_ba);
+}
+
+void tst_QHttpServer::listenInWorkerThreads()
+{
+    QFETCH_GLOBAL(bool, useSsl);
+    if (useSsl)
+        QSKIP("The connections accepted by the worker threads are not encrypted");
+
+    QHttpServer server;
+    QThread *serverThread = server.thread();
+    server.route("/worker-thread", [serverThread]() {
+        return QThread::currentThread() != serverThread ? u"worker"_s : u"server"_s;
+    });
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression(".*requires worker threads.*"));
+    QCOMPARE(server.listenInWorkerThreads(QHostAddress::LocalHost), 0);
+
+    server.setWorkerThreadCount(2);
+    const quint16 port = server.listenInWorkerThreads(QHostAddress::LocalHost);
+    QVERIFY(port != 0);
+    QVERIFY(server.serverPorts().contains(port));
+
+    QNetworkAccessManager manager;
+    const QNetworkRequest request(QUrl(u"http://127.0.0.1:%1/worker-thread"_s.arg(port)));
+    std::unique_ptr<QNetworkReply> reply(manager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->readAll(), "worker"_ba);
+
+    // New worker threads listen on the same port
+    server.setWorkerThreadCount(3);
+    manager.clearConnectionCache();
+    reply.reset(manager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->readAll(), "worker"_ba);
+}
+
+void tst_QHttpServer::coroutineHandler()
+{
+#ifndef QT_HTTPSERVER_HAS_COROUTINES
+    QSKIP("The compiler does not support C++20 coroutines");
+#else
+    QFETCH_GLOBAL(bool, useSsl);
+    QFETCH_GLOBAL(bool, useHttp2);
+    QString urlBase = useSsl ? sslUrlBase : clearUrlBase;
+
+    QVERIFY(httpserver.route("/coroutine/", [](int value) -> QHttpServerTask<QHttpServerResponse> {
+        const int doubled = co_await doubledLater(value);
+        co_return QHttpServerResponse(QByteArray::number(doubled));
+    }));
+    QVERIFY(httpserver.route("/coroutine/echo", QHttpServerRequest::Method::Post,
+                             [](const QHttpServerRequest &request)
+                                     -> QHttpServerTask<QHttpServerResponse> {
+        co_await QtHttpServer::sleepFor(std::chrono::milliseconds(10));
+        co_return QHttpServerResponse(request.body());
+    }));
+#if QT_CONFIG(concurrent)
+    QVERIFY(httpserver.route("/coroutine/future", []() -> QHttpServerTask<QHttpServerResponse> {
+        QFuture<QByteArray> future = co_await QtHttpServer::finished(
+                QtConcurrent::run([]() { return "future"_ba; }));
+        co_return QHttpServerResponse(future.result());
+    }));
+#endif
+
+    // The suspended handlers wait concurrently
+    std::vector<std::unique_ptr<QNetworkReply>> replies;
+    for (int i = 0; i < 16; ++i) {
+        QNetworkRequest request(urlBase.arg(u"/coroutine/%1"_s.arg(i)));
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+        replies.emplace_back(networkAccessManager.get(request));
+    }
+    for (qsizetype i = 0; i < qsizetype(replies.size()); ++i) {
+        QNetworkReply *reply = replies[i].get();
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->error(), QNetworkReply::NoError);
+        QCOMPARE(reply->readAll(), QByteArray::number(i * 2));
+    }
+
+    QNetworkRequest request(urlBase.arg("/coroutine/echo"));
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, useHttp2);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "text/plain"_ba);
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.post(request, "echo"_ba));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->readAll(), "echo"_ba);
+
+#if QT_CONFIG(concurrent)
+    request.setUrl(urlBase.arg("/coroutine/future"));
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->error(), QNetworkReply::NoError);
+    QCOMPARE(reply->readAll(), "future"_ba);
+#endif
+
+    // A handler still suspended when its request times out is destroyed, and
+    // the timeout answers. The route captures locals, so each row gets its
+    // own path.
+    const QHttpServerConfiguration defaultConfig = httpserver.configuration();
+    auto guard = QScopeGuard([this, defaultConfig]() {
+        httpserver.setConfiguration(defaultConfig);
+    });
+    QHttpServerConfiguration config;
+    config.setRequestTimeout(std::chrono::milliseconds(100));
+    httpserver.setConfiguration(config);
+
+    const QString path = u"/coroutine/suspended/%1/%2"_s.arg(int(useSsl)).arg(int(useHttp2));
+    bool suspended = false;
+    bool destroyed = false;
+    QVERIFY(httpserver.route(path, [&]() -> QHttpServerTask<QHttpServerResponse> {
+        auto destroyGuard = qScopeGuard([&destroyed] { destroyed = true; });
+        suspended = true;
+        co_await QtHttpServer::sleepFor(std::chrono::hours(1));
+        co_return QHttpServerResponse("late"_ba);
+    }));
+
+    request.setUrl(urlBase.arg(path));
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QVERIFY(suspended);
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 503);
+    QTRY_VERIFY(destroyed);
+
+    // A handler whose context lives in another thread is run, and destroyed
+    // on timeout, in that thread
+    QThread contextThread;
+    QObject *context = new QObject;
+    context->moveToThread(&contextThread);
+    connect(&contextThread, &QThread::finished, context, &QObject::deleteLater);
+    contextThread.start();
+    auto threadGuard = qScopeGuard([&contextThread] {
+        contextThread.quit();
+        contextThread.wait();
+    });
+
+    const QString threadPath = u"/coroutine/suspended-in-thread/%1/%2"_s.arg(int(useSsl))
+                                       .arg(int(useHttp2));
+    std::atomic<QThread *> runThread = nullptr;
+    std::atomic<QThread *> destroyThread = nullptr;
+    QVERIFY(httpserver.route(threadPath, context, [&]() -> QHttpServerTask<QHttpServerResponse> {
+        auto destroyGuard = qScopeGuard([&destroyThread] {
+            destroyThread = QThread::currentThread();
+        });
+        runThread = QThread::currentThread();
+        co_await QtHttpServer::sleepFor(std::chrono::hours(1));
+        co_return QHttpServerResponse("late"_ba);
+    }));
+
+    request.setUrl(urlBase.arg(threadPath));
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 503);
+    QTRY_VERIFY(destroyThread.load());
+    QCOMPARE(runThread.load(), &contextThread);
+    QCOMPARE(destroyThread.load(), &contextThread);
+#endif // QT_HTTPSERVER_HAS_COROUTINES
 }
 
 #if QT_CONFIG(localserver)
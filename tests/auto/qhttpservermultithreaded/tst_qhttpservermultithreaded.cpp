@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
 #include <QtHttpServer/qhttpserver.h>
+#include <QtHttpServer/qhttpserverconfiguration.h>
 #include <QtHttpServer/qhttpserverrequest.h>
 #include <QtHttpServer/qhttpserverrouterrule.h>
 #include <QtTest/qtest.h>
@@ -11,7 +12,9 @@
 #include <QtCore/qlist.h>
 #include <QtCore/qurl.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qscopeguard.h>
 #include <QtCore/qsemaphore.h>
+#include <QtCore/qthreadpool.h>
 #include <QtCore/qtimer.h>
 #include <QtNetwork/qnetworkaccessmanager.h>
 #include <QtNetwork/qtcpserver.h>
@@ -142,6 +145,7 @@ public:
     LocalHttpClient(ServerType type);
     ~LocalHttpClient();
     QString get(const QString &url);
+    QString get(const QString &url, int *status, QHttpHeaders *headers);
     QString getSlowRead(const QString &url, qsizetype chunkSize, qsizetype mSleep);
     void pipelinedSendGet(const QString &url);
     QString piplinedFetchResults();
@@ -149,7 +153,7 @@ public:
 
 private:
     void sendGet(const QString &url);
-    QString fetchResults();
+    QString fetchResults(int *status = nullptr, QHttpHeaders *headers = nullptr);
     QIODevice *socket = nullptr;
 };
 
@@ -222,6 +226,12 @@ QString LocalHttpClient::get(const QString &url)
     return fetchResults();
 }
 
+QString LocalHttpClient::get(const QString &url, int *status, QHttpHeaders *headers)
+{
+    sendGet(url);
+    return fetchResults(status, headers);
+}
+
 QString LocalHttpClient::getSlowRead(const QString &url, qsizetype chunkSize, qsizetype mSleep)
 {
     sendGet(url);
@@ -308,13 +318,14 @@ void LocalHttpClient::sendGet(const QString &url)
     socket->write(u"GET %1 HTTP/1.1\r\n\r\n"_s.arg(url).toUtf8());
 }
 
-QString LocalHttpClient::fetchResults()
+QString LocalHttpClient::fetchResults(int *status, QHttpHeaders *headers)
 {
     Q_ASSERT(socket);
     qint64 contentLength = -1;
     constexpr qint64 bufferSize = 4 * 1024;
     char buffer[bufferSize];
     qint64 read = 0;
+    bool statusLine = true;
     forever {
         while (!socket->canReadLine()) {
             socket->waitForReadyRead(10);
@@ -325,11 +336,19 @@ QString LocalHttpClient::fetchResults()
         if (read <= 2)
             break; // End of headers
         QByteArrayView line(buffer, read);
+        if (std::exchange(statusLine, false)) {
+            // HTTP/1.1 <status> <reason>
+            if (status)
+                *status = line.sliced(line.indexOf(' ') + 1).first(3).toInt();
+            continue;
+        }
         auto colon = line.indexOf(':');
         if (colon != -1 && colon + 1 < line.size()) {
             auto headerTitle = line.first(colon);
             if (headerTitle.compare("Content-Length", Qt::CaseInsensitive) == 0)
                 contentLength = line.sliced(colon + 1).trimmed().toLongLong();
+            if (headers)
+                headers->append(headerTitle.trimmed(), line.sliced(colon + 1).trimmed());
         }
     };
 
@@ -381,11 +400,15 @@ private slots:
     void waitPipelinedQnam();
     void manyWaitingToRespond();
     void oneSlowManyFast();
+    void threadPoolRoute();
+    void threadPoolQueueLimit();
+    void concurrencyLimit();
 
 private:
     static constexpr qsizetype NumberOfThreads = 6;
     QSemaphore readySem, routeSem;
     QThreadPool threadPool;
+    QThreadPool singleThreadPool;
     QHttpServer httpserver;
     mutable qsizetype callCounter = 0;
     mutable QMutex mutex;
@@ -467,6 +490,17 @@ void tst_QHttpServerMultithreaded::initTestCase()
         });
     });
 
+    QHttpServerRouterRule *limitedRule = httpserver.route("/limited-semroute/<arg>",
+                                                          [this](int i) {
+        return QtConcurrent::run(&threadPool, [this, i] () {
+            readySem.release();
+            routeSem.acquire();
+            return QHttpServerResponse(QString::number(i));
+        });
+    });
+    QVERIFY(limitedRule);
+    limitedRule->setMaxConcurrentRequests(1);
+
     httpserver.route("/headers/", QHttpServerRequest::Method::Post,
                      [this](const QHttpServerRequest &request) {
                          return QtConcurrent::run(&threadPool, [&request]() {
@@ -477,6 +511,17 @@ void tst_QHttpServerMultithreaded::initTestCase()
                          });
                      });
 
+    httpserver.route("/pool-uppercase/<arg>", &threadPool, [this](const QString &input) {
+        return toUpper(input);
+    });
+
+    singleThreadPool.setMaxThreadCount(1);
+    httpserver.route("/pool-semroute/<arg>", &singleThreadPool, [this](int i) {
+        readySem.release();
+        routeSem.acquire();
+        return QString::number(i);
+    });
+
     auto tcpserver = std::make_unique<QTcpServer>();
     QVERIFY2(tcpserver->listen(), "HTTP server listen failed");
     port = tcpserver->serverPort();
@@ -905,6 +950,212 @@ void tst_QHttpServerMultithreaded::oneSlowManyFast()
     QCOMPARE(getCallCount(), NumberOfFastTasks + 1);
 }
 
+void tst_QHttpServerMultithreaded::threadPoolRoute()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+
+    QFuture<QString> future = QtConcurrent::run([&]() {
+        LocalHttpClient client(serverType);
+        return client.get(u"/pool-uppercase/hey"_s);
+    });
+
+    while (!future.isFinished())
+        QTest::qWait(1);
+
+    QCOMPARE(future.result(), u"HEY"_s);
+    QCOMPARE(getCallCount(), 1);
+}
+
+void tst_QHttpServerMultithreaded::threadPoolQueueLimit()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    QCOMPARE(readySem.available(), 0);
+    QCOMPARE(routeSem.available(), 0);
+
+    QHttpServerConfiguration config;
+    config.setThreadPoolQueueLimit(1);
+    httpserver.setConfiguration(config);
+    auto guard = qScopeGuard([this]() {
+        httpserver.setConfiguration(QHttpServerConfiguration());
+    });
+
+    QThreadPool clientThreadPool;
+    clientThreadPool.setMaxThreadCount(3);
+    const auto get = [&](int i) {
+        return QtConcurrent::run(&clientThreadPool, [serverType, i]() {
+            LocalHttpClient client(serverType);
+            return client.get(u"/pool-semroute/%1"_s.arg(i));
+        });
+    };
+
+    // The first request keeps the only thread of the pool busy
+    QFuture<QString> running = get(0);
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+
+    // One of the next requests waits for the thread, the other one is
+    // rejected with an empty 503 response
+    QFuture<QString> second = get(1);
+    QFuture<QString> third = get(2);
+    while (!second.isFinished() && !third.isFinished())
+        QTest::qWait(1);
+    const bool secondRejected = second.isFinished();
+
+    routeSem.release(2);
+    while (!running.isFinished() || !second.isFinished() || !third.isFinished())
+        QTest::qWait(1);
+
+    QCOMPARE(running.result(), u"0"_s);
+    QCOMPARE(second.result(), secondRejected ? QString() : u"1"_s);
+    QCOMPARE(third.result(), secondRejected ? u"2"_s : QString());
+
+    readySem.acquire(2);
+    QCOMPARE(readySem.available(), 0);
+    QCOMPARE(routeSem.available(), 0);
+}
+
+void tst_QHttpServerMultithreaded::concurrencyLimit()
+{
+    QFETCH_GLOBAL(ServerType, serverType);
+    QCOMPARE(readySem.available(), 0);
+    QCOMPARE(routeSem.available(), 0);
+
+    QHttpServerConfiguration config;
+    config.setMaxConcurrentRequests(1);
+    httpserver.setConfiguration(config);
+    auto guard = qScopeGuard([this]() {
+        httpserver.setConfiguration(QHttpServerConfiguration());
+    });
+
+    struct Reply
+    {
+        QString body;
+        int status = 0;
+        QHttpHeaders headers;
+    };
+    QThreadPool clientThreadPool;
+    clientThreadPool.setMaxThreadCount(3);
+    const auto getPath = [&](const QString &path) {
+        return QtConcurrent::run(&clientThreadPool, [serverType, path]() {
+            LocalHttpClient client(serverType);
+            Reply reply;
+            reply.body = client.get(path, &reply.status, &reply.headers);
+            return reply;
+        });
+    };
+    const auto get = [&](int i) {
+        return QtConcurrent::run(&clientThreadPool, [serverType, i]() {
+            LocalHttpClient client(serverType);
+            return client.get(u"/semroute/%1"_s.arg(i));
+        });
+    };
+    const auto verifyRejected = [](const Reply &reply) {
+        QCOMPARE(reply.status, 503);
+        QCOMPARE(reply.body, QString());
+        // Without an admission timeout, clients retry after a second
+        QCOMPARE(reply.headers.value(QHttpHeaders::WellKnownHeader::RetryAfter).toByteArray(),
+                 QByteArray("1"));
+    };
+
+    // The first request is in flight until its response is sent
+    QFuture<QString> running = get(0);
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+    readySem.acquire();
+
+    // Without an admission timeout, the next request is rejected right away
+    // with an empty 503 response
+    QFuture<Reply> rejected = getPath(u"/semroute/1"_s);
+    while (!rejected.isFinished())
+        QTest::qWait(1);
+    verifyRejected(rejected.result());
+    if (QTest::currentTestFailed())
+        return;
+
+    // With one, it waits for the first request to finish
+    config.setAdmissionTimeout(std::chrono::seconds(30));
+    httpserver.setConfiguration(config);
+    QFuture<QString> waiting = get(2);
+    QTest::qWait(100);
+    QCOMPARE(readySem.available(), 0);
+
+    routeSem.release();
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+    readySem.acquire();
+    routeSem.release();
+    while (!running.isFinished() || !waiting.isFinished())
+        QTest::qWait(1);
+
+    QCOMPARE(running.result(), u"0"_s);
+    QCOMPARE(waiting.result(), u"2"_s);
+    QCOMPARE(readySem.available(), 0);
+    QCOMPARE(routeSem.available(), 0);
+
+    // The limit of a rule only applies to the requests it handles
+    httpserver.setConfiguration(QHttpServerConfiguration());
+    QFuture<Reply> limited = getPath(u"/limited-semroute/3"_s);
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+    readySem.acquire();
+
+    rejected = getPath(u"/limited-semroute/4"_s);
+    while (!rejected.isFinished())
+        QTest::qWait(1);
+    verifyRejected(rejected.result());
+    if (QTest::currentTestFailed())
+        return;
+
+    running = get(5);
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+    readySem.acquire();
+    routeSem.release(2);
+    while (!running.isFinished() || !limited.isFinished())
+        QTest::qWait(1);
+    QCOMPARE(running.result(), u"5"_s);
+    QCOMPARE(limited.result().status, 200);
+    QCOMPARE(limited.result().body, u"3"_s);
+
+    // In adaptive mode, a request much slower than the ones before lowers
+    // the limit below its maximum
+    config = QHttpServerConfiguration();
+    config.setMaxConcurrentRequests(2);
+    config.setAdaptiveConcurrencyEnabled(true);
+    httpserver.setConfiguration(config);
+
+    Reply fast = getPath(u"/pool-uppercase/fast"_s).result();
+    QCOMPARE(fast.body, u"FAST"_s);
+
+    running = get(6);
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+    readySem.acquire();
+    QTest::qWait(500);
+    routeSem.release();
+    while (!running.isFinished())
+        QTest::qWait(1);
+    QCOMPARE(running.result(), u"6"_s);
+
+    running = get(7);
+    while (readySem.available() < 1)
+        QTest::qWait(1);
+    readySem.acquire();
+    rejected = getPath(u"/semroute/8"_s);
+    while (!rejected.isFinished())
+        QTest::qWait(1);
+    verifyRejected(rejected.result());
+    if (QTest::currentTestFailed())
+        return;
+
+    routeSem.release();
+    while (!running.isFinished())
+        QTest::qWait(1);
+    QCOMPARE(running.result(), u"7"_s);
+    QCOMPARE(readySem.available(), 0);
+    QCOMPARE(routeSem.available(), 0);
+}
+
 QT_END_NAMESPACE
 
 QTEST_MAIN(tst_QHttpServerMultithreaded)
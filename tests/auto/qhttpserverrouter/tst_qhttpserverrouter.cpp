@@ -6,6 +6,12 @@
 #include <QtHttpServer/qhttpserverrouter.h>
 #include <QtHttpServer/qhttpserverrouterrule.h>
 
+#if defined(QT_BUILD_INTERNAL)
+#include <QtHttpServer/private/qhttpserverrouter_p.h>
+#endif
+
+#include <QtCore/qscopeguard.h>
+
 #include <QtTest/qsignalspy.h>
 #include <QtTest/qtest.h>
 #include <QtNetwork/qnetworkaccessmanager.h>
@@ -21,7 +27,8 @@ struct HttpServer : QAbstractHttpServer {
     HttpServer() : router(this) {};
 
     template<typename ViewHandler>
-    void route(const char *path, const QHttpServerRequest::Methods methods, ViewHandler &&viewHandler)
+    QHttpServerRouterRule *route(const char *path, const QHttpServerRequest::Methods methods,
+                                 ViewHandler &&viewHandler)
     {
         auto rule = std::make_unique<QHttpServerRouterRule>(
                 path, methods, this,
@@ -32,13 +39,13 @@ struct HttpServer : QAbstractHttpServer {
                     boundViewHandler(responder);
                 });
 
-        router.addRule<ViewHandler>(std::move(rule));
+        return router.addRule<ViewHandler>(std::move(rule));
     }
 
     template<typename ViewHandler>
-    void route(const char *path, ViewHandler &&viewHandler)
+    QHttpServerRouterRule *route(const char *path, ViewHandler &&viewHandler)
     {
-        route(path, QHttpServerRequest::Method::AnyKnown, std::forward<ViewHandler>(viewHandler));
+        return route(path, QHttpServerRequest::Method::AnyKnown, std::forward<ViewHandler>(viewHandler));
     }
 
     bool handleRequest(const QHttpServerRequest &request, QHttpServerResponder &responder) override
@@ -60,6 +67,13 @@ private slots:
     void initTestCase();
     void routerRule_data();
     void routerRule();
+    void allowedMethods_data();
+    void allowedMethods();
+    void routeCache();
+    void derivedRules();
+    void typedSegments();
+    void addRuleFromHandler();
+    void statistics();
     void viewHandlerMemberFunction();
     void viewHandlerNoArg();
     void viewHandlerOneArg();
@@ -93,6 +107,40 @@ void tst_QHttpServerRouter::initTestCase()
 
     httpserver.route("/get-only", QHttpServerRequest::Method::Get, getTest);
 
+    httpserver.route("/order/", [] (const QString &name, QHttpServerResponder &responder) {
+        responder.write(QString("order: %1").arg(name).toUtf8(), "text/plain");
+    });
+
+    httpserver.route("/order/literal", [] (QHttpServerResponder &responder) {
+        responder.write(QString("literal").toUtf8(), "text/plain");
+    });
+
+    httpserver.route("/order/lit.ral/", [] (const quint64 &page, QHttpServerResponder &responder) {
+        responder.write(QString("regexp: %1").arg(page).toUtf8(), "text/plain");
+    });
+
+    httpserver.route("/order/l.*/", [] (const QString &name, QHttpServerResponder &responder) {
+        responder.write(QString("wildcard: %1").arg(name).toUtf8(), "text/plain");
+    });
+
+    const auto writeText = [] (const char *text) {
+        return [text] (QHttpServerResponder &responder) {
+            responder.write(QByteArray(text), "text/plain");
+        };
+    };
+
+    // A path without captures that is added after a regular expression
+    // matching it is shadowed by that expression.
+    httpserver.route("/shadow/st.tic", writeText("shadow: regexp"));
+    httpserver.route("/shadow/static", writeText("shadow: static"));
+    httpserver.route("/shadow/other", writeText("shadow: other"));
+
+    httpserver.route("/slash/file", writeText("slash: file"));
+    httpserver.route("/slash/dir/", writeText("slash: dir"));
+
+    httpserver.route("/method", QHttpServerRequest::Method::Get, writeText("method: get"));
+    httpserver.route("/method", QHttpServerRequest::Method::Post, writeText("method: post"));
+
     auto tcpserver = std::make_unique<QTcpServer>();
     QVERIFY2(tcpserver->listen(QHostAddress::Any), "HTTP server listen failed");
     quint16 port = tcpserver->serverPort();
@@ -125,14 +173,14 @@ void tst_QHttpServerRouter::routerRule_data()
 
     QTest::addRow("/post-only [GET]")
         << "/post-only"
-        << 404
+        << 405
         << "application/x-empty"
         << ""
         << QNetworkAccessManager::GetOperation;
 
     QTest::addRow("/post-only [DELETE]")
         << "/post-only"
-        << 404
+        << 405
         << "application/x-empty"
         << ""
         << QNetworkAccessManager::DeleteOperation;
@@ -153,17 +201,115 @@ void tst_QHttpServerRouter::routerRule_data()
 
     QTest::addRow("/get-only [POST]")
         << "/get-only"
-        << 404
+        << 405
         << "application/x-empty"
         << ""
         << QNetworkAccessManager::PostOperation;
 
     QTest::addRow("/get-only [DELETE]")
         << "/get-only"
+        << 405
+        << "application/x-empty"
+        << ""
+        << QNetworkAccessManager::DeleteOperation;
+
+    QTest::addRow("/order/literal")
+        << "/order/literal"
+        << 200
+        << "text/plain"
+        << "order: literal"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/order/litxral/5")
+        << "/order/litxral/5"
+        << 200
+        << "text/plain"
+        << "regexp: 5"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/order/literal/5")
+        << "/order/literal/5"
+        << 200
+        << "text/plain"
+        << "regexp: 5"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/order/litxral/abc")
+        << "/order/litxral/abc"
+        << 200
+        << "text/plain"
+        << "wildcard: abc"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/shadow/static")
+        << "/shadow/static"
+        << 200
+        << "text/plain"
+        << "shadow: regexp"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/shadow/other")
+        << "/shadow/other"
+        << 200
+        << "text/plain"
+        << "shadow: other"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/slash/file")
+        << "/slash/file"
+        << 200
+        << "text/plain"
+        << "slash: file"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/slash/file/")
+        << "/slash/file/"
         << 404
         << "application/x-empty"
         << ""
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/slash/dir/")
+        << "/slash/dir/"
+        << 200
+        << "text/plain"
+        << "slash: dir"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/slash/dir")
+        << "/slash/dir"
+        << 404
+        << "application/x-empty"
+        << ""
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/method [GET]")
+        << "/method"
+        << 200
+        << "text/plain"
+        << "method: get"
+        << QNetworkAccessManager::GetOperation;
+
+    QTest::addRow("/method [POST]")
+        << "/method"
+        << 200
+        << "text/plain"
+        << "method: post"
+        << QNetworkAccessManager::PostOperation;
+
+    QTest::addRow("/method [DELETE]")
+        << "/method"
+        << 405
+        << "application/x-empty"
+        << ""
         << QNetworkAccessManager::DeleteOperation;
+
+    QTest::addRow("/order/a/b")
+        << "/order/a/b"
+        << 404
+        << "application/x-empty"
+        << ""
+        << QNetworkAccessManager::GetOperation;
 }
 
 void tst_QHttpServerRouter::routerRule()
@@ -200,6 +346,305 @@ void tst_QHttpServerRouter::routerRule()
     QCOMPARE(reply->readAll(), body);
 }
 
+void tst_QHttpServerRouter::allowedMethods_data()
+{
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<QByteArray>("verb");
+    QTest::addColumn<int>("code");
+    QTest::addColumn<QByteArray>("allow");
+
+    QTest::addRow("/post-only [GET]") << "/post-only" << QByteArray("GET") << 405
+                                      << QByteArray("POST, OPTIONS");
+    QTest::addRow("/post-only [OPTIONS]") << "/post-only" << QByteArray("OPTIONS") << 200
+                                          << QByteArray("POST, OPTIONS");
+    QTest::addRow("/get-only [OPTIONS]") << "/get-only" << QByteArray("OPTIONS") << 200
+                                         << QByteArray("GET, OPTIONS");
+    QTest::addRow("/page/1 [OPTIONS]") << "/page/1" << QByteArray("OPTIONS") << 200
+                                       << QByteArray();
+    QTest::addRow("/missing [OPTIONS]") << "/missing" << QByteArray("OPTIONS") << 404
+                                        << QByteArray();
+}
+
+void tst_QHttpServerRouter::allowedMethods()
+{
+    QFETCH(QString, url);
+    QFETCH(QByteArray, verb);
+    QFETCH(int, code);
+    QFETCH(QByteArray, allow);
+
+    QNetworkAccessManager networkAccessManager;
+    QNetworkRequest request(QUrl(urlBase.arg(url)));
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.sendCustomRequest(request, verb));
+
+    QTRY_VERIFY(reply->isFinished());
+
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), code);
+    QCOMPARE(reply->rawHeader("Allow"), allow);
+}
+
+void tst_QHttpServerRouter::routeCache()
+{
+    QCOMPARE(httpserver.router.routeCacheSize(), 0);
+    httpserver.router.setRouteCacheSize(16);
+    QCOMPARE(httpserver.router.routeCacheSize(), 16);
+    auto guard = qScopeGuard([this] { httpserver.router.setRouteCacheSize(0); });
+
+    const std::pair<QString, QByteArray> requests[] = {
+        { "/page/7", "page: 7" },
+        { "/page/8", "page: 8" },
+        { "/order/litxral/abc", "wildcard: abc" },
+        { "/page/7", "page: 7" },
+        { "/order/litxral/abc", "wildcard: abc" },
+        { "/page/8", "page: 8" },
+    };
+
+    QNetworkAccessManager networkAccessManager;
+    for (const auto &[path, body] : requests) {
+        std::unique_ptr<QNetworkReply> reply(
+                networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg(path)))));
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->readAll(), body);
+    }
+
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.post(
+            QNetworkRequest(QUrl(urlBase.arg("/get-only"))), QByteArray("post body")));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 405);
+
+#if defined(QT_BUILD_INTERNAL)
+    const auto get = [&](const QString &path) {
+        std::unique_ptr<QNetworkReply> reply(
+                networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg(path)))));
+        if (!reply->isFinished())
+            QSignalSpy(reply.get(), &QNetworkReply::finished).wait();
+        return reply->readAll();
+    };
+    const auto *routerD = QHttpServerRouterPrivate::get(&httpserver.router);
+    const auto isCached = [routerD](const QString &path) {
+        return routerD->isRouteCached(path, QHttpServerRequest::Method::Get);
+    };
+
+    httpserver.router.setRouteCacheSize(0);
+    httpserver.router.setRouteCacheSize(2);
+    QVERIFY(!isCached("/page/7"));
+    const quint64 hits = routerD->routeCacheHits();
+
+    QCOMPARE(get("/page/7"), "page: 7");
+    QVERIFY(isCached("/page/7"));
+    QCOMPARE(routerD->routeCacheHits(), hits);
+    QCOMPARE(get("/page/7"), "page: 7");
+    QCOMPARE(routerD->routeCacheHits(), hits + 1);
+
+    // The least recently used route is evicted first.
+    QCOMPARE(get("/page/8"), "page: 8");
+    QCOMPARE(get("/page/7"), "page: 7");
+    QCOMPARE(routerD->routeCacheHits(), hits + 2);
+    QCOMPARE(get("/order/litxral/abc"), "wildcard: abc");
+    QVERIFY(isCached("/page/7"));
+    QVERIFY(!isCached("/page/8"));
+    QVERIFY(isCached("/order/litxral/abc"));
+
+    // Adding a rule may change how any path resolves.
+    httpserver.route("/cache/added", [] (QHttpServerResponder &responder) {
+        responder.write(QHttpServerResponder::StatusCode::NoContent);
+    });
+    QVERIFY(!isCached("/page/7"));
+    QVERIFY(!isCached("/order/litxral/abc"));
+    QCOMPARE(httpserver.router.routeCacheSize(), 2);
+    QCOMPARE(get("/page/7"), "page: 7");
+    QVERIFY(isCached("/page/7"));
+
+    // A larger cache is split into parts with their own lock, which hold as
+    // many routes together.
+    httpserver.router.setRouteCacheSize(64);
+    for (int i = 0; i < 16; ++i)
+        QCOMPARE(get(QString("/page/%1").arg(i)), QString("page: %1").arg(i).toUtf8());
+    for (int i = 0; i < 16; ++i)
+        QVERIFY(isCached(QString("/page/%1").arg(i)));
+#endif
+}
+
+void tst_QHttpServerRouter::derivedRules()
+{
+    struct TaggedRule : QHttpServerRouterRule
+    {
+        using QHttpServerRouterRule::QHttpServerRouterRule;
+    };
+
+    struct HeaderRule : QHttpServerRouterRule
+    {
+        using QHttpServerRouterRule::QHttpServerRouterRule;
+
+        bool matches(const QHttpServerRequest &request,
+                     QRegularExpressionMatch *match) const override
+        {
+            return request.value("X-Route") == "header"
+                    && QHttpServerRouterRule::matches(request, match);
+        }
+    };
+
+    const auto writeBody = [](const QByteArray &body) {
+        return [body](const QRegularExpressionMatch &, const QHttpServerRequest &,
+                      QHttpServerResponder &responder) {
+            responder.write(body, "text/plain");
+        };
+    };
+
+    // The rules capture nothing, so any handler without arguments describes them.
+    using NoCaptures = decltype(&getTest);
+
+    // A rule that keeps the inherited matches() is indexed like a plain one,
+    // so the router can answer with the methods it allows.
+    QVERIFY(httpserver.router.addRule<NoCaptures>(
+            std::make_unique<TaggedRule>("/derived/tagged", QHttpServerRequest::Method::Get,
+                                         this, writeBody("tagged"))));
+    QVERIFY(httpserver.router.addRule<NoCaptures>(
+            std::make_unique<HeaderRule>("/derived/header", QHttpServerRequest::Method::Get,
+                                         this, writeBody("header"))));
+
+    QNetworkAccessManager networkAccessManager;
+    QNetworkRequest request(QUrl(urlBase.arg("/derived/tagged")));
+    std::unique_ptr<QNetworkReply> reply(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->readAll(), "tagged");
+
+    reply.reset(networkAccessManager.sendCustomRequest(request, "OPTIONS"));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200);
+    QCOMPARE(reply->rawHeader("Allow"), "GET, OPTIONS");
+
+    // A rule that overrides matches() is asked for every request.
+    request.setUrl(QUrl(urlBase.arg("/derived/header")));
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+
+    request.setRawHeader("X-Route", "header");
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->readAll(), "header");
+
+    // Also when it is added through a pointer to the base class.
+    std::unique_ptr<QHttpServerRouterRule> upcast = std::make_unique<HeaderRule>(
+            "/derived/upcast", QHttpServerRequest::Method::Get, this, writeBody("upcast"));
+    QVERIFY(httpserver.router.addRule<NoCaptures>(std::move(upcast)));
+
+    request.setUrl(QUrl(urlBase.arg("/derived/upcast")));
+    request.setRawHeader("X-Route", "other");
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+
+    request.setRawHeader("X-Route", "header");
+    reply.reset(networkAccessManager.get(request));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->readAll(), "upcast");
+}
+
+void tst_QHttpServerRouter::typedSegments()
+{
+    httpserver.route("/typed/", [] (const qint32 &value, QHttpServerResponder &responder) {
+        responder.write(QString("int: %1").arg(value).toUtf8(), "text/plain");
+    });
+    httpserver.route("/typed/", [] (const QString &value, QHttpServerResponder &responder) {
+        responder.write(QString("string: %1").arg(value).toUtf8(), "text/plain");
+    });
+
+    const std::pair<QString, QByteArray> requests[] = {
+        { "/typed/12", "int: 12" },
+        { "/typed/-12", "int: -12" },
+        { "/typed/+12", "int: 12" },
+        { "/typed/-+12", "string: -+12" },
+        { "/typed/12a", "string: 12a" },
+        { "/typed/-", "string: -" },
+    };
+
+    QNetworkAccessManager networkAccessManager;
+    for (const auto &[path, body] : requests) {
+        std::unique_ptr<QNetworkReply> reply(
+                networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg(path)))));
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->readAll(), body);
+    }
+}
+
+void tst_QHttpServerRouter::addRuleFromHandler()
+{
+    httpserver.route("/register/", [this] (const QString &name, QHttpServerResponder &responder) {
+        const QByteArray path = "/registered/" + name.toUtf8();
+        httpserver.route(path.constData(), [name] (QHttpServerResponder &responder) {
+            responder.write(QString("registered: %1").arg(name).toUtf8(), "text/plain");
+        });
+        responder.write(QHttpServerResponder::StatusCode::Created);
+    });
+
+    QNetworkAccessManager networkAccessManager;
+    std::unique_ptr<QNetworkReply> reply(
+            networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg("/registered/first")))));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 404);
+
+    reply.reset(networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg("/register/first")))));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 201);
+
+    reply.reset(networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg("/registered/first")))));
+    QTRY_VERIFY(reply->isFinished());
+    QCOMPARE(reply->readAll(), "registered: first");
+}
+
+void tst_QHttpServerRouter::statistics()
+{
+    using StatusClass = QHttpServerRouteStatistics::StatusClass;
+
+    QVERIFY(!httpserver.router.isStatisticsEnabled());
+    QHttpServerRouterRule *rule = httpserver.route(
+            "/statistics/", [] (const int &status, QHttpServerResponder &responder) {
+        responder.write(QHttpServerResponder::StatusCode(status));
+    });
+    QVERIFY(rule);
+
+    httpserver.router.setStatisticsEnabled(true);
+    QVERIFY(httpserver.router.isStatisticsEnabled());
+    auto guard = qScopeGuard([this] {
+        httpserver.router.setStatisticsEnabled(false);
+        httpserver.router.resetStatistics();
+    });
+
+    const std::pair<QString, int> requests[] = {
+        { "/statistics/200", 200 },
+        { "/statistics/204", 204 },
+        { "/statistics/404", 404 },
+        { "/page/1", 200 },
+    };
+
+    QNetworkAccessManager networkAccessManager;
+    for (const auto &[path, status] : requests) {
+        std::unique_ptr<QNetworkReply> reply(
+                networkAccessManager.get(QNetworkRequest(QUrl(urlBase.arg(path)))));
+        QTRY_VERIFY(reply->isFinished());
+        QCOMPARE(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), status);
+    }
+
+    const QHttpServerRouteStatistics ruleStatistics = rule->statistics();
+    QCOMPARE(ruleStatistics.matchCount(), quint64(3));
+    QCOMPARE(ruleStatistics.responseCount(StatusClass::Successful), quint64(2));
+    QCOMPARE(ruleStatistics.responseCount(StatusClass::ClientError), quint64(1));
+    QCOMPARE(ruleStatistics.responseCount(StatusClass::ServerError), quint64(0));
+    quint64 timed = 0;
+    for (qsizetype bucket = 0; bucket < QHttpServerRouteStatistics::LatencyBucketCount; ++bucket)
+        timed += ruleStatistics.latencyCount(bucket);
+    QCOMPARE(timed, quint64(3));
+
+    const QHttpServerRouteStatistics routerStatistics = httpserver.router.statistics();
+    QCOMPARE(routerStatistics.matchCount(), quint64(4));
+    QCOMPARE(routerStatistics.responseCount(StatusClass::Successful), quint64(3));
+    QVERIFY(routerStatistics.totalHandlerTime() >= ruleStatistics.totalHandlerTime());
+
+    httpserver.router.resetStatistics();
+    QCOMPARE(rule->statistics().matchCount(), quint64(0));
+}
+
 void tst_QHttpServerRouter::viewHandlerMemberFunction()
 {
     class ViewClass
@@ -0,0 +1,135 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#include <QtTest/qtest.h>
+
+#include <QtHttpServer/qhttpserver.h>
+
+#include <private/qhttpserverrequest_p.h>
+#include <private/qhttpserverresponder_p.h>
+#include <private/qhttpserverstream_p.h>
+
+#include <QtCore/qobject.h>
+#include <QtCore/qurl.h>
+
+using namespace Qt::StringLiterals;
+
+#if defined(QT_BUILD_INTERNAL)
+// A stream without a socket: the responses are dropped, so that only the
+// routing is measured.
+class NullStream : public QHttpServerStream
+{
+public:
+    void setRequest(QHttpServerRequest::Method method, const QString &path)
+    {
+        QHttpServerRequestPrivate *d = QHttpServerRequestPrivate::get(&m_request);
+        d->method = method;
+        d->url = QUrl(u"http://localhost"_s + path);
+    }
+
+    const QHttpServerRequest &request() const { return m_request; }
+
+    QHttpServerResponder createResponder() { return QHttpServerResponderPrivate::create(this); }
+
+protected:
+    void responderDestroyed() override { }
+    void startHandlingRequest() override { }
+    void socketDisconnected() override { }
+    void drain() override { }
+    void abort() override { }
+
+    void write(const QByteArray &, const QHttpHeaders &, QHttpServerResponder::StatusCode,
+               quint32) override
+    {
+    }
+    void write(QHttpServerResponder::StatusCode, quint32) override { }
+    void write(QIODevice *data, const QHttpHeaders &, QHttpServerResponder::StatusCode,
+               quint32) override
+    {
+        delete data;
+    }
+    void writeInformational(QHttpServerResponder::StatusCode, const QHttpHeaders &,
+                            quint32) override
+    {
+    }
+    void writeBeginChunked(const QHttpHeaders &, QHttpServerResponder::StatusCode,
+                           quint32) override
+    {
+    }
+    void writeChunk(const QByteArray &, quint32) override { }
+    void writeEndChunked(const QByteArray &, const QHttpHeaders &, quint32) override { }
+
+private:
+    QHttpServerRequest m_request = initRequestFromSocket(nullptr);
+};
+#endif
+
+class tst_bench_QHttpServer_router : public QObject
+{
+    Q_OBJECT
+private slots:
+    void handleRequest_data();
+    void handleRequest();
+};
+
+// Adds ruleCount rules, alternating between static routes and routes with a
+// typed placeholder, so that rule i is "/static/i" or "/typed/i/<arg>".
+static void addRules(QHttpServer *server, int ruleCount)
+{
+    for (int i = 0; i < ruleCount; ++i) {
+        if (i % 2 == 0) {
+            server->route(u"/static/%1"_s.arg(i), [] (QHttpServerResponder &) { });
+        } else {
+            server->route(u"/typed/%1/"_s.arg(i), [] (qint64, QHttpServerResponder &) { });
+        }
+    }
+}
+
+void tst_bench_QHttpServer_router::handleRequest_data()
+{
+    QTest::addColumn<int>("ruleCount");
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("handled");
+
+    for (int ruleCount : { 10, 100, 1000, 10000 }) {
+        QTest::addRow("%d-first-static", ruleCount) << ruleCount << u"/static/0"_s << true;
+        QTest::addRow("%d-first-typed", ruleCount) << ruleCount << u"/typed/1/42"_s << true;
+        QTest::addRow("%d-last-static", ruleCount)
+                << ruleCount << u"/static/%1"_s.arg(ruleCount - 2) << true;
+        QTest::addRow("%d-last-typed", ruleCount)
+                << ruleCount << u"/typed/%1/42"_s.arg(ruleCount - 1) << true;
+        QTest::addRow("%d-miss", ruleCount) << ruleCount << u"/missing/42"_s << false;
+    }
+}
+
+void tst_bench_QHttpServer_router::handleRequest()
+{
+#if !defined(QT_BUILD_INTERNAL)
+    QSKIP("This benchmark requires a developer build.");
+#else
+    QFETCH(int, ruleCount);
+    QFETCH(QString, path);
+    QFETCH(bool, handled);
+
+    QHttpServer server;
+    addRules(&server, ruleCount);
+
+    NullStream stream;
+    stream.setRequest(QHttpServerRequest::Method::Get, path);
+    const QHttpServerRouter *router = server.router();
+
+    {
+        QHttpServerResponder responder = stream.createResponder();
+        QCOMPARE(router->handleRequest(stream.request(), responder), handled);
+    }
+
+    QBENCHMARK {
+        QHttpServerResponder responder = stream.createResponder();
+        router->handleRequest(stream.request(), responder);
+    }
+#endif
+}
+
+QTEST_MAIN(tst_bench_QHttpServer_router)
+
+#include "tst_bench_qhttpserver_router.moc"